@@ -0,0 +1,97 @@
+// Effect of SafeArray's Allocator parameter.
+//
+//   tlb            random reads over a large array under one read session,
+//                  4K pages (std::allocator) vs 2MB pages (HugePageAllocator)
+//   false_sharing  two threads each hammering element 0 of their own small
+//                  SafeArray; std::allocator tends to put both arrays on one
+//                  cache line, CacheAlignedAllocator never does
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Allocator>
+double random_read_ns(int n, long reads)
+{
+    sa::SafeArray<std::uint64_t, Allocator> array{n};
+    std::uint64_t i = 0;
+    for (auto it=array.unsafe_begin(); it!=array.unsafe_end(); ++it)
+        *it = i++;
+
+    const auto hold = array.cbegin();
+    std::uint64_t x = 88172645463325252ull;
+    std::uint64_t sum = 0;
+    const auto start = Clock::now();
+    for (long r=0; r<reads; ++r)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sum += array[x % n];
+    }
+    const std::chrono::duration<double, std::nano> elapsed
+        = Clock::now() - start;
+    if (sum == 42)
+        std::cout << "";
+    return elapsed.count() / reads;
+}
+
+template <typename Allocator>
+double false_sharing_ns(long increments)
+{
+    using SA = sa::SafeArray<long, Allocator>;
+    // Allocated back to back, as many small arrays would be.
+    std::unique_ptr<SA> a{ new SA(1) };
+    std::unique_ptr<SA> b{ new SA(1) };
+
+    auto hammer = [increments](SA& array)
+    {
+        auto it = array.begin();
+        volatile long* counter = &*it;
+        for (long i=0; i<increments; ++i)
+            *counter = *counter + 1;
+    };
+    const auto start = Clock::now();
+    {
+        std::jthread t1{hammer, std::ref(*a)};
+        std::jthread t2{hammer, std::ref(*b)};
+    }
+    const std::chrono::duration<double, std::nano> elapsed
+        = Clock::now() - start;
+    return elapsed.count() / increments;
+}
+
+// g++ -std=c++20 -O2 -pthread bench/allocators.cpp -o ~/bin/safety/bench_allocators
+int main(int argc, char** argv)
+{
+    const int n = (argc > 1) ? std::stoi( argv[1] ) : 64 << 20;
+    constexpr long READS = 20000000;
+    constexpr long INCREMENTS = 50000000;
+
+    std::cout << std::setw(16) << "benchmark" << std::setw(24) << "allocator"
+        << std::setw(12) << "ns/op" << std::endl;
+    std::cout << std::setw(16) << "tlb" << std::setw(24) << "std::allocator"
+        << std::setw(12)
+        << random_read_ns<std::allocator<std::uint64_t>>(n, READS)
+        << std::endl;
+    std::cout << std::setw(16) << "tlb" << std::setw(24) << "HugePageAllocator"
+        << std::setw(12)
+        << random_read_ns<sa::HugePageAllocator<std::uint64_t>>(n, READS)
+        << std::endl;
+    std::cout << std::setw(16) << "false_sharing" << std::setw(24)
+        << "std::allocator" << std::setw(12)
+        << false_sharing_ns<std::allocator<long>>(INCREMENTS) << std::endl;
+    std::cout << std::setw(16) << "false_sharing" << std::setw(24)
+        << "CacheAlignedAllocator" << std::setw(12)
+        << false_sharing_ns<sa::CacheAlignedAllocator<long>>(INCREMENTS)
+        << std::endl;
+    return 0;
+}
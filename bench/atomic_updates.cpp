@@ -0,0 +1,79 @@
+// Concurrent histogram increments, by thread count.
+//
+//   session   *sa.begin() += 1 per increment, the pre-existing way
+//   atomic    SafeArray::fetch_add, no session
+//   sharded   ShardedCounterArray::add
+//
+// Reported as total increments per microsecond across all threads.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+#include "../safe-containers/sharded_counter_array.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int BINS = 256;
+
+template <typename Increment>
+double per_us(int num_threads, long increments, Increment increment)
+{
+    const auto start = Clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([t, increments, &increment]{
+                unsigned x = 2463534242u + t;
+                for (long i=0; i<increments; ++i)
+                {
+                    x ^= x << 13;
+                    x ^= x >> 17;
+                    x ^= x << 5;
+                    increment(x % BINS);
+                }
+            });
+    }
+    const std::chrono::duration<double, std::micro> elapsed
+        = Clock::now() - start;
+    return num_threads * increments / elapsed.count();
+}
+
+// g++ -std=c++20 -O2 -pthread bench/atomic_updates.cpp -o ~/bin/safety/bench_atomic_updates
+int main(int argc, char** argv)
+{
+    const int max_threads = (argc > 1) ? std::stoi( argv[1] )
+        : (int)std::thread::hardware_concurrency();
+    const long increments = (argc > 2) ? std::stol( argv[2] ) : 1000000;
+
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "session"
+        << std::setw(12) << "atomic" << std::setw(12) << "sharded"
+        << std::endl;
+    for (int threads=1; threads<=max_threads; threads*=2)
+    {
+        sa::SafeArray<long> locked{BINS, 0L};
+        sa::SafeArray<long> atomic{BINS, 0L};
+        sa::ShardedCounterArray<long> sharded{BINS};
+        std::cout << std::setw(8) << threads << std::setw(12)
+            << per_us(threads, increments / 10, [&](int bin){
+                    auto it = locked.begin();
+                    for (int i=0; i<bin; ++i)
+                        ++it;
+                    *it += 1;
+                })
+            << std::setw(12)
+            << per_us(threads, increments, [&](int bin){
+                    atomic.fetch_add(bin, 1);
+                })
+            << std::setw(12)
+            << per_us(threads, increments, [&](int bin){
+                    sharded.add(bin);
+                })
+            << std::endl;
+    }
+    return 0;
+}
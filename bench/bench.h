@@ -0,0 +1,112 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Shared plumbing for the benchmarks: timing, percentiles, and a Reporter
+// that prints results as a table and saves them as JSON, so runs of
+// different versions can be compared by script.
+
+namespace bench
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from discarding a computed value.
+template <typename T>
+inline void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline double elapsed_ns(Clock::time_point start,
+        Clock::time_point end=Clock::now())
+{
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// The q-quantile (0 <= q <= 1) of samples, by nearest rank.  Reorders
+// samples.
+inline double percentile(std::vector<double>& samples, double q)
+{
+    if (samples.empty())
+        return 0;
+    const std::size_t rank = std::min(samples.size() - 1,
+            (std::size_t)std::ceil(q * samples.size()) - (q > 0));
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+struct Result
+{
+    std::string benchmark;
+    std::string impl;
+    int threads;
+    std::string metric;     // e.g. "ns_per_op"
+    double value;
+};
+
+class Reporter
+{
+    public:
+        explicit Reporter(std::string suite)
+            : _suite{std::move(suite)}
+        {}
+
+        // Records a result and prints it as a table row.
+        void add(const Result& result)
+        {
+            if (_results.empty())
+                std::cout << std::left << std::setw(20) << "benchmark"
+                    << std::setw(22) << "impl" << std::right << std::setw(8)
+                    << "threads" << std::setw(16) << "metric"
+                    << std::setw(14) << "value" << std::endl;
+            _results.push_back(result);
+            std::cout << std::left << std::setw(20) << result.benchmark
+                << std::setw(22) << result.impl << std::right << std::setw(8)
+                << result.threads << std::setw(16) << result.metric
+                << std::setw(14) << std::fixed << std::setprecision(2)
+                << result.value << std::defaultfloat << std::endl;
+        }
+
+        void write_json(std::ostream& out) const
+        {
+            out << "{\"suite\":\"" << _suite << "\",\"version\":" << VERSION
+                << ",\"results\":[";
+            for (std::size_t i=0; i<_results.size(); ++i)
+            {
+                const Result& r = _results[i];
+                out << (i ? ",\n" : "\n") << "{\"benchmark\":\""
+                    << r.benchmark << "\",\"impl\":\"" << r.impl
+                    << "\",\"threads\":" << r.threads << ",\"metric\":\""
+                    << r.metric << "\",\"value\":" << r.value << "}";
+            }
+            out << "\n]}\n";
+        }
+        void save_json(const std::string& path) const
+        {
+            std::ofstream out{path};
+            if (!out)
+                throw std::runtime_error("Can't open " + path);
+            write_json(out);
+        }
+
+    private:
+        static constexpr int VERSION = 1;
+
+        const std::string _suite;
+        std::vector<Result> _results;
+};
+
+} // bench
+
+#endif // BENCH_H
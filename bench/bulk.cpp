@@ -0,0 +1,95 @@
+// SafeArray bulk operations against the iterator loops they replace, in
+// GB/s of element data written.
+//
+//   fill       fill(value) vs *it = value over begin()..end()
+//   copy_from  copy_from(vector) vs *it = *src++
+//   copy_to    copy_to(pointer) vs *dst++ = *it over cbegin()..cend()
+//   swap       swap_contents() vs std::swap(*it, *jt) (counting both arrays)
+//   memcpy     a plain memcpy of the same size, for reference
+//
+//     bench_bulk [size_mb] [json_file]
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "../safe-containers/safe_array.h"
+
+using Elem = long;
+constexpr int PASSES = 10;
+
+template <typename F>
+double gb_per_s(std::size_t bytes, F pass)
+{
+    pass();     // Warm up, and fault everything in
+    const auto start = bench::Clock::now();
+    for (int i=0; i<PASSES; ++i)
+        pass();
+    return (double)bytes * PASSES / bench::elapsed_ns(start);
+}
+
+// g++ -std=c++20 -O2 -pthread bench/bulk.cpp -o ~/bin/safety/bench_bulk
+int main(int argc, char** argv)
+{
+    const int size_mb = (argc > 1) ? std::stoi( argv[1] ) : 256;
+    const std::string json_file = (argc > 2) ? argv[2] : "";
+    const int n = (int)(((std::size_t)size_mb << 20) / sizeof(Elem));
+    const std::size_t bytes = (std::size_t)n * sizeof(Elem);
+
+    sa::SafeArray<Elem> array(n, 0L), other(n, 1L);
+    std::vector<Elem> vec(n, 2L);
+    bench::Reporter reporter{"bulk"};
+    auto add = [&](const char* benchmark, const char* impl, double value){
+        reporter.add({ benchmark, impl, 1, "gb_per_s", value });
+    };
+
+    Elem value = 0;
+    add("fill", "iterator", gb_per_s(bytes, [&]{
+            ++value;
+            const auto end = array.end();
+            for (auto it=array.begin(); it!=end; ++it)
+                *it = value;
+            }));
+    add("fill", "bulk", gb_per_s(bytes, [&]{ array.fill(++value); }));
+
+    add("copy_from", "iterator", gb_per_s(bytes, [&]{
+            const Elem* src = vec.data();
+            const auto end = array.end();
+            for (auto it=array.begin(); it!=end; ++it)
+                *it = *src++;
+            }));
+    add("copy_from", "bulk", gb_per_s(bytes, [&]{ array.copy_from(vec); }));
+
+    add("copy_to", "iterator", gb_per_s(bytes, [&]{
+            Elem* dst = vec.data();
+            const auto end = array.cend();
+            for (auto it=array.cbegin(); it!=end; ++it)
+                *dst++ = *it;
+            bench::do_not_optimize(vec[n - 1]);
+            }));
+    add("copy_to", "bulk", gb_per_s(bytes, [&]{
+            array.copy_to(vec.data());
+            bench::do_not_optimize(vec[n - 1]);
+            }));
+
+    add("swap", "iterator", gb_per_s(2 * bytes, [&]{
+            const auto end = array.end();
+            auto jt = other.begin();
+            for (auto it=array.begin(); it!=end; ++it, ++jt)
+                std::swap(*it, *jt);
+            }));
+    add("swap", "bulk", gb_per_s(2 * bytes, [&]{
+            array.swap_contents(other);
+            }));
+
+    add("memcpy", "reference", gb_per_s(bytes, [&]{
+            std::memcpy(vec.data(), other.cbegin().operator->(), bytes);
+            bench::do_not_optimize(vec[n - 1]);
+            }));
+
+    if (!json_file.empty())
+        reporter.save_json(json_file);
+    return 0;
+}
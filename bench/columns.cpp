@@ -0,0 +1,69 @@
+// Scanning one field of a multi-field record: SafeArray<Record> (array of
+// structs) against SafeColumns (struct of arrays).  The AoS scan drags every
+// field of each record through the cache; the SoA scan reads only the field
+// it sums, contiguously.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+
+#include "../safe-containers/safe_array.h"
+#include "../safe-containers/safe_columns.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Record
+{
+    double price;
+    long quantity;
+    int id;
+    char flags[12];
+};
+
+template <typename Scan>
+double gb_per_s(long bytes, int passes, Scan scan)
+{
+    double sum = 0;
+    const auto start = Clock::now();
+    for (int p=0; p<passes; ++p)
+        sum += scan();
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    if (sum == 42)
+        std::cout << "";
+    return bytes * passes / elapsed.count() / 1e9;
+}
+
+// g++ -std=c++20 -O3 -march=native -pthread bench/columns.cpp -o ~/bin/safety/bench_columns
+int main(int argc, char** argv)
+{
+    const int n = (argc > 1) ? std::stoi( argv[1] ) : 16 << 20;
+    const int passes = (argc > 2) ? std::stoi( argv[2] ) : 10;
+
+    sa::SafeArray<Record> aos{n, [](int i){
+        return Record{i * 0.25, i, i, {}};
+    }};
+    sa::SafeColumns<double, long, int> soa{n};
+    for (auto it=soa.begin(); it!=soa.end(); ++it)
+        *it = std::tuple{it.index() * 0.25, (long)it.index(), it.index()};
+
+    // Rate at which useful bytes (the prices) are consumed.
+    const long bytes = (long)n * sizeof(double);
+    std::cout << std::setw(12) << "layout" << std::setw(12) << "GB/s"
+        << std::endl;
+    std::cout << std::setw(12) << "AoS" << std::setw(12)
+        << gb_per_s(bytes, passes, [&]{
+                double sum = 0;
+                const auto end = aos.cend();
+                for (auto it=aos.cbegin(); it!=end; ++it)
+                    sum += it->price;
+                return sum;
+            }) << std::endl;
+    std::cout << std::setw(12) << "SoA" << std::setw(12)
+        << gb_per_s(bytes, passes, [&]{
+                const auto prices = soa.ccolumn<0>();
+                return std::accumulate(prices.begin(), prices.end(), 0.0);
+            }) << std::endl;
+    return 0;
+}
@@ -0,0 +1,474 @@
+// Load generator: drives a container with a configurable reader/writer mix,
+// or replays a recorded trace, and reports whether it keeps up.
+//
+//     loadgen [--option=value ...]
+//
+//   --container=safe_array|shared_mutex   what to drive (safe_array)
+//   --size=N          elements in the container (1048576)
+//   --threads=N       worker threads (4)
+//   --read-ratio=R    fraction of operations that read, 0..1 (0.9)
+//   --touch=N         elements accessed per operation (64)
+//   --pattern=P       which elements: sequential, random, or hotspot[:F],
+//                     where 90% of operations go to the first F of the
+//                     array (0.01) (random)
+//   --hold=D          extra time to keep the hold, in us: fixed:T,
+//                     uniform:LO:HI or exp:MEAN (fixed:0)
+//   --rate=OPS        open loop: total arrivals per second, Poisson; each
+//                     operation's latency is measured from when it was due,
+//                     so falling behind shows (0: closed loop)
+//   --duration=S      seconds to run (5)
+//   --replay=FILE     replay a trace instead of generating operations
+//   --json=FILE       save the results as JSON (see bench.h)
+//   --seed=N          random seed (1)
+//
+// A trace has one operation per line; '#' starts a comment:
+//
+//     # thread  op  index  count  hold_us  [at_us]
+//     0         R   4096   64     5        0
+//     1         W   0      1024   20       150
+//
+// Trace threads are mapped onto workers modulo --threads.  at_us, when
+// given, is when the operation is due, relative to the start; without it
+// the operation starts as soon as the worker's previous one is done.  A
+// replay runs to the end of the trace, whatever --duration says.
+// bench/traces/example.trace is a small example.
+//
+// Reports throughput, acquisition latency percentiles for reads and writes,
+// and fairness across workers: Jain's index of the operations each
+// completed (1 when all did the same, 1/n when one did everything), and the
+// spread of their p99 latencies (thr_p99_min_ns, thr_p99_max_ns).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bench.h"
+#include "../safe-containers/safe_array.h"
+
+using Elem = long;
+using Clock = bench::Clock;
+
+struct Op
+{
+    bool write;
+    std::size_t index;
+    int count;
+    double hold_us;
+    double at_us;       // Due time from the start; < 0: as soon as possible
+};
+
+struct Config
+{
+    std::string container = "safe_array";
+    std::size_t size = 1 << 20;
+    int threads = 4;
+    double read_ratio = 0.9;
+    int touch = 64;
+    std::string pattern = "random";
+    std::string hold = "fixed:0";
+    double rate = 0;
+    double duration = 5;
+    std::string replay;
+    std::string json;
+    unsigned seed = 1;
+};
+
+Config parse(int argc, char** argv)
+{
+    std::map<std::string, std::string> args;
+    for (int i=1; i<argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        if (!arg.starts_with("--") || eq == std::string::npos)
+            throw std::invalid_argument("Expected --option=value, got "
+                    + arg);
+        args[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+    Config config;
+    auto take = [&args](const std::string& key, auto& value)
+    {
+        const auto it = args.find(key);
+        if (it == args.end())
+            return;
+        std::istringstream in{it->second};
+        if (!(in >> value))
+            throw std::invalid_argument("Bad value for --" + key);
+        args.erase(it);
+    };
+    take("container", config.container);
+    take("size", config.size);
+    take("threads", config.threads);
+    take("read-ratio", config.read_ratio);
+    take("touch", config.touch);
+    take("pattern", config.pattern);
+    take("hold", config.hold);
+    take("rate", config.rate);
+    take("duration", config.duration);
+    take("replay", config.replay);
+    take("json", config.json);
+    take("seed", config.seed);
+    if (!args.empty())
+        throw std::invalid_argument("Unknown option --" + args.begin()->first);
+    if (config.size == 0 || config.threads <= 0 || config.touch <= 0)
+        throw std::invalid_argument("size, threads and touch must be > 0");
+    return config;
+}
+
+std::vector<std::string> split(const std::string& s, char sep)
+{
+    std::vector<std::string> parts;
+    std::istringstream in{s};
+    for (std::string part; std::getline(in, part, sep); )
+        parts.push_back(part);
+    return parts;
+}
+
+// Makes a worker's operations from the Config.
+class Generator
+{
+    public:
+        Generator(const Config& config, int worker)
+            : _config{config},
+            _rng{ config.seed * 7919u + worker },
+            _next_seq{ worker * config.size / config.threads }
+        {
+            const auto hold = split(config.hold, ':');
+            _hold_kind = hold.at(0);
+            for (std::size_t i=1; i<hold.size(); ++i)
+                _hold_args.push_back(std::stod(hold[i]));
+            if (!((_hold_kind == "fixed" && _hold_args.size() == 1)
+                        || (_hold_kind == "uniform" && _hold_args.size() == 2)
+                        || (_hold_kind == "exp" && _hold_args.size() == 1)))
+                throw std::invalid_argument("Bad --hold " + config.hold);
+
+            const auto pattern = split(config.pattern, ':');
+            _pattern = pattern.at(0);
+            if (_pattern == "hotspot")
+                _hot_fraction = pattern.size() > 1
+                    ? std::stod(pattern[1]) : 0.01;
+            else if (_pattern != "sequential" && _pattern != "random")
+                throw std::invalid_argument("Bad --pattern "
+                        + config.pattern);
+            if (config.rate > 0)
+                _arrivals = std::exponential_distribution<double>(
+                        config.rate / config.threads / 1e6);
+        }
+
+        Op next()
+        {
+            Op op;
+            op.write = _unit(_rng) >= _config.read_ratio;
+            op.index = _index();
+            op.count = _config.touch;
+            op.hold_us = _hold();
+            op.at_us = -1;
+            if (_config.rate > 0)
+                op.at_us = _due_us += _arrivals(_rng);
+            return op;
+        }
+
+    private:
+        std::size_t _index()
+        {
+            const std::size_t n = _config.size;
+            if (_pattern == "sequential")
+            {
+                const std::size_t i = _next_seq % n;
+                _next_seq += _config.touch;
+                return i;
+            }
+            if (_pattern == "hotspot" && _unit(_rng) < 0.9)
+            {
+                const std::size_t hot = std::max<std::size_t>(1,
+                        n * _hot_fraction);
+                return std::uniform_int_distribution<std::size_t>(
+                        0, hot - 1)(_rng);
+            }
+            return std::uniform_int_distribution<std::size_t>(0, n - 1)(_rng);
+        }
+        double _hold()
+        {
+            if (_hold_kind == "fixed")
+                return _hold_args[0];
+            if (_hold_kind == "uniform")
+                return std::uniform_real_distribution<double>(
+                        _hold_args[0], _hold_args[1])(_rng);
+            return _hold_args[0] > 0 ? std::exponential_distribution<double>(
+                    1 / _hold_args[0])(_rng) : 0;
+        }
+
+        const Config& _config;
+        std::mt19937_64 _rng;
+        std::uniform_real_distribution<double> _unit{0, 1};
+        std::string _hold_kind;
+        std::vector<double> _hold_args;
+        std::string _pattern;
+        double _hot_fraction = 0;
+        std::size_t _next_seq;
+        std::exponential_distribution<double> _arrivals;
+        double _due_us = 0;
+};
+
+// Each worker's share of a trace.
+std::vector<std::vector<Op>> load_trace(const std::string& path,
+        int threads)
+{
+    std::ifstream in{path};
+    if (!in)
+        throw std::runtime_error("Can't open " + path);
+    std::vector<std::vector<Op>> ops(threads);
+    int line_no = 0;
+    for (std::string line; std::getline(in, line); )
+    {
+        ++line_no;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields{line};
+        int thread;
+        char kind;
+        Op op;
+        if (!(fields >> thread))
+            continue;
+        if (!(fields >> kind >> op.index >> op.count >> op.hold_us)
+                || (kind != 'R' && kind != 'W') || thread < 0)
+            throw std::runtime_error(path + ":" + std::to_string(line_no)
+                    + ": bad operation");
+        op.write = kind == 'W';
+        if (!(fields >> op.at_us))
+            op.at_us = -1;
+        ops[thread % threads].push_back(op);
+    }
+    return ops;
+}
+
+// The containers, each offering read(f) and write(f), which call f with a
+// pointer to the first element while holding the container.
+
+class SafeArrayTarget
+{
+    public:
+        explicit SafeArrayTarget(std::size_t size)
+            : _array(size, 0L)
+        {}
+        template <typename F>
+        void read(F f) const
+        {
+            auto hold = _array.cbegin();
+            f(&*hold);
+        }
+        template <typename F>
+        void write(F f)
+        {
+            auto hold = _array.begin();
+            f(&*hold);
+        }
+    private:
+        sa::SafeArray<Elem> _array;
+};
+
+class SharedMutexTarget
+{
+    public:
+        explicit SharedMutexTarget(std::size_t size)
+            : _vec(size, 0L)
+        {}
+        template <typename F>
+        void read(F f) const
+        {
+            std::shared_lock<std::shared_mutex> lock{_mutex};
+            f(_vec.data());
+        }
+        template <typename F>
+        void write(F f)
+        {
+            std::unique_lock<std::shared_mutex> lock{_mutex};
+            f(_vec.data());
+        }
+    private:
+        std::vector<Elem> _vec;
+        mutable std::shared_mutex _mutex;
+};
+
+struct WorkerResult
+{
+    long ops = 0;
+    std::vector<double> read_ns;
+    std::vector<double> write_ns;
+};
+
+void spin_until(Clock::time_point until)
+{
+    while (Clock::now() < until)
+        ;
+}
+
+template <typename Target>
+WorkerResult run_worker(Target& target, const Config& config,
+        Clock::time_point start, Clock::time_point stop,
+        Generator* generator, const std::vector<Op>* trace)
+{
+    WorkerResult result;
+    std::size_t next = 0;
+    auto at = [start](double us){
+        return start + std::chrono::nanoseconds((long long)(us * 1000));
+    };
+    while (true)
+    {
+        Op op;
+        if (trace)
+        {
+            if (next == trace->size())
+                break;
+            op = (*trace)[next++];
+        }
+        else
+            op = generator->next();
+        Clock::time_point issued = Clock::now();
+        if (op.at_us >= 0)
+        {
+            // Due times are in the past once we fall behind; then we run
+            // flat out, and the latency shows how far behind.
+            issued = at(op.at_us);
+            if (issued > stop && !trace)
+                break;
+            if (issued - Clock::now() > std::chrono::microseconds(100))
+                std::this_thread::sleep_until(
+                        issued - std::chrono::microseconds(50));
+            spin_until(issued);
+        }
+        else if (!trace && issued >= stop)
+            break;
+
+        auto work = [&](auto* data){
+            const auto acquired = Clock::now();
+            (op.write ? result.write_ns : result.read_ns).push_back(
+                    bench::elapsed_ns(issued, acquired));
+            Elem sum = 0;
+            for (int i=0; i<op.count; ++i)
+            {
+                auto& elem = data[(op.index + i) % config.size];
+                if constexpr (!std::is_const_v<
+                        std::remove_pointer_t<decltype(data)>>)
+                    elem += 1;
+                else
+                    sum += elem;
+            }
+            bench::do_not_optimize(sum);
+            spin_until(acquired + std::chrono::nanoseconds(
+                        (long long)(op.hold_us * 1000)));
+        };
+        if (op.write)
+            target.write([&](Elem* data){ work(data); });
+        else
+            target.read([&](const Elem* data){ work(data); });
+        ++result.ops;
+    }
+    return result;
+}
+
+template <typename Target>
+void run(const Config& config)
+{
+    Target target{config.size};
+    std::vector<std::vector<Op>> trace;
+    if (!config.replay.empty())
+        trace = load_trace(config.replay, config.threads);
+
+    std::vector<WorkerResult> results(config.threads);
+    const auto start = Clock::now() + std::chrono::milliseconds(10);
+    const auto stop = start + std::chrono::nanoseconds(
+            (long long)(config.duration * 1e9));
+    std::vector<Generator> generators;
+    for (int w=0; w<config.threads; ++w)
+        generators.emplace_back(config, w);
+    {
+        std::vector<std::jthread> workers;
+        for (int w=0; w<config.threads; ++w)
+            workers.emplace_back([&, w]{
+                spin_until(start);
+                results[w] = run_worker(target, config, start, stop,
+                        &generators[w], trace.empty() ? nullptr : &trace[w]);
+            });
+    }
+    const double elapsed_s = bench::elapsed_ns(start) / 1e9;
+
+    bench::Reporter reporter{"loadgen"};
+    auto add = [&](const std::string& metric, double value){
+        reporter.add({ "loadgen", config.container, config.threads, metric,
+                value });
+    };
+    long ops = 0;
+    double sum = 0, sum_sq = 0;
+    std::vector<double> reads, writes, p99s;
+    for (WorkerResult& r : results)
+    {
+        ops += r.ops;
+        sum += r.ops;
+        sum_sq += (double)r.ops * r.ops;
+        std::vector<double> mine = r.read_ns;
+        mine.insert(mine.end(), r.write_ns.begin(), r.write_ns.end());
+        if (!mine.empty())
+            p99s.push_back(bench::percentile(mine, 0.99));
+        reads.insert(reads.end(), r.read_ns.begin(), r.read_ns.end());
+        writes.insert(writes.end(), r.write_ns.begin(), r.write_ns.end());
+    }
+    add("ops_per_s", ops / elapsed_s);
+    add("reads", reads.size());
+    add("writes", writes.size());
+    for (auto [name, samples] : { std::pair{"read", &reads},
+            std::pair{"write", &writes} })
+    {
+        if (samples->empty())
+            continue;
+        add(std::string(name) + "_p50_ns", bench::percentile(*samples, 0.5));
+        add(std::string(name) + "_p99_ns", bench::percentile(*samples, 0.99));
+        add(std::string(name) + "_p999_ns",
+                bench::percentile(*samples, 0.999));
+        add(std::string(name) + "_max_ns", bench::percentile(*samples, 1));
+    }
+    add("jain_fairness", sum_sq > 0 ? sum * sum / (results.size() * sum_sq)
+            : 1);
+    if (!p99s.empty())
+    {
+        add("thr_p99_min_ns", *std::min_element(p99s.begin(), p99s.end()));
+        add("thr_p99_max_ns", *std::max_element(p99s.begin(), p99s.end()));
+    }
+    if (!config.json.empty())
+        reporter.save_json(config.json);
+}
+
+// g++ -std=c++20 -O2 -pthread bench/loadgen.cpp -o ~/bin/safety/loadgen
+int main(int argc, char** argv)
+{
+    try
+    {
+        const Config config = parse(argc, argv);
+        if (config.container == "safe_array")
+            run<SafeArrayTarget>(config);
+        else if (config.container == "shared_mutex")
+            run<SharedMutexTarget>(config);
+        else
+            throw std::invalid_argument("Unknown container "
+                    + config.container);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
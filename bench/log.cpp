@@ -0,0 +1,66 @@
+// Cost of a log line on the calling thread, by thread count.
+//
+//   locked    mutex, then ostream << line << std::endl, the previous Log
+//   async     Log::write, queued for the background writer
+//
+// Lines go to stderr; run with 2>/dev/null, or to a file, so that the
+// terminal isn't what's being measured.  Reported in ns per line.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../log.h"
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Write>
+double ns_per_line(int num_threads, int lines, Write write)
+{
+    const auto start = Clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([lines, &write]{
+                const std::string line(60, '.');
+                for (int i=0; i<lines; ++i)
+                    write(line);
+            });
+    }
+    const std::chrono::duration<double, std::nano> elapsed
+        = Clock::now() - start;
+    return elapsed.count() / (num_threads * lines);
+}
+
+// g++ -std=c++20 -O2 -pthread bench/log.cpp -o ~/bin/safety/bench_log
+int main(int argc, char** argv)
+{
+    const int max_threads = (argc > 1) ? std::stoi( argv[1] )
+        : (int)std::thread::hardware_concurrency();
+    const int lines = (argc > 2) ? std::stoi( argv[2] ) : 200000;
+
+    Log& log = Log::instance(std::cerr);
+    std::mutex mutex;
+
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "locked"
+        << std::setw(12) << "async" << std::endl;
+    for (int threads=1; threads<=max_threads; threads*=2)
+    {
+        std::cout << std::setw(8) << threads << std::setw(12)
+            << ns_per_line(threads, lines, [&](const std::string& line){
+                    std::lock_guard<std::mutex> lock{mutex};
+                    std::cerr << line << std::endl << std::flush;
+                })
+            << std::setw(12)
+            << ns_per_line(threads, lines, [&](const std::string& line){
+                    log.write(line);
+                })
+            << std::endl;
+        log.flush();
+    }
+    return 0;
+}
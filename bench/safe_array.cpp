@@ -0,0 +1,364 @@
+// SafeArray against standard baselines.
+//
+//   acquire_read/write  uncontended acquire + release, ns per op
+//   iterate_read/write  one pass under one hold, ns per element
+//   reader_scaling      t threads making read passes, elements per us
+//   writer_under_load   write passes per second with t readers running
+//   tail_latency        read acquisition latency percentiles, t readers
+//                       against one writer
+//
+// Each runs for
+//   sa::SafeArray             AccessCtr + condition variable
+//   sa::fixed::SafeArray      AccessWord; stands in for sa::v2::SafeArray,
+//                             which doesn't compile yet
+//   shared_mutex+vector       std::shared_lock / std::unique_lock
+//   unguarded                 a plain vector; no writers run against it
+//
+// Prints a table and, given a path, saves the results as JSON.
+//
+//     bench_safe_array [max_threads] [json_file] [run_ms]
+//
+// max_threads 0, the default, means one per hardware thread.
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "../safe-containers/safe_array.h"
+#include "../safe-containers/safe_array_fixed.h"
+
+using Elem = long;
+constexpr int SIZE = 1 << 16;
+constexpr int ACQUIRE_OPS = 200000;
+constexpr int SHORT_WRITE = 64;   // Elements a tail_latency writer touches
+
+// Each impl offers acquire_read()/acquire_write(), one empty hold, and
+// read(f)/write(f), which call f(first, last) under one hold.
+
+struct SafeArrayImpl
+{
+    static constexpr const char* NAME = "sa::SafeArray";
+    static constexpr bool GUARDED = true;
+    sa::SafeArray<Elem> array{SIZE, 0L};
+
+    void acquire_read() const
+    {
+        auto it = array.cbegin();
+        bench::do_not_optimize(*it);
+    }
+    void acquire_write()
+    {
+        auto it = array.begin();
+        bench::do_not_optimize(*it);
+    }
+    template <typename F>
+    void read(F f) const
+    {
+        auto last = array.cend();
+        auto first = array.cbegin();
+        f(first, last);
+    }
+    template <typename F>
+    void write(F f)
+    {
+        auto last = array.end();
+        auto first = array.begin();
+        f(first, last);
+    }
+};
+
+struct FixedImpl
+{
+    static constexpr const char* NAME = "sa::fixed::SafeArray";
+    static constexpr bool GUARDED = true;
+    std::unique_ptr<sa::fixed::SafeArray<Elem, SIZE>> array{
+        new sa::fixed::SafeArray<Elem, SIZE>(0L) };
+
+    void acquire_read() const
+    {
+        auto it = array->cbegin();
+        bench::do_not_optimize(*it);
+    }
+    void acquire_write()
+    {
+        auto it = array->begin();
+        bench::do_not_optimize(*it);
+    }
+    template <typename F>
+    void read(F f) const
+    {
+        auto last = array->cend();
+        auto first = array->cbegin();
+        f(first, last);
+    }
+    template <typename F>
+    void write(F f)
+    {
+        auto last = array->end();
+        auto first = array->begin();
+        f(first, last);
+    }
+};
+
+struct SharedMutexImpl
+{
+    static constexpr const char* NAME = "shared_mutex+vector";
+    static constexpr bool GUARDED = true;
+    std::vector<Elem> vec = std::vector<Elem>(SIZE, 0L);
+    mutable std::shared_mutex mutex;
+
+    void acquire_read() const
+    {
+        std::shared_lock<std::shared_mutex> lock{mutex};
+        bench::do_not_optimize(vec[0]);
+    }
+    void acquire_write()
+    {
+        std::unique_lock<std::shared_mutex> lock{mutex};
+        bench::do_not_optimize(vec[0]);
+    }
+    template <typename F>
+    void read(F f) const
+    {
+        std::shared_lock<std::shared_mutex> lock{mutex};
+        auto first = vec.cbegin();
+        auto last = vec.cend();
+        f(first, last);
+    }
+    template <typename F>
+    void write(F f)
+    {
+        std::unique_lock<std::shared_mutex> lock{mutex};
+        auto first = vec.begin();
+        auto last = vec.end();
+        f(first, last);
+    }
+};
+
+struct UnguardedImpl
+{
+    static constexpr const char* NAME = "unguarded";
+    static constexpr bool GUARDED = false;
+    std::vector<Elem> vec = std::vector<Elem>(SIZE, 0L);
+
+    void acquire_read() const { bench::do_not_optimize(vec[0]); }
+    void acquire_write() { bench::do_not_optimize(vec[0]); }
+    template <typename F>
+    void read(F f) const
+    {
+        auto first = vec.cbegin();
+        auto last = vec.cend();
+        f(first, last);
+    }
+    template <typename F>
+    void write(F f)
+    {
+        auto first = vec.begin();
+        auto last = vec.end();
+        f(first, last);
+    }
+};
+
+auto sum_pass = [](auto& first, auto& last)
+{
+    Elem sum = 0;
+    for ( ; first!=last; ++first)
+        sum += *first;
+    bench::do_not_optimize(sum);
+};
+
+Elem pass_ct = 0;
+auto fill_pass = [](auto& first, auto& last)
+{
+    const Elem value = ++pass_ct;
+    for ( ; first!=last; ++first)
+        *first = value;
+};
+
+auto short_write = [](auto& first, auto&)
+{
+    for (int i=0; i<SHORT_WRITE; ++i, ++first)
+        *first = i;
+};
+
+struct Config
+{
+    int max_threads;
+    std::chrono::milliseconds run_time;
+};
+
+template <typename Impl>
+void acquire(bench::Reporter& reporter)
+{
+    Impl impl;
+    auto start = bench::Clock::now();
+    for (int i=0; i<ACQUIRE_OPS; ++i)
+        impl.acquire_read();
+    reporter.add({ "acquire_read", Impl::NAME, 1, "ns_per_op",
+            bench::elapsed_ns(start) / ACQUIRE_OPS });
+    start = bench::Clock::now();
+    for (int i=0; i<ACQUIRE_OPS; ++i)
+        impl.acquire_write();
+    reporter.add({ "acquire_write", Impl::NAME, 1, "ns_per_op",
+            bench::elapsed_ns(start) / ACQUIRE_OPS });
+}
+
+template <typename Impl>
+void iterate(bench::Reporter& reporter, const Config& config)
+{
+    Impl impl;
+    auto passes_for = [&config](auto pass){
+        long n = 0;
+        const auto start = bench::Clock::now();
+        while (bench::Clock::now() - start < config.run_time / 4)
+        {
+            pass();
+            ++n;
+        }
+        return bench::elapsed_ns(start) / ((double)n * SIZE);
+    };
+    reporter.add({ "iterate_read", Impl::NAME, 1, "ns_per_element",
+            passes_for([&]{ impl.read(sum_pass); }) });
+    reporter.add({ "iterate_write", Impl::NAME, 1, "ns_per_element",
+            passes_for([&]{ impl.write(fill_pass); }) });
+}
+
+template <typename Impl>
+void reader_scaling(bench::Reporter& reporter, const Config& config)
+{
+    for (int t=1; t<=config.max_threads; t*=2)
+    {
+        Impl impl;
+        std::atomic<bool> stop{false};
+        std::atomic<long> passes{0};
+        const auto start = bench::Clock::now();
+        {
+            std::vector<std::jthread> threads;
+            for (int i=0; i<t; ++i)
+                threads.emplace_back([&]{
+                    long n = 0;
+                    while (!stop.load(std::memory_order_relaxed))
+                    {
+                        impl.read(sum_pass);
+                        ++n;
+                    }
+                    passes += n;
+                });
+            std::this_thread::sleep_for(config.run_time);
+            stop = true;
+        }
+        reporter.add({ "reader_scaling", Impl::NAME, t, "elements_per_us",
+                passes * SIZE / (bench::elapsed_ns(start) / 1000) });
+    }
+}
+
+template <typename Impl>
+void writer_under_load(bench::Reporter& reporter, const Config& config)
+{
+    for (int t=1; t<=config.max_threads; t*=2)
+    {
+        Impl impl;
+        std::atomic<bool> stop{false};
+        long writes = 0;
+        const auto start = bench::Clock::now();
+        {
+            std::vector<std::jthread> threads;
+            for (int i=0; i<t; ++i)
+                threads.emplace_back([&]{
+                    while (!stop.load(std::memory_order_relaxed))
+                        impl.read(sum_pass);
+                });
+            threads.emplace_back([&]{
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    impl.write(fill_pass);
+                    ++writes;
+                }
+            });
+            std::this_thread::sleep_for(config.run_time);
+            stop = true;
+        }
+        reporter.add({ "writer_under_load", Impl::NAME, t, "writes_per_s",
+                writes / (bench::elapsed_ns(start) / 1e9) });
+    }
+}
+
+template <typename Impl>
+void tail_latency(bench::Reporter& reporter, const Config& config)
+{
+    for (int t=1; t<=config.max_threads; t*=2)
+    {
+        Impl impl;
+        std::atomic<bool> stop{false};
+        std::vector<std::vector<double>> samples(t);
+        {
+            std::vector<std::jthread> threads;
+            for (int i=0; i<t; ++i)
+                threads.emplace_back([&, i]{
+                    std::vector<double>& mine = samples[i];
+                    mine.reserve(1 << 20);
+                    while (!stop.load(std::memory_order_relaxed))
+                    {
+                        const auto start = bench::Clock::now();
+                        impl.acquire_read();
+                        mine.push_back(bench::elapsed_ns(start));
+                    }
+                });
+            threads.emplace_back([&]{
+                while (!stop.load(std::memory_order_relaxed))
+                    impl.write(short_write);
+            });
+            std::this_thread::sleep_for(config.run_time);
+            stop = true;
+        }
+        std::vector<double> all;
+        for (const auto& mine : samples)
+            all.insert(all.end(), mine.begin(), mine.end());
+        const std::pair<const char*, double> QUANTILES[]
+            = { {"p50_ns", 0.5}, {"p99_ns", 0.99}, {"p999_ns", 0.999} };
+        for (const auto& [metric, q] : QUANTILES)
+            reporter.add({ "tail_latency", Impl::NAME, t, metric,
+                    bench::percentile(all, q) });
+    }
+}
+
+template <typename Impl>
+void run(bench::Reporter& reporter, const Config& config)
+{
+    acquire<Impl>(reporter);
+    iterate<Impl>(reporter, config);
+    reader_scaling<Impl>(reporter, config);
+    if constexpr (Impl::GUARDED)
+    {
+        writer_under_load<Impl>(reporter, config);
+        tail_latency<Impl>(reporter, config);
+    }
+}
+
+// g++ -std=c++20 -O2 -pthread bench/safe_array.cpp -o ~/bin/safety/bench_safe_array
+int main(int argc, char** argv)
+{
+    Config config;
+    config.max_threads = (argc > 1) ? std::stoi( argv[1] ) : 0;
+    if (config.max_threads <= 0)
+        config.max_threads = std::thread::hardware_concurrency();
+    const std::string json_file = (argc > 2) ? argv[2] : "";
+    config.run_time = std::chrono::milliseconds(
+            (argc > 3) ? std::stoi( argv[3] ) : 200 );
+
+    bench::Reporter reporter{"safe_array"};
+    run<SafeArrayImpl>(reporter, config);
+    run<FixedImpl>(reporter, config);
+    run<SharedMutexImpl>(reporter, config);
+    run<UnguardedImpl>(reporter, config);
+    if (!json_file.empty())
+        reporter.save_json(json_file);
+    return 0;
+}
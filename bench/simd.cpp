@@ -0,0 +1,128 @@
+// sa::simd kernels against the SafeIterator loops they replace.
+//
+// For each of sum, max, count_above, find_first_above (with no hit, so a
+// full pass) and dot, and each element type, the cost per element of
+//   type/iterator      a loop over cbegin()..cend()
+//   type/scalar        the kernel at LEVEL::SCALAR
+//   type/avx2, avx512  the kernel at that level, if the CPU has it
+//
+//     bench_simd [size] [json_file]
+//
+// Build without -DNDEBUG to see what the iterator's per-element asserts
+// cost in a debug build.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include "bench.h"
+#include "../safe-containers/simd.h"
+
+using sa::simd::LEVEL;
+
+constexpr int PASSES = 20;
+
+template <typename F>
+double ns_per_element(int size, F pass)
+{
+    pass();     // Warm up
+    const auto start = bench::Clock::now();
+    for (int i=0; i<PASSES; ++i)
+        pass();
+    return bench::elapsed_ns(start) / ((double)PASSES * size);
+}
+
+template <typename T>
+void run(bench::Reporter& reporter, const std::string& type, int size)
+{
+    sa::SafeArray<T> a(size, [](int i){ return (T)(i % 1000); });
+    sa::SafeArray<T> b(size, [](int i){ return (T)(i % 7); });
+    const T above_all = 1000;
+
+    auto add = [&](const char* kernel, const std::string& impl, double ns){
+        reporter.add({ kernel, type + "/" + impl, 1, "ns_per_element", ns });
+    };
+
+    add("sum", "iterator", ns_per_element(size, [&]{
+            sa::simd::sum_type<T> sum = 0;
+            const auto end = a.cend();
+            for (auto it=a.cbegin(); it!=end; ++it)
+                sum += *it;
+            bench::do_not_optimize(sum);
+            }));
+    add("max", "iterator", ns_per_element(size, [&]{
+            const auto end = a.cend();
+            auto it = a.cbegin();
+            T best = *it;
+            for ( ; it!=end; ++it)
+                best = std::max(best, *it);
+            bench::do_not_optimize(best);
+            }));
+    add("count_above", "iterator", ns_per_element(size, [&]{
+            std::size_t count = 0;
+            const auto end = a.cend();
+            for (auto it=a.cbegin(); it!=end; ++it)
+                count += *it > above_all;
+            bench::do_not_optimize(count);
+            }));
+    add("find_first_above", "iterator", ns_per_element(size, [&]{
+            int i = 0;
+            const auto end = a.cend();
+            for (auto it=a.cbegin(); it!=end && !(*it > above_all); ++it)
+                ++i;
+            bench::do_not_optimize(i);
+            }));
+    add("dot", "iterator", ns_per_element(size, [&]{
+            sa::simd::sum_type<T> dot = 0;
+            const auto end = a.cend();
+            auto jt = b.cbegin();
+            for (auto it=a.cbegin(); it!=end; ++it, ++jt)
+                dot += (sa::simd::sum_type<T>)*it * *jt;
+            bench::do_not_optimize(dot);
+            }));
+
+    const std::pair<LEVEL, const char*> LEVELS[] = {
+        {LEVEL::SCALAR, "scalar"}, {LEVEL::AVX2, "avx2"},
+        {LEVEL::AVX512, "avx512"} };
+    for (const auto& [level, name] : LEVELS)
+    {
+        if (level > sa::simd::detected_level())
+            continue;
+        sa::simd::set_max_level(level);
+        add("sum", name, ns_per_element(size, [&]{
+                bench::do_not_optimize(sa::simd::sum(a));
+                }));
+        add("max", name, ns_per_element(size, [&]{
+                bench::do_not_optimize(sa::simd::max(a));
+                }));
+        add("count_above", name, ns_per_element(size, [&]{
+                bench::do_not_optimize(sa::simd::count_above(a, above_all));
+                }));
+        add("find_first_above", name, ns_per_element(size, [&]{
+                bench::do_not_optimize(
+                        sa::simd::find_first_above(a, above_all));
+                }));
+        add("dot", name, ns_per_element(size, [&]{
+                bench::do_not_optimize(sa::simd::dot(a, b));
+                }));
+    }
+    sa::simd::set_max_level(LEVEL::AVX512);
+}
+
+// g++ -std=c++20 -O2 -pthread bench/simd.cpp -o ~/bin/safety/bench_simd
+int main(int argc, char** argv)
+{
+    const int size = (argc > 1) ? std::stoi( argv[1] ) : 1 << 20;
+    const std::string json_file = (argc > 2) ? argv[2] : "";
+
+    bench::Reporter reporter{"simd"};
+    run<float>(reporter, "float", size);
+    run<double>(reporter, "double", size);
+    run<std::int32_t>(reporter, "int32", size);
+    run<std::int64_t>(reporter, "int64", size);
+    if (!json_file.empty())
+        reporter.save_json(json_file);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Insert and range-scan throughput of SafeSkipListMap from 1 to 64 threads.
+//
+// For each thread count t:
+//   insert  t threads insert disjoint random keys into a pre-filled map
+//   scan    t threads run 100-key range scans while one thread inserts
+// Both run in each RANGE_MODE.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_skip_list_map.h"
+
+using namespace std::chrono_literals;
+using SSLM = sa::SafeSkipListMap<std::uint64_t, std::uint64_t>;
+
+constexpr auto RUN_TIME = 300ms;
+constexpr int PREFILL = 100000;
+constexpr int SCAN_WIDTH = 100;
+
+std::uint64_t key_for(int thread, std::uint64_t i)
+{
+    // Spread keys over the whole space while keeping threads disjoint.
+    return (i * 0x9E3779B97F4A7C15ull) ^ ((std::uint64_t)thread << 56);
+}
+
+void prefill(SSLM& map)
+{
+    for (int i=0; i<PREFILL; ++i)
+        map.insert(key_for(255, i), i);
+}
+
+double insert_throughput(SSLM::RANGE_MODE mode, int num_threads)
+{
+    SSLM map{mode};
+    prefill(map);
+    std::atomic<bool> stop{false};
+    std::atomic<long> ops{0};
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&, t]{
+                    long n = 0;
+                    for ( ; !stop.load(std::memory_order_relaxed); ++n)
+                        map.insert(key_for(t, PREFILL + n), n);
+                    ops += n;
+                    });
+        std::this_thread::sleep_for(RUN_TIME);
+        stop = true;
+    }
+    return ops / std::chrono::duration<double>(RUN_TIME).count();
+}
+
+double scan_throughput(SSLM::RANGE_MODE mode, int num_threads)
+{
+    SSLM map{mode};
+    prefill(map);
+    std::atomic<bool> stop{false};
+    std::atomic<long> ops{0};
+    {
+        std::vector<std::jthread> threads;
+        threads.emplace_back([&]{
+                long n = 0;
+                for ( ; !stop.load(std::memory_order_relaxed); ++n)
+                    map.insert(key_for(0, PREFILL + n), n);
+                });
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&, t]{
+                    std::mt19937_64 rng(t);
+                    long n = 0;
+                    std::uint64_t sum = 0;
+                    while ( !stop.load(std::memory_order_relaxed) )
+                    {
+                        int ct = 0;
+                        for (const auto& entry : map.range_from(rng()))
+                        {
+                            sum += entry.second;
+                            if (++ct == SCAN_WIDTH)
+                                break;
+                        }
+                        ++n;
+                    }
+                    ops += n + (sum == 42);
+                    });
+        std::this_thread::sleep_for(RUN_TIME);
+        stop = true;
+    }
+    return ops / std::chrono::duration<double>(RUN_TIME).count();
+}
+
+// g++ -std=c++20 -O2 -pthread bench/skip_list_map.cpp -o ~/bin/safety/bench_skip_list_map
+int main(int argc, char** argv)
+{
+    const int max_threads = (argc > 1) ? std::stoi( argv[1] ) : 64;
+
+    std::cout << std::setw(8) << "mode" << std::setw(9) << "threads"
+        << std::setw(16) << "inserts/s" << std::setw(16) << "scans/s"
+        << std::endl;
+    for (auto mode : {SSLM::RANGE_MODE::WEAK, SSLM::RANGE_MODE::SNAPSHOT})
+    {
+        for (int t=1; t<=max_threads; t*=2)
+        {
+            std::cout << std::setw(8)
+                << (mode == SSLM::RANGE_MODE::WEAK ? "weak" : "snapshot")
+                << std::setw(9) << t
+                << std::setw(16) << (long)insert_throughput(mode, t)
+                << std::setw(16) << (long)scan_throughput(mode, t)
+                << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Checkpointing a SafeArray to disk.
+//
+//   iostream   per-element ofstream writes through cbegin(), the old way
+//   DIRECT     save() with writev() straight from storage
+//   SNAPSHOT   save() from a copy taken under the read session
+//
+// For each, 'checkpoint' is the wall time of the save and 'blocked' is the
+// longest a concurrent writer had to wait for its write session meanwhile.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../safe-containers/safe_array.h"
+
+using Clock = std::chrono::steady_clock;
+using Ms = std::chrono::duration<double, std::milli>;
+
+template <typename Save>
+void run(const std::string& label, sa::SafeArray<long>& array, Save save)
+{
+    std::atomic<bool> done{false};
+    double blocked = 0;
+    std::jthread writer{[&]{
+        while (!done)
+        {
+            const auto start = Clock::now();
+            {
+                auto it = array.begin();
+                *it += 1;
+            }
+            blocked = std::max(blocked, Ms(Clock::now() - start).count());
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    const auto start = Clock::now();
+    save();
+    const double checkpoint = Ms(Clock::now() - start).count();
+    done = true;
+    writer.join();
+    std::cout << std::setw(12) << label << std::setw(18) << checkpoint
+        << std::setw(14) << blocked << std::endl;
+}
+
+// g++ -std=c++20 -O2 -pthread bench/snapshot.cpp -o ~/bin/safety/bench_snapshot
+int main(int argc, char** argv)
+{
+    const int n = (argc > 1) ? std::stoi( argv[1] ) : 32 << 20;
+    const std::string path = (argc > 2) ? argv[2]
+        : "/tmp/bench_snapshot." + std::to_string(getpid());
+
+    sa::SafeArray<long> array{n, [](int i){ return (long)i; }};
+
+    std::cout << std::setw(12) << "method" << std::setw(18)
+        << "checkpoint ms" << std::setw(14) << "blocked ms" << std::endl;
+    run("iostream", array, [&]{
+        std::ofstream out{path, std::ios::binary};
+        for (auto it=array.cbegin(); it!=array.cend(); ++it)
+            out.write(reinterpret_cast<const char*>(&*it), sizeof(long));
+    });
+    for (const auto mode : {sa::SAVE_MODE::DIRECT, sa::SAVE_MODE::SNAPSHOT})
+    {
+        run(mode == sa::SAVE_MODE::DIRECT ? "DIRECT" : "SNAPSHOT", array,
+                [&]{
+                    const int fd = open(path.c_str(),
+                            O_WRONLY | O_CREAT | O_TRUNC, 0600);
+                    array.save(fd, mode);
+                    close(fd);
+                });
+    }
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    const auto start = Clock::now();
+    const auto loaded = sa::SafeArray<long>::load(fd);
+    std::cout << std::setw(12) << "load" << std::setw(18)
+        << Ms(Clock::now() - start).count() << std::endl;
+    close(fd);
+    unlink(path.c_str());
+    return loaded.size() == n ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+// SafeArray sorting against the workaround it replaces, in milliseconds of
+// write session (hold) per sort of random data.
+//
+//   copy_sort_copy  copy out to a std::vector through begin()..end(),
+//                   std::sort, and copy back, all in one write session
+//   sort            sort(): radix sorted, as std::less orders the elements
+//   sort_greater    sort(std::greater<>()): merge sorted
+//   stable_sort     stable_sort()
+//
+// for long and double elements, on 1 thread and on threads.
+//
+//     bench_sort [size] [threads] [json_file]
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "../safe-containers/safe_array.h"
+
+constexpr int PASSES = 3;
+
+template <typename T, typename F>
+double ms_per_sort(sa::SafeArray<T>& array, const std::vector<T>& values,
+        F sort)
+{
+    double total_ns = 0;
+    for (int i=0; i<PASSES; ++i)
+    {
+        array.assign(values);
+        const auto start = bench::Clock::now();
+        sort();
+        total_ns += bench::elapsed_ns(start);
+    }
+    return total_ns / PASSES / 1e6;
+}
+
+template <typename T>
+void run(bench::Reporter& reporter, const std::string& type, int size,
+        int max_threads)
+{
+    std::mt19937_64 gen(1);
+    std::vector<T> values(size);
+    for (T& x : values)
+        x = (T)(gen() >> 1) - (T)(gen() >> 2);
+    sa::SafeArray<T> array(size);
+
+    auto add = [&](const char* benchmark, int threads, double ms){
+        reporter.add({ benchmark, type, threads, "ms_per_sort", ms });
+    };
+
+    add("copy_sort_copy", 1, ms_per_sort(array, values, [&]{
+            std::vector<T> copy;
+            copy.reserve(size);
+            auto it = array.begin();
+            for (int i=0; i<size; ++i, ++it)
+                copy.push_back(*it);
+            std::sort(copy.begin(), copy.end());
+            auto jt = array.begin();
+            for (int i=0; i<size; ++i, ++jt)
+                *jt = copy[i];
+            }));
+    for (int threads : { 1, max_threads })
+    {
+        const sa::ParallelInit init{threads};
+        add("sort", threads, ms_per_sort(array, values, [&]{
+                array.sort(std::less<>(), init);
+                }));
+        add("sort_greater", threads, ms_per_sort(array, values, [&]{
+                array.sort(std::greater<>(), init);
+                }));
+        add("stable_sort", threads, ms_per_sort(array, values, [&]{
+                array.stable_sort(std::less<>(), init);
+                }));
+        if (max_threads == 1)
+            break;
+    }
+}
+
+// g++ -std=c++20 -O2 -pthread bench/sort.cpp -o ~/bin/safety/bench_sort
+int main(int argc, char** argv)
+{
+    const int size = (argc > 1) ? std::stoi( argv[1] ) : 1 << 24;
+    const int threads = (argc > 2) ? std::stoi( argv[2] )
+        : (int)std::max(1u, std::thread::hardware_concurrency());
+    const std::string json_file = (argc > 3) ? argv[3] : "";
+
+    bench::Reporter reporter{"sort"};
+    run<long>(reporter, "long", size, threads);
+    run<double>(reporter, "double", size, threads);
+
+    if (!json_file.empty())
+        reporter.save_json(json_file);
+    return 0;
+}
@@ -1,39 +1,335 @@
 #ifndef LOG_H
 #define LOG_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#if __has_include(<format>)
+    #include <format>
+#endif
 
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Asynchronous line logger.
+//
+// add() stages text in a buffer private to the calling thread; write()
+// appends its argument and a newline and hands the whole line to a background
+// writer thread through a bounded lock-free queue.  The caller never waits on
+// I/O and never takes a lock: a write() is a copy into the queue's
+// preallocated slots.  The writer drains the queue in batches, so many lines
+// go out in one write(2) call.
+//
+// Lines from one thread appear in order and are never interleaved with other
+// lines.  Output for std::cout and std::cerr/std::clog goes straight to file
+// descriptor 1 or 2; any other stream is written, by the writer thread only,
+// through the stream itself.  The queue holds CAPACITY slots of SLOT_PAYLOAD
+// bytes; when it is full, the POLICY decides whether write() waits for space
+// (BLOCK, the default) or discards the line (DROP, counted by
+// get_dropped_ct()).  flush() waits until everything written so far is out,
+// and the queue is drained at exit, so a stream other than the standard ones
+// has to outlive the last write(), or be flushed before it goes.
 class Log
 {
     public:
+        enum class POLICY
+        {
+            BLOCK,
+            DROP
+        };
+
+        static constexpr std::size_t CAPACITY = 8192;
+        static constexpr std::size_t SLOT_PAYLOAD = 116;
+        // Longer lines are truncated.
+        static constexpr std::size_t MAX_LINE = SLOT_PAYLOAD * CAPACITY / 8;
+
+        // The stream is fixed by the first call.
         static Log& instance(std::ostream& ostm=std::cout)
         {
-            if (!_instance)
-                _instance = new Log(ostm);
-            return *_instance;
+            static Log* const log = _instance = new Log(ostm);
+            return *log;
         }
 
-        void add(std::string const& mesg)
+        void add(std::string_view mesg)
         {
-            _buffer += mesg;
+            _staging().append(mesg);
         }
-        void write(std::string mesg="")
+        void write(std::string_view mesg={})
         {
-            std::lock_guard<std::mutex> lock{_mutex};
-            _ostm << _buffer << mesg << std::endl << std::flush;
-            _buffer = "";
+            std::string& line = _staging();
+            line.append(mesg);
+            _commit(line);
         }
+#ifdef __cpp_lib_format
+        // Formats straight into the thread's staging buffer, then writes it
+        // as one line.
+        template <typename... Args>
+        void writef(std::format_string<Args...> fmt, Args&&... args)
+        {
+            std::string& line = _staging();
+            std::format_to(std::back_inserter(line), fmt,
+                    std::forward<Args>(args)...);
+            _commit(line);
+        }
+#endif
+
+        // Blocks until every line written before the call is out.
+        void flush()
+        {
+            if (_direct.load())
+                return;
+            const std::uint64_t target = _tail.load(std::memory_order_acquire);
+            _wake_writer(true);
+            for (std::uint64_t w=_written.load(); w<target; w=_written.load())
+                _written.wait(w);
+        }
+
+        void set_policy(POLICY policy) { _policy.store(policy); }
+        POLICY get_policy() const { return _policy.load(); }
+        std::uint64_t get_dropped_ct() const { return _dropped.load(); }
 
     private:
-        Log(std::ostream& ostm) : _ostm{ostm} {}
+        // A slot is free for position p while seq == p, and holds position
+        // p's bytes once seq == p + 1.
+        struct alignas(64) Slot
+        {
+            std::atomic<std::uint64_t> seq;
+            std::uint32_t len;
+            char data[SLOT_PAYLOAD];
+        };
+        static_assert(sizeof(Slot) == 128);
+
+        static constexpr std::size_t BATCH_BYTES = 1 << 16;
+        static constexpr std::size_t STAGING_RESERVE = 256;
+
+        Log(std::ostream& ostm)
+            : _ostm{ostm},
+            _fd{ &ostm == &std::cout ? 1
+                : (&ostm == &std::cerr || &ostm == &std::clog) ? 2 : -1 },
+            _slots{ new Slot[CAPACITY] },
+            _batch{ new char[BATCH_BYTES] }
+        {
+            for (std::size_t i=0; i<CAPACITY; ++i)
+                _slots[i].seq.store(i, std::memory_order_relaxed);
+            _writer = std::thread{ [this]{ _run(); } };
+            // A forked child has no writer thread; it writes synchronously.
+            pthread_atfork(nullptr, nullptr, []{ _instance->_direct = true; });
+            std::atexit([]{ _instance->_shutdown(); });
+        }
+
+        static std::string& _staging()
+        {
+            thread_local std::string line = []{
+                std::string s;
+                s.reserve(STAGING_RESERVE);
+                return s;
+            }();
+            return line;
+        }
+
+        // Queues line plus a newline and leaves line empty, its capacity
+        // kept for the next one.
+        void _commit(std::string& line)
+        {
+            if (line.size() >= MAX_LINE)
+                line.resize(MAX_LINE - 1);
+            line += '\n';
+            if (_direct.load(std::memory_order_relaxed))
+            {
+                std::lock_guard<std::mutex> lock{_direct_mutex};
+                _emit(line.data(), line.size());
+            }
+            else
+                _push(line.data(), line.size());
+            line.clear();
+        }
+
+        void _push(const char* p, std::size_t n)
+        {
+            const std::uint64_t k = (n + SLOT_PAYLOAD - 1) / SLOT_PAYLOAD;
+            std::uint64_t pos = _tail.load(std::memory_order_relaxed);
+            while (true)
+            {
+                // The writer frees slots in order, so if the last slot the
+                // line needs is free, so are those before it.
+                const Slot& last = _slots[(pos + k - 1) % CAPACITY];
+                const std::int64_t diff
+                    = last.seq.load(std::memory_order_acquire) - (pos + k - 1);
+                if (diff == 0)
+                {
+                    if (_tail.compare_exchange_weak(pos, pos + k,
+                                std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff > 0)
+                    pos = _tail.load(std::memory_order_relaxed);
+                else if (_policy.load(std::memory_order_relaxed)
+                        == POLICY::DROP)
+                {
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else
+                {
+                    _wait_for_space(pos + k - CAPACITY);
+                    pos = _tail.load(std::memory_order_relaxed);
+                }
+            }
+            for (std::uint64_t i=0; i<k; ++i, p+=SLOT_PAYLOAD, n-=SLOT_PAYLOAD)
+            {
+                Slot& slot = _slots[(pos + i) % CAPACITY];
+                slot.len = std::min(n, SLOT_PAYLOAD);
+                std::memcpy(slot.data, p, slot.len);
+                slot.seq.store(pos + i + 1, std::memory_order_release);
+            }
+            _wake_writer(false);
+        }
+
+        // Blocks until the writer has consumed up to position 'consumed'.
+        void _wait_for_space(std::uint64_t consumed)
+        {
+            _blocked.fetch_add(1);
+            _wake_writer(true);
+            for (std::uint64_t c=_consumed.load(); c<consumed;
+                    c=_consumed.load())
+                _consumed.wait(c);
+            _blocked.fetch_sub(1);
+        }
+
+        // Wakes the writer if it is asleep, or unconditionally if 'always'.
+        // A wake-up lost to the race with falling asleep costs at most
+        // IDLE_WAIT.
+        void _wake_writer(bool always)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (always || _sleeping.load(std::memory_order_relaxed))
+                _cv.notify_one();
+        }
+
+        static constexpr auto IDLE_WAIT = std::chrono::milliseconds(10);
+
+        void _run()
+        {
+            std::unique_lock<std::mutex> lock{_cv_mutex};
+            while (true)
+            {
+                if (_drain())
+                    continue;
+                if (_stop.load())
+                    return;
+                _sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!_ready())
+                    _cv.wait_for(lock, IDLE_WAIT);
+                _sleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        bool _ready() const
+        {
+            return _slots[_head % CAPACITY].seq.load(std::memory_order_acquire)
+                == _head + 1;
+        }
+
+        // Copies out every ready slot, frees it, and emits the bytes in
+        // batches.  Returns whether there was anything to do.
+        bool _drain()
+        {
+            std::size_t bytes = 0;
+            const std::uint64_t start = _head;
+            while (_ready())
+            {
+                Slot& slot = _slots[_head % CAPACITY];
+                if (bytes + slot.len > BATCH_BYTES)
+                {
+                    _emit(_batch.get(), bytes);
+                    bytes = 0;
+                }
+                std::memcpy(_batch.get() + bytes, slot.data, slot.len);
+                bytes += slot.len;
+                slot.seq.store(_head + CAPACITY, std::memory_order_release);
+                ++_head;
+                _consumed.store(_head);
+                if (_blocked.load())
+                    _consumed.notify_all();
+            }
+            _emit(_batch.get(), bytes);
+            _written.store(_head);
+            _written.notify_all();
+            return _head != start;
+        }
+
+        void _emit(const char* p, std::size_t n)
+        {
+            if (n == 0)
+                return;
+            if (_fd < 0)
+            {
+                _ostm.write(p, n);
+                _ostm.flush();
+                return;
+            }
+            while (n > 0)
+            {
+                const ssize_t w = ::write(_fd, p, n);
+                if (w < 0 && errno == EINTR)
+                    continue;
+                if (w <= 0)
+                    return;
+                p += w;
+                n -= w;
+            }
+        }
+
+        void _shutdown()
+        {
+            // A forked child leaves what it inherited in the queue to its
+            // parent.
+            if (_direct.exchange(true))
+                return;
+            if (_writer.joinable())
+            {
+                _stop.store(true);
+                _wake_writer(true);
+                _writer.join();
+            }
+            // Lines queued by threads still running.
+            _drain();
+        }
+
+        static inline Log* _instance = nullptr;
 
-        static Log* _instance;
-        std::string _buffer;
         std::ostream& _ostm;
-        std::mutex _mutex;
-};
+        const int _fd;
+        std::unique_ptr<Slot[]> _slots;
+        std::unique_ptr<char[]> _batch;
+
+        alignas(64) std::atomic<std::uint64_t> _tail{0};
+        alignas(64) std::uint64_t _head{0};      // writer thread only
+        std::atomic<std::uint64_t> _consumed{0};
+        std::atomic<std::uint64_t> _written{0};
+        alignas(64) std::atomic<int> _blocked{0};
+        std::atomic<bool> _sleeping{false};
+        std::atomic<bool> _stop{false};
+        std::atomic<bool> _direct{false};
+        std::atomic<POLICY> _policy{POLICY::BLOCK};
+        std::atomic<std::uint64_t> _dropped{0};
 
-Log* Log::_instance = nullptr;
+        std::mutex _cv_mutex;
+        std::condition_variable _cv;
+        std::mutex _direct_mutex;
+        std::thread _writer;
+};
 
 #endif // LOG_H
@@ -0,0 +1,284 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+// Aggregated scope profiling: the backend ScopeTracker uses when built with
+// PROFILE_SCOPES.
+//
+// Rather than a log line or trace event per call, each scope's duration goes
+// into a latency histogram, one per scope per thread, so recording is a
+// handful of relaxed stores with no lock and no sharing between threads.
+// Profile::stats() merges every thread's histograms on demand into per-scope
+// call counts and percentiles, which write_table() and write_json() print.
+// Cheap enough to leave on: a histogram is 8KB, allocated the first time a
+// thread passes through a given scope.  When a thread exits, its histograms
+// go to the next thread that starts recording, which counts on into them;
+// so with thread churn memory follows the most threads ever recording at
+// once, not every thread there has been.
+
+// Log-linear (HDR-style) histogram of nanosecond durations.  Values below
+// SUB_BUCKETS are exact; above that each power of two is split into
+// SUB_BUCKETS equal buckets, so a recorded value is off by at most 1/16th.
+// One thread records; any thread may read concurrently.
+class ScopeHistogram
+{
+    public:
+        static constexpr int SUB_BITS = 4;
+        static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+        static constexpr int NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+        void record(std::uint64_t ns)
+        {
+            _bump(_buckets[bucket(ns)], 1);
+            _bump(_count, 1);
+            _bump(_sum, ns);
+            if (ns > _max.load(std::memory_order_relaxed))
+                _max.store(ns, std::memory_order_relaxed);
+        }
+
+        static int bucket(std::uint64_t ns)
+        {
+            if (ns < SUB_BUCKETS)
+                return ns;
+            const int exp = std::bit_width(ns) - 1;
+            const int sub = (ns >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1);
+            return (exp - SUB_BITS + 1) * SUB_BUCKETS + sub;
+        }
+        // The largest value that falls in bucket b.
+        static std::uint64_t bucket_max(int b)
+        {
+            if (b < SUB_BUCKETS)
+                return b;
+            const int exp = b / SUB_BUCKETS + SUB_BITS - 1;
+            const std::uint64_t sub = b % SUB_BUCKETS;
+            const std::uint64_t width = std::uint64_t(1) << (exp - SUB_BITS);
+            return (std::uint64_t(1) << exp) + (sub + 1) * width - 1;
+        }
+
+    private:
+        friend class Profile;
+
+        // Single writer, so a plain load and store; fetch_add would cost a
+        // locked instruction for nothing.
+        static void _bump(std::atomic<std::uint64_t>& a, std::uint64_t n)
+        {
+            a.store(a.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+        }
+
+        std::atomic<std::uint64_t> _buckets[NUM_BUCKETS] = {};
+        std::atomic<std::uint64_t> _count{0};
+        std::atomic<std::uint64_t> _sum{0};
+        std::atomic<std::uint64_t> _max{0};
+};
+
+// One scope's durations, merged across threads.
+struct ScopeStats
+{
+    std::string name;
+    std::uint64_t count;
+    std::uint64_t mean_ns;
+    std::uint64_t p50_ns;
+    std::uint64_t p90_ns;
+    std::uint64_t p99_ns;
+    std::uint64_t max_ns;
+};
+
+class Profile
+{
+    public:
+        // Scope ids, as handed out by ScopeName, must stay below this.
+        static constexpr std::uint32_t MAX_SCOPES = 4096;
+
+        static Profile& instance()
+        {
+            static Profile profile;
+            return profile;
+        }
+
+        // Lock-free after the calling thread's first call.
+        void record(std::uint32_t scope_id, std::uint64_t ns)
+        {
+            thread_local HistogramsHolder holder{ this, _register_thread() };
+            if (scope_id < MAX_SCOPES)
+                holder.histograms->get(scope_id).record(ns);
+        }
+
+        // Per-thread histogram sets allocated so far, in use or kept for
+        // the next thread.
+        std::size_t get_thread_ct() const
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            return _threads.size();
+        }
+
+        // Every scope entered so far, merged across threads, busiest first.
+        std::vector<ScopeStats> stats() const
+        {
+            std::vector<ScopeStats> out;
+            std::lock_guard<std::mutex> lock{_mutex};
+            std::vector<std::uint64_t> buckets(ScopeHistogram::NUM_BUCKETS);
+            for (std::uint32_t id=0; id<MAX_SCOPES; ++id)
+            {
+                std::fill(buckets.begin(), buckets.end(), 0);
+                std::uint64_t count = 0, sum = 0, max = 0;
+                for (const auto& thread : _threads)
+                {
+                    const ScopeHistogram* h = thread->find(id);
+                    if (!h)
+                        continue;
+                    for (int b=0; b<ScopeHistogram::NUM_BUCKETS; ++b)
+                        buckets[b] += _load(h->_buckets[b]);
+                    count += _load(h->_count);
+                    sum += _load(h->_sum);
+                    max = std::max(max, _load(h->_max));
+                }
+                if (count == 0)
+                    continue;
+                // The bucket counts may trail _count by an in-flight call.
+                std::uint64_t total = 0;
+                for (std::uint64_t n : buckets)
+                    total += n;
+                out.push_back( ScopeStats{ Trace::instance().name(id), count,
+                        sum / count, _percentile(buckets, total, 0.50, max),
+                        _percentile(buckets, total, 0.90, max),
+                        _percentile(buckets, total, 0.99, max), max } );
+            }
+            std::sort(out.begin(), out.end(),
+                    [](const ScopeStats& a, const ScopeStats& b){
+                        return a.count > b.count;
+                    });
+            return out;
+        }
+
+        void write_table(std::ostream& out) const
+        {
+            out << std::left << std::setw(32) << "scope" << std::right
+                << std::setw(12) << "calls" << std::setw(12) << "mean_ns"
+                << std::setw(12) << "p50_ns" << std::setw(12) << "p90_ns"
+                << std::setw(12) << "p99_ns" << std::setw(12) << "max_ns"
+                << std::endl;
+            for (const ScopeStats& s : stats())
+                out << std::left << std::setw(32) << s.name << std::right
+                    << std::setw(12) << s.count << std::setw(12) << s.mean_ns
+                    << std::setw(12) << s.p50_ns << std::setw(12) << s.p90_ns
+                    << std::setw(12) << s.p99_ns << std::setw(12) << s.max_ns
+                    << std::endl;
+        }
+
+        void write_json(std::ostream& out) const
+        {
+            out << "{\"scopes\":[";
+            bool first = true;
+            for (const ScopeStats& s : stats())
+            {
+                out << (first ? "\n" : ",\n") << "{\"name\":"
+                    << json_quoted(s.name) << ",\"count\":" << s.count
+                    << ",\"mean_ns\":" << s.mean_ns << ",\"p50_ns\":"
+                    << s.p50_ns << ",\"p90_ns\":" << s.p90_ns
+                    << ",\"p99_ns\":" << s.p99_ns << ",\"max_ns\":"
+                    << s.max_ns << "}";
+                first = false;
+            }
+            out << "\n]}\n";
+        }
+
+    private:
+        // One thread's histograms, indexed by scope id and allocated on
+        // first use.  Only the owner allocates; readers see a histogram once
+        // its pointer is published.
+        class ThreadHistograms
+        {
+            public:
+                ScopeHistogram& get(std::uint32_t id)
+                {
+                    ScopeHistogram* h
+                        = _histograms[id].load(std::memory_order_relaxed);
+                    if (!h)
+                    {
+                        h = new ScopeHistogram;
+                        _histograms[id].store(h, std::memory_order_release);
+                    }
+                    return *h;
+                }
+                const ScopeHistogram* find(std::uint32_t id) const
+                {
+                    return _histograms[id].load(std::memory_order_acquire);
+                }
+
+                ~ThreadHistograms()
+                {
+                    for (auto& h : _histograms)
+                        delete h.load(std::memory_order_relaxed);
+                }
+
+            private:
+                std::atomic<ScopeHistogram*> _histograms[MAX_SCOPES] = {};
+        };
+
+        // Hands the thread's histograms back when the thread exits.  The
+        // mutex also makes its last counts visible to the next owner.
+        struct HistogramsHolder
+        {
+            Profile* profile;
+            ThreadHistograms* histograms;
+            ~HistogramsHolder()
+            {
+                std::lock_guard<std::mutex> lock{profile->_mutex};
+                profile->_free.push_back(histograms);
+            }
+        };
+
+        Profile() = default;
+
+        ThreadHistograms* _register_thread()
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            // Kept after the thread exits, so its calls still count.
+            if (!_free.empty())
+            {
+                ThreadHistograms* histograms = _free.back();
+                _free.pop_back();
+                return histograms;
+            }
+            _threads.emplace_back(new ThreadHistograms);
+            return _threads.back().get();
+        }
+
+        static std::uint64_t _load(const std::atomic<std::uint64_t>& a)
+        {
+            return a.load(std::memory_order_relaxed);
+        }
+        // The smallest bucket bound with at least fraction q of the values
+        // at or below it, capped at the true maximum.
+        static std::uint64_t _percentile(
+                const std::vector<std::uint64_t>& buckets,
+                std::uint64_t total, double q, std::uint64_t max)
+        {
+            const std::uint64_t rank
+                = std::max<std::uint64_t>(1, q * total + 0.5);
+            std::uint64_t seen = 0;
+            for (int b=0; b<ScopeHistogram::NUM_BUCKETS; ++b)
+                if ((seen += buckets[b]) >= rank)
+                    return std::min(ScopeHistogram::bucket_max(b), max);
+            return max;
+        }
+
+        mutable std::mutex _mutex;
+        std::vector<std::unique_ptr<ThreadHistograms>> _threads;
+        std::vector<ThreadHistograms*> _free;   // Of exited threads
+};
+
+#endif // PROFILE_H
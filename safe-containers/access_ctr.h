@@ -1,28 +1,96 @@
 #ifndef ACCESS_CTR_H
 #define ACCESS_CTR_H
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <ranges>
+#include <thread>
 #include <unordered_map>
 
+#include "watchdog.h"
 #include "../scopetracker.h"
 
 #ifdef DEBUG_ACCESS
-    #define FUNC_LOGGING() ScopeTracker scope_tracker{__func__}
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
 #else
     #define FUNC_LOGGING() 0
 #endif
 
+// Contention statistics for one container, as returned by
+// AccessCtr::get_stats().  Waits and holds are histograms with log2
+// nanosecond buckets: bucket b counts durations in [2^b, 2^(b+1)), bucket 0
+// also those under a nanosecond.
+struct AccessStats
+{
+    static constexpr int BUCKETS = 40;          // Up to ~18 minutes
+
+    std::uint64_t read_acquisitions = 0;
+    std::uint64_t write_acquisitions = 0;
+    std::uint64_t wait_hist[BUCKETS] = {};
+    std::uint64_t wait_ns = 0;                  // Total
+    std::uint64_t hold_hist[BUCKETS] = {};
+    std::uint64_t hold_ns = 0;                  // Total
+    // Wake-ups from the condition variable that found the acquisition
+    // still blocked.
+    std::uint64_t futile_wakeups = 0;
+    // Write acquisitions that waited longer than the starvation threshold.
+    std::uint64_t starved_writers = 0;
+    // The most read sessions, write sessions not included, ever open at
+    // once; tracked whether or not stats are on.
+    int max_readers = 0;
+
+    static int bucket(std::uint64_t ns)
+    {
+        return std::min<int>(std::max<int>(std::bit_width(ns), 1) - 1,
+                BUCKETS - 1);
+    }
+
+    void write_json(std::ostream& out) const
+    {
+        auto hist = [&out](const char* name, const std::uint64_t* h)
+        {
+            out << ",\"" << name << "\":[";
+            for (int b=0; b<BUCKETS; ++b)
+                out << (b ? "," : "") << h[b];
+            out << "]";
+        };
+        out << "{\"read_acquisitions\":" << read_acquisitions
+            << ",\"write_acquisitions\":" << write_acquisitions
+            << ",\"wait_ns\":" << wait_ns << ",\"hold_ns\":" << hold_ns
+            << ",\"futile_wakeups\":" << futile_wakeups
+            << ",\"starved_writers\":" << starved_writers
+            << ",\"max_readers\":" << max_readers;
+        hist("wait_hist", wait_hist);
+        hist("hold_hist", hold_hist);
+        out << "}";
+    }
+};
 
 class AccessCtr
 {
     public:
         using thread_id = std::thread::id;
+
+        enum class MODE
+        {
+            READ,
+            READ_WRITE
+        };
+
         AccessCtr() = default;
         ~AccessCtr()
         {
             FUNC_LOGGING();
+            delete _stats.load(std::memory_order_relaxed);
         }
 
         void add_thread( thread_id tid=std::this_thread::get_id() ) 
@@ -41,15 +109,24 @@ class AccessCtr
             FUNC_LOGGING();
             std::lock_guard<std::mutex> lock(_mutex);
             assert( _dict.contains(tid) );
+            const Counters& counters = _dict.at(tid);
+            _open_reads -= counters.reader_ct - counters.writer_ct;
             _dict.erase(tid);
         }
 
-        void reader_update( int update,
+        // Every session counts as a reader; a READ_WRITE one is also
+        // counted as a writer, by writer_update(), but isn't an open read.
+        void reader_update( int update, MODE mode=MODE::READ,
                 thread_id tid=std::this_thread::get_id() )
         {
             FUNC_LOGGING();
             std::lock_guard<std::mutex> lock(_mutex);
             _dict.at(tid).reader_ct += update;
+            if (mode != MODE::READ)
+                return;
+            _open_reads += update;
+            if (_open_reads > _max_reads)
+                _max_reads = _open_reads;
         }
         void writer_update( int update,
                 thread_id tid=std::this_thread::get_id() )
@@ -134,7 +211,211 @@ class AccessCtr
             return false;
         }
 
+        // Contention statistics, off until enabled.  While on, the added
+        // cost is two clock reads per acquisition and relaxed increments on
+        // counters striped by thread; off, a relaxed load.
+        void set_stats_enabled(bool enabled)
+        {
+            if (enabled && !_stats.load(std::memory_order_acquire))
+            {
+                Stats* fresh = new Stats();
+                Stats* expected = nullptr;
+                if (!_stats.compare_exchange_strong(expected, fresh))
+                    delete fresh;
+            }
+            _stats_enabled.store(enabled, std::memory_order_release);
+        }
+        bool get_stats_enabled() const
+        {
+            return _stats_enabled.load(std::memory_order_relaxed);
+        }
+        // Write acquisitions that wait longer than this count as starved.
+        void set_starvation_threshold(std::chrono::nanoseconds threshold)
+        {
+            _starvation_ns.store(threshold.count(), std::memory_order_relaxed);
+        }
+
+        // Everything recorded since stats were first enabled, merged across
+        // threads.  Counters are read as they stand, so a snapshot taken
+        // under load may be off by the operations in flight.
+        AccessStats get_stats() const
+        {
+            AccessStats out;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                out.max_readers = _max_reads;
+            }
+            const Stats* stats = _stats.load(std::memory_order_acquire);
+            if (!stats)
+                return out;
+            auto get = [](const std::atomic<std::uint64_t>& a)
+            {
+                return a.load(std::memory_order_relaxed);
+            };
+            for (const Stripe& s : stats->stripes)
+            {
+                out.read_acquisitions += get(s.acquisitions[0]);
+                out.write_acquisitions += get(s.acquisitions[1]);
+                for (int b=0; b<AccessStats::BUCKETS; ++b)
+                {
+                    out.wait_hist[b] += get(s.wait_hist[b]);
+                    out.hold_hist[b] += get(s.hold_hist[b]);
+                }
+                out.wait_ns += get(s.wait_ns);
+                out.hold_ns += get(s.hold_ns);
+                out.futile_wakeups += get(s.futile_wakeups);
+                out.starved_writers += get(s.starved_writers);
+            }
+            return out;
+        }
+
+        // Reports long holds and waits to 'watchdog', or stops reporting if
+        // it is null; 'name' identifies this container in its reports.
+        // Holds already open when a watchdog is attached aren't reported.
+        void set_watchdog(sa::Watchdog* watchdog, const char* name="")
+        {
+            _watch_name.store(name, std::memory_order_relaxed);
+            _watchdog.store(watchdog, std::memory_order_release);
+        }
+
+        // Waits on cond_var, whose mutex 'lock' holds, until ready() is true.
+        // With stats on, records the acquisition and how long it waited;
+        // with a watchdog, shows it the wait if it blocks.
+        template <typename Ready>
+        void wait(std::condition_variable& cond_var,
+                std::unique_lock<std::mutex>& lock, MODE mode, Ready ready)
+        {
+            Stripe* stripe = _stripe();
+            sa::Watchdog* watchdog = _watchdog.load(std::memory_order_acquire);
+            if (!stripe && !watchdog)
+            {
+                cond_var.wait(lock, ready);
+                return;
+            }
+            const bool writer = mode == MODE::READ_WRITE;
+            const std::uint64_t start = _now_ns();
+            if (!ready())
+            {
+                const int slot = watchdog ? watchdog->enter(this,
+                        _watch_name.load(std::memory_order_relaxed),
+                        sa::Watchdog::ROLE::WAITER, writer, start) : -1;
+                while (true)
+                {
+                    cond_var.wait(lock);
+                    if (ready())
+                        break;
+                    if (stripe)
+                        _bump(stripe->futile_wakeups, 1);
+                }
+                if (slot >= 0)
+                    watchdog->leave(slot);
+            }
+            if (!stripe)
+                return;
+            const std::uint64_t waited = _now_ns() - start;
+            _bump(stripe->acquisitions[writer], 1);
+            _bump(stripe->wait_hist[AccessStats::bucket(waited)], 1);
+            _bump(stripe->wait_ns, waited);
+            if (writer && waited
+                    > _starvation_ns.load(std::memory_order_relaxed))
+                _bump(stripe->starved_writers, 1);
+        }
+
+        // What a session needs to give back when it closes, for the stats
+        // and the watchdog.
+        struct HoldToken
+        {
+            std::uint64_t start{0};     // 0: not timed
+            sa::Watchdog* watchdog{nullptr};
+            int slot{-1};
+        };
+
+        // hold_start() when a session opens, its result to hold_end() when
+        // it closes.  A copy of a session -- SafeIterators are copied to
+        // make more holds -- takes hold_copy() instead: the watchdog sees
+        // it as dating from the original, and the stats don't count it.
+        HoldToken hold_start(MODE mode)
+        {
+            HoldToken token;
+            sa::Watchdog* watchdog = _watchdog.load(std::memory_order_acquire);
+            if (!watchdog && !get_stats_enabled())
+                return token;
+            token.start = _now_ns();
+            if (watchdog)
+                _watch(token, watchdog, mode, token.start);
+            return token;
+        }
+        HoldToken hold_copy(MODE mode, const HoldToken& original)
+        {
+            HoldToken token;
+            sa::Watchdog* watchdog = _watchdog.load(std::memory_order_acquire);
+            if (watchdog)
+                _watch(token, watchdog, mode,
+                        original.start ? original.start : _now_ns());
+            return token;
+        }
+        void hold_end(const HoldToken& token)
+        {
+            if (token.slot >= 0)
+                token.watchdog->leave(token.slot);
+            if (token.start == 0)
+                return;
+            Stripe* stripe = _stripe();
+            if (!stripe)
+                return;
+            const std::uint64_t held = _now_ns() - token.start;
+            _bump(stripe->hold_hist[AccessStats::bucket(held)], 1);
+            _bump(stripe->hold_ns, held);
+        }
+
     private:
+        static constexpr int STRIPES = 16;
+
+        struct alignas(64) Stripe
+        {
+            std::atomic<std::uint64_t> acquisitions[2] = {};
+            std::atomic<std::uint64_t> wait_hist[AccessStats::BUCKETS] = {};
+            std::atomic<std::uint64_t> wait_ns{0};
+            std::atomic<std::uint64_t> hold_hist[AccessStats::BUCKETS] = {};
+            std::atomic<std::uint64_t> hold_ns{0};
+            std::atomic<std::uint64_t> futile_wakeups{0};
+            std::atomic<std::uint64_t> starved_writers{0};
+        };
+        struct Stats
+        {
+            Stripe stripes[STRIPES];
+        };
+
+        // The calling thread's stripe, or null with stats off.
+        Stripe* _stripe()
+        {
+            if (!_stats_enabled.load(std::memory_order_acquire))
+                return nullptr;
+            static std::atomic<int> next{0};
+            thread_local const int stripe
+                = next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+            return &_stats.load(std::memory_order_acquire)->stripes[stripe];
+        }
+        void _watch(HoldToken& token, sa::Watchdog* watchdog, MODE mode,
+                std::uint64_t since)
+        {
+            token.watchdog = watchdog;
+            token.slot = watchdog->enter(this,
+                    _watch_name.load(std::memory_order_relaxed),
+                    sa::Watchdog::ROLE::HOLDER, mode == MODE::READ_WRITE,
+                    since);
+        }
+        static void _bump(std::atomic<std::uint64_t>& a, std::uint64_t n)
+        {
+            a.fetch_add(n, std::memory_order_relaxed);
+        }
+        static std::uint64_t _now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
         struct Counters
         {
             Counters() : reader_ct{0}, writer_ct{0} {}
@@ -143,7 +424,16 @@ class AccessCtr
         };
 
         std::unordered_map<thread_id, Counters> _dict;
+        int _open_reads{0};
+        int _max_reads{0};
         mutable std::mutex _mutex;
+
+        std::atomic<bool> _stats_enabled{false};
+        std::atomic<Stats*> _stats{nullptr};
+        std::atomic<std::uint64_t> _starvation_ns{1000000};
+
+        std::atomic<sa::Watchdog*> _watchdog{nullptr};
+        std::atomic<const char*> _watch_name{""};
 };
 
 #undef FUNC_LOGGING
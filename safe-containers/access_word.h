@@ -0,0 +1,183 @@
+#ifndef ACCESS_WORD_H
+#define ACCESS_WORD_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+
+namespace sa
+{
+
+// A compact, allocation-free stand-in for AccessCtr + condition variable +
+// mutex.  One 32-bit state word holds a writer bit and the number of read
+// holds; waiters sleep on the word itself (C++20 atomic wait, a futex on
+// Linux).  The owning writer's thread id lets that thread take further read
+// and write holds while it writes, which is what makes the usual
+//     for (auto it=sa.begin(); it!=sa.end(); ++it)
+// loop work.
+//
+// Unlike AccessCtr it does not count holds per thread, so a thread that
+// holds only read iterators cannot upgrade to a write hold: it would wait on
+// itself.  Release the read iterators first.
+class AccessWord
+{
+    public:
+        enum class MODE
+        {
+            READ,
+            READ_WRITE
+        };
+
+        AccessWord() = default;
+        AccessWord(const AccessWord&) = delete;
+        AccessWord& operator=(const AccessWord&) = delete;
+
+        void acquire(MODE mode)
+        {
+            if (mode == MODE::READ)
+                acquire_read();
+            else
+                acquire_write();
+        }
+        void release(MODE mode)
+        {
+            if (mode == MODE::READ)
+                release_read();
+            else
+                release_write();
+        }
+
+        void acquire_read()
+        {
+            const std::thread::id tid = std::this_thread::get_id();
+            std::uint32_t state = _state.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                if ( (state & WRITER)
+                        && _owner.load(std::memory_order_relaxed) != tid )
+                {
+                    _state.wait(state, std::memory_order_relaxed);
+                    state = _state.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if ( _state.compare_exchange_weak(state, state + 1,
+                            std::memory_order_acquire,
+                            std::memory_order_relaxed) )
+                    return;
+            }
+        }
+        void release_read()
+        {
+            const std::uint32_t prev
+                = _state.fetch_sub(1, std::memory_order_release);
+            assert( (prev & READERS) > 0 );
+            if ((prev & READERS) == 1)
+                _state.notify_all();
+        }
+
+        void acquire_write()
+        {
+            const std::thread::id tid = std::this_thread::get_id();
+            if (_owner.load(std::memory_order_relaxed) == tid)
+            {
+                ++_write_depth;
+                return;
+            }
+            std::uint32_t state = 0;
+            while ( !_state.compare_exchange_weak(state, WRITER,
+                        std::memory_order_acquire,
+                        std::memory_order_relaxed) )
+            {
+                if (state != 0)
+                {
+                    _state.wait(state, std::memory_order_relaxed);
+                    state = 0;
+                }
+            }
+            _owner.store(tid, std::memory_order_relaxed);
+            _write_depth = 1;
+        }
+        void release_write()
+        {
+            assert( _owner.load(std::memory_order_relaxed)
+                    == std::this_thread::get_id() );
+            if (--_write_depth > 0)
+                return;
+            _owner.store(std::thread::id(), std::memory_order_relaxed);
+            _state.fetch_and(~WRITER, std::memory_order_release);
+            _state.notify_all();
+        }
+
+        // Read holds across all threads.
+        int get_reader_ct() const
+        {
+            return _state.load(std::memory_order_relaxed) & READERS;
+        }
+        // Write holds by the calling thread.
+        int get_writer_ct() const
+        {
+            return (_owner.load(std::memory_order_relaxed)
+                    == std::this_thread::get_id()) ? _write_depth : 0;
+        }
+
+    private:
+        static constexpr std::uint32_t WRITER = 1u << 31;
+        static constexpr std::uint32_t READERS = WRITER - 1;
+
+        std::atomic<std::uint32_t> _state{0};
+        int _write_depth{0};    // Only touched by the owner
+        std::atomic<std::thread::id> _owner{};
+};
+
+// One read or write hold on an AccessWord, released on destruction.  Copies
+// take a hold of their own, like SafeArray's iterators do.  A hold belongs to
+// the thread that took it.
+class AccessHold
+{
+    public:
+        typedef AccessWord::MODE MODE;
+
+        AccessHold(AccessWord& word, MODE mode)
+            : _word{&word},
+            _mode{mode},
+            _tid{ std::this_thread::get_id() }
+        {
+            _word->acquire(_mode);
+        }
+        AccessHold(const AccessHold& rhs)
+            : _word{rhs._word},
+            _mode{rhs._mode},
+            _tid{ std::this_thread::get_id() }
+        {
+            assert( _tid == rhs._tid );
+            _word->acquire(_mode);
+        }
+        AccessHold& operator=(const AccessHold& rhs)
+        {
+            if (this != &rhs)
+            {
+                AccessHold copy{rhs};
+                std::swap(_word, copy._word);
+                std::swap(_mode, copy._mode);
+            }
+            return *this;
+        }
+        ~AccessHold()
+        {
+            assert( std::this_thread::get_id() == _tid );
+            _word->release(_mode);
+        }
+
+        MODE mode() const { return _mode; }
+        std::thread::id tid() const { return _tid; }
+
+    private:
+        AccessWord* _word;
+        MODE _mode;
+        std::thread::id _tid;
+};
+
+} // sa
+
+#endif // ACCESS_WORD_H
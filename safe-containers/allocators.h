@@ -0,0 +1,233 @@
+#ifndef ALLOCATORS_H
+#define ALLOCATORS_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace sa
+{
+
+// Allocators for SafeArray's element storage.  All of them hand out memory
+// that starts on a cache line and is a whole number of lines long, so
+// element data never shares a line with anything else on the heap.
+
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+namespace detail
+{
+    inline std::size_t round_up(std::size_t n, std::size_t multiple)
+    {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+
+    inline void* map_anonymous(std::size_t bytes)
+    {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        return p;
+    }
+}
+
+template <typename T, std::size_t Align=CACHE_LINE_SIZE>
+class CacheAlignedAllocator
+{
+    static_assert(Align >= alignof(T) && (Align & (Align - 1)) == 0,
+            "Alignment must be a power of two no smaller than alignof(T)");
+
+    public:
+        typedef T value_type;
+        template <typename U>
+        struct rebind { typedef CacheAlignedAllocator<U, Align> other; };
+
+        CacheAlignedAllocator() = default;
+        template <typename U>
+        CacheAlignedAllocator(const CacheAlignedAllocator<U, Align>&) {}
+
+        T* allocate(std::size_t n)
+        {
+            return static_cast<T*>( ::operator new(
+                        detail::round_up(n*sizeof(T), Align),
+                        std::align_val_t{Align}) );
+        }
+        void deallocate(T* p, std::size_t)
+        {
+            ::operator delete(p, std::align_val_t{Align});
+        }
+
+        template <typename U>
+        bool operator==(const CacheAlignedAllocator<U, Align>&) const
+        { return true; }
+        template <typename U>
+        bool operator!=(const CacheAlignedAllocator<U, Align>&) const
+        { return false; }
+};
+
+// Anonymous mappings aligned to, and padded out to, 2MB huge pages, with
+// MADV_HUGEPAGE so transparent huge pages back them even when THP is in
+// 'madvise' mode.  One TLB entry then covers 512 times as much of the array.
+// If the kernel has THP disabled this quietly degrades to 4K pages.
+template <typename T>
+class HugePageAllocator
+{
+    public:
+        static constexpr std::size_t HUGE_PAGE_SIZE = 2u << 20;
+
+        typedef T value_type;
+        template <typename U>
+        struct rebind { typedef HugePageAllocator<U> other; };
+
+        HugePageAllocator() = default;
+        template <typename U>
+        HugePageAllocator(const HugePageAllocator<U>&) {}
+
+        T* allocate(std::size_t n)
+        {
+            const std::size_t bytes = _bytes(n);
+            // Over-map by one huge page and trim, since mmap only promises
+            // 4K alignment.
+            char* raw = static_cast<char*>(
+                    detail::map_anonymous(bytes + HUGE_PAGE_SIZE) );
+            char* p = reinterpret_cast<char*>( detail::round_up(
+                        reinterpret_cast<std::uintptr_t>(raw),
+                        HUGE_PAGE_SIZE) );
+            if (p != raw)
+                munmap(raw, p - raw);
+            munmap(p + bytes, (raw + bytes + HUGE_PAGE_SIZE) - (p + bytes));
+            madvise(p, bytes, MADV_HUGEPAGE);
+            return reinterpret_cast<T*>(p);
+        }
+        void deallocate(T* p, std::size_t n)
+        {
+            munmap(p, _bytes(n));
+        }
+
+        template <typename U>
+        bool operator==(const HugePageAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const HugePageAllocator<U>&) const { return false; }
+
+    private:
+        static std::size_t _bytes(std::size_t n)
+        {
+            return detail::round_up(std::max<std::size_t>(n*sizeof(T), 1),
+                    HUGE_PAGE_SIZE);
+        }
+};
+
+// NUMA placement for anonymous mappings, using mbind(2) directly so there is
+// no libnuma dependency.
+//     FIRST_TOUCH  leave placement to the kernel's default policy: each page
+//                  lands on the node of the thread that first writes it.
+//                  Pair this with a parallel constructor so each worker
+//                  touches the chunk it will use.
+//     BIND         all pages on the nodes in 'nodes'.
+//     INTERLEAVE   pages round-robin across every node in 'nodes'.
+// Node ids must be in [0, 1024), and BIND and INTERLEAVE need at least one;
+// the constructor throws std::invalid_argument otherwise.
+template <typename T>
+class NumaAllocator
+{
+    public:
+        enum class POLICY
+        {
+            FIRST_TOUCH,
+            BIND,
+            INTERLEAVE
+        };
+
+        typedef T value_type;
+        template <typename U>
+        struct rebind { typedef NumaAllocator<U> other; };
+
+        NumaAllocator(POLICY policy=POLICY::FIRST_TOUCH,
+                std::vector<int> nodes={0})
+            : _policy{policy},
+            _nodes{std::move(nodes)}
+        {
+            if (_policy != POLICY::FIRST_TOUCH && _nodes.empty())
+                throw std::invalid_argument("NumaAllocator: no nodes");
+            for (int node : _nodes)
+                if (node < 0 || node >= MAX_NODES)
+                    throw std::invalid_argument("NumaAllocator: node "
+                            + std::to_string(node) + " out of range");
+        }
+        template <typename U>
+        NumaAllocator(const NumaAllocator<U>& rhs)
+            : _policy{ static_cast<POLICY>(rhs.policy()) },
+            _nodes{rhs.nodes()}
+        {}
+
+        POLICY policy() const { return _policy; }
+        const std::vector<int>& nodes() const { return _nodes; }
+
+        T* allocate(std::size_t n)
+        {
+            const std::size_t bytes = _bytes(n);
+            void* p = detail::map_anonymous(bytes);
+            if (_policy != POLICY::FIRST_TOUCH)
+            {
+                unsigned long mask[MAX_NODES / (8*sizeof(unsigned long))] = {};
+                for (int node : _nodes)
+                    mask[node / (8*sizeof(unsigned long))]
+                        |= 1ul << (node % (8*sizeof(unsigned long)));
+                const int mode = (_policy == POLICY::BIND) ? MPOL_BIND
+                    : MPOL_INTERLEAVE;
+                // The kernel reads maxnode - 1 bits of the mask.
+                if (syscall(SYS_mbind, p, bytes, mode, mask, MAX_NODES + 1, 0)
+                        != 0)
+                {
+                    const int err = errno;
+                    munmap(p, bytes);
+                    throw std::system_error(err, std::system_category(),
+                            "mbind");
+                }
+            }
+            return static_cast<T*>(p);
+        }
+        void deallocate(T* p, std::size_t n)
+        {
+            munmap(p, _bytes(n));
+        }
+
+        template <typename U>
+        bool operator==(const NumaAllocator<U>& rhs) const
+        {
+            return static_cast<int>(_policy) == static_cast<int>(rhs.policy())
+                && _nodes == rhs.nodes();
+        }
+        template <typename U>
+        bool operator!=(const NumaAllocator<U>& rhs) const
+        { return !(*this == rhs); }
+
+    private:
+        // From <linux/mempolicy.h>
+        static constexpr int MPOL_BIND = 2;
+        static constexpr int MPOL_INTERLEAVE = 3;
+        static constexpr int MAX_NODES = 1024;
+
+        static std::size_t _bytes(std::size_t n)
+        {
+            return detail::round_up(std::max<std::size_t>(n*sizeof(T), 1),
+                    sysconf(_SC_PAGESIZE));
+        }
+
+        POLICY _policy;
+        std::vector<int> _nodes;
+};
+
+} // sa
+
+#endif // ALLOCATORS_H
@@ -0,0 +1,94 @@
+#ifndef BULK_COPY_H
+#define BULK_COPY_H
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+namespace sa
+{
+
+// Element types that bulk operations (SafeArray::fill(), assign(),
+// copy_to(), copy_from(), swap_contents()) move as raw bytes, with memcpy
+// and memset, rather than one element at a time.
+template <typename T>
+concept byte_copyable = std::is_trivially_copyable_v<T>;
+
+namespace detail
+{
+    // Iterators to storage that bulk operations can memcpy T's to.
+    template <typename It, typename T>
+    concept contiguous_storage_of = std::contiguous_iterator<It>
+        && std::same_as<std::iter_value_t<It>, T>;
+
+    // Copies at least this big bypass the cache: what is written won't
+    // be read back soon, and a copy this size would otherwise evict
+    // everything else on its way through.
+    constexpr std::size_t STREAM_THRESHOLD = 8 << 20;
+
+    // memcpy with non-temporal stores, where the target has them.  dst
+    // and src must not overlap.
+    inline void stream_copy(void* dst, const void* src, std::size_t bytes)
+    {
+#ifdef __SSE2__
+        char* d = static_cast<char*>(dst);
+        const char* s = static_cast<const char*>(src);
+        // Streaming stores need a 16-byte aligned destination.
+        const std::size_t head = std::min<std::size_t>(bytes,
+                -(std::uintptr_t)d % 16);
+        std::memcpy(d, s, head);
+        d += head;
+        s += head;
+        bytes -= head;
+        for ( ; bytes>=64; d+=64, s+=64, bytes-=64)
+        {
+            const __m128i* from = reinterpret_cast<const __m128i*>(s);
+            __m128i* to = reinterpret_cast<__m128i*>(d);
+            const __m128i a = _mm_loadu_si128(from);
+            const __m128i b = _mm_loadu_si128(from + 1);
+            const __m128i c = _mm_loadu_si128(from + 2);
+            const __m128i e = _mm_loadu_si128(from + 3);
+            _mm_stream_si128(to, a);
+            _mm_stream_si128(to + 1, b);
+            _mm_stream_si128(to + 2, c);
+            _mm_stream_si128(to + 3, e);
+        }
+        // Streaming stores are weakly ordered; make them visible before
+        // the session that covers them ends.
+        _mm_sfence();
+        std::memcpy(d, s, bytes);
+#else
+        std::memcpy(dst, src, bytes);
+#endif
+    }
+
+    // How bulk operations copy bytes.  glibc's memcpy already switches to
+    // non-temporal stores past a threshold it sizes from the cache, and
+    // does them better (several pages at a time) than stream_copy, so
+    // there we leave it to memcpy.
+    inline void bulk_copy(void* dst, const void* src, std::size_t bytes)
+    {
+        if (bytes == 0)     // src may be null
+            return;
+#ifndef __GLIBC__
+        if (bytes >= STREAM_THRESHOLD)
+        {
+            stream_copy(dst, src, bytes);
+            return;
+        }
+#endif
+        std::memcpy(dst, src, bytes);
+    }
+}
+
+} // sa
+
+#endif // BULK_COPY_H
@@ -0,0 +1,121 @@
+#ifndef COLUMN_SPAN_H
+#define COLUMN_SPAN_H
+
+#include <cassert>
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+#include "access_word.h"
+
+namespace sa
+{
+
+// A span over one guarded array -- a SafeColumns column, or one of a
+// SafeGroup's arrays -- that holds a read or write session on it for as long
+// as it (or any copy of it) is alive.  A column's span takes a hold of its
+// own; a SafeGroup's spans share their session's, so handing out every array
+// of a group costs no further acquisitions.  It is not a std::span, and its
+// iterators are random access rather than contiguous, so it doesn't convert
+// to one either: the elements can't slip out of the session through a
+// std::span parameter, a subspan() or a data() pointer.  unsafe_span() is
+// the one way out, for callers that keep this object alive while they use
+// the elements.
+template <typename T>
+class ColumnSpan
+{
+    public:
+        typedef T element_type;
+        typedef std::remove_cv_t<T> value_type;
+        typedef std::size_t size_type;
+        typedef T& reference;
+        typedef T* pointer;
+
+        class Iterator
+        {
+            public:
+                typedef Iterator self_type;
+                typedef std::remove_cv_t<T> value_type;
+                typedef T& reference;
+                typedef T* pointer;
+                typedef std::random_access_iterator_tag iterator_category;
+                typedef std::ptrdiff_t difference_type;
+
+                Iterator() : _ptr{nullptr} {}
+                explicit Iterator(T* ptr) : _ptr{ptr} {}
+
+                reference operator*() const { return *_ptr; }
+                pointer operator->() const { return _ptr; }
+                reference operator[](difference_type n) const
+                { return _ptr[n]; }
+
+                self_type& operator++() { ++_ptr; return *this; }
+                self_type operator++(int) { return self_type{_ptr++}; }
+                self_type& operator--() { --_ptr; return *this; }
+                self_type operator--(int) { return self_type{_ptr--}; }
+                self_type& operator+=(difference_type n)
+                { _ptr += n; return *this; }
+                self_type& operator-=(difference_type n)
+                { _ptr -= n; return *this; }
+                self_type operator+(difference_type n) const
+                { return self_type{_ptr + n}; }
+                friend self_type operator+(difference_type n,
+                        const self_type& it)
+                { return it + n; }
+                self_type operator-(difference_type n) const
+                { return self_type{_ptr - n}; }
+                difference_type operator-(const self_type& rhs) const
+                { return _ptr - rhs._ptr; }
+
+                bool operator==(const self_type& rhs) const
+                { return _ptr == rhs._ptr; }
+                auto operator<=>(const self_type& rhs) const
+                { return _ptr <=> rhs._ptr; }
+
+            private:
+                T* _ptr;
+        };
+        typedef Iterator iterator;
+
+        ColumnSpan(T* data, std::size_t size, AccessWord& access_word,
+                AccessHold::MODE mode)
+            : _span(data, size),
+            _hold{std::in_place, access_word, mode}
+        {}
+        // Shares 'session', which stays held until its last sharer is gone.
+        ColumnSpan(T* data, std::size_t size,
+                std::shared_ptr<const AccessHold> session)
+            : _span(data, size),
+            _session{std::move(session)}
+        {}
+
+        std::size_t size() const { return _span.size(); }
+        bool empty() const { return _span.empty(); }
+        T& operator[](std::size_t index) const
+        {
+            assert(index < _span.size());
+            return _span[index];
+        }
+        Iterator begin() const { return Iterator{_span.data()}; }
+        Iterator end() const
+        { return Iterator{_span.data() + _span.size()}; }
+
+        // Unguarded: valid only while this ColumnSpan is alive.
+        std::span<T> unsafe_span() const { return _span; }
+
+        AccessHold::MODE mode() const
+        { return _hold ? _hold->mode() : _session->mode(); }
+
+    private:
+        std::span<T> _span;
+        std::optional<AccessHold> _hold;
+        std::shared_ptr<const AccessHold> _session;
+};
+
+} // sa
+
+#endif // COLUMN_SPAN_H
@@ -0,0 +1,223 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <thread>
+
+namespace sa
+{
+
+// Epoch-based memory reclamation for the lock-free containers.
+//
+// A thread pins the current epoch (with a Guard) for as long as it may hold
+// raw pointers into a shared structure.  Unlinked objects are retire()d
+// rather than deleted; an object retired in epoch e is only freed once the
+// global epoch has reached e+2, by which time every thread that could have
+// seen it has unpinned.  The epoch only advances when every pinned thread
+// has caught up with it, so a long-lived Guard delays reclamation (but never
+// correctness).
+//
+// There is one process-wide domain; like Log it is created on first use and
+// never destroyed, so retired objects may safely outlive their container.
+class EpochDomain
+{
+    public:
+        typedef void (*Deleter)(void*);
+
+        // RAII pin.  Copying a Guard pins again (it is cheap: a nested pin
+        // is a thread-local increment), but a Guard must be released on the
+        // thread that created it.
+        class Guard
+        {
+            public:
+                Guard(EpochDomain& domain)
+                    : _domain{&domain},
+                    _tid{ std::this_thread::get_id() }
+                {
+                    _domain->_enter();
+                }
+                Guard(const Guard& rhs)
+                    : _domain{rhs._domain},
+                    _tid{ std::this_thread::get_id() }
+                {
+                    _domain->_enter();
+                }
+                Guard& operator=(const Guard&) = delete;
+                ~Guard()
+                {
+                    assert( std::this_thread::get_id() == _tid );
+                    _domain->_exit();
+                }
+
+            private:
+                EpochDomain* _domain;
+                std::thread::id _tid;
+        };
+
+        static EpochDomain& instance()
+        {
+            static EpochDomain* domain = new EpochDomain();
+            return *domain;
+        }
+
+        Guard pin() { return Guard{*this}; }
+
+        template <typename T>
+        void retire(T* ptr)
+        {
+            retire(ptr, [](void* p){ delete static_cast<T*>(p); });
+        }
+        void retire(void* ptr, Deleter deleter)
+        {
+            Record& record = _record();
+            record.limbo.push_back(
+                    Retired{_global.load(std::memory_order_acquire),
+                    ptr, deleter} );
+            if ((int)record.limbo.size() >= RETIRE_THRESHOLD)
+                _collect(record);
+        }
+
+        // Try to advance the epoch and free whatever this thread has
+        // retired that is now unreachable.
+        void collect() { _collect(_record()); }
+
+        // Wait for a grace period, then free everything this thread has
+        // retired: on return, nothing it retired is still allocated.  Spins
+        // for as long as another thread stays pinned; the calling thread
+        // must not be pinned itself, or it would wait on its own pin.
+        void synchronize()
+        {
+            Record& record = _record();
+            assert( record.depth == 0 );
+            // Everything in limbo was retired at or before this epoch.
+            const std::uint64_t target = _global.load() + 2;
+            while (_global.load() < target)
+                if (!_try_advance())
+                    std::this_thread::yield();
+            _collect(record);
+        }
+
+        std::uint64_t epoch() const
+        {
+            return _global.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr int RETIRE_THRESHOLD = 128;
+        // Record state: (epoch << 1) | 1 while pinned, 0 while quiescent.
+        static constexpr std::uint64_t QUIESCENT = 0;
+
+        struct Retired
+        {
+            std::uint64_t epoch;
+            void* ptr;
+            Deleter deleter;
+        };
+
+        // One per thread, reused after the thread exits.  Only the owning
+        // thread touches depth and limbo.
+        struct Record
+        {
+            std::atomic<std::uint64_t> state{QUIESCENT};
+            std::atomic<bool> in_use{true};
+            int depth{0};
+            std::deque<Retired> limbo;
+            Record* next{nullptr};
+        };
+
+        // Gives the thread's Record back when the thread exits.  The domain
+        // is never destroyed, so the pointer is always still valid.
+        struct RecordHolder
+        {
+            Record* record{nullptr};
+            ~RecordHolder()
+            {
+                if (record)
+                    record->in_use.store(false, std::memory_order_release);
+            }
+        };
+
+        EpochDomain() : _global{1}, _records{nullptr} {}
+        EpochDomain(const EpochDomain&) = delete;
+        EpochDomain& operator=(const EpochDomain&) = delete;
+
+        Record& _record()
+        {
+            static thread_local RecordHolder holder;
+            if (!holder.record)
+                holder.record = _acquire_record();
+            return *holder.record;
+        }
+
+        Record* _acquire_record()
+        {
+            for (Record* r = _records.load(std::memory_order_acquire); r;
+                    r = r->next)
+            {
+                bool in_use = false;
+                if ( !r->in_use.load(std::memory_order_relaxed)
+                        && r->in_use.compare_exchange_strong(in_use, true) )
+                    return r;
+            }
+            Record* record = new Record();
+            record->next = _records.load(std::memory_order_relaxed);
+            while ( !_records.compare_exchange_weak(record->next, record) )
+                ;
+            return record;
+        }
+
+        void _enter()
+        {
+            Record& record = _record();
+            if (record.depth++ > 0)
+                return;
+            const std::uint64_t epoch = _global.load();
+            record.state.store( (epoch << 1) | 1 );
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        void _exit()
+        {
+            Record& record = _record();
+            assert( record.depth > 0 );
+            if (--record.depth == 0)
+                record.state.store(QUIESCENT, std::memory_order_release);
+        }
+
+        // The epoch moves from e to e+1 only once every pinned thread has
+        // observed e.
+        bool _try_advance()
+        {
+            std::uint64_t epoch = _global.load();
+            for (Record* r = _records.load(std::memory_order_acquire); r;
+                    r = r->next)
+            {
+                const std::uint64_t state = r->state.load();
+                if ((state & 1) && (state >> 1) != epoch)
+                    return false;
+            }
+            return _global.compare_exchange_strong(epoch, epoch + 1);
+        }
+
+        void _collect(Record& record)
+        {
+            _try_advance();
+            const std::uint64_t epoch = _global.load();
+            while ( !record.limbo.empty()
+                    && record.limbo.front().epoch + 2 <= epoch )
+            {
+                const Retired retired = record.limbo.front();
+                record.limbo.pop_front();
+                retired.deleter(retired.ptr);
+            }
+        }
+
+        std::atomic<std::uint64_t> _global;
+        std::atomic<Record*> _records;
+};
+
+} // sa
+
+#endif // EPOCH_H
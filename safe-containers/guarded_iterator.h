@@ -0,0 +1,96 @@
+#ifndef GUARDED_ITERATOR_H
+#define GUARDED_ITERATOR_H
+
+#include <cassert>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+
+#include "access_word.h"
+
+namespace sa
+{
+
+// The AccessWord counterpart of SafeArray::SafeIterator: a pointer into
+// contiguous storage plus an AccessHold, so the container stays read- or
+// write-locked for as long as any iterator into it is alive.  Use
+// GuardedIterator<const T> for read iterators.
+//
+// Containers with their own synchronization can supply another Hold type.
+// It must take a new hold when copied, release it when destroyed, and
+// provide mode() and tid().
+template <typename T, typename Hold=AccessHold>
+class GuardedIterator
+{
+    public:
+        typedef typename Hold::MODE ITER_MODE;
+
+        typedef GuardedIterator self_type;
+        typedef std::remove_const_t<T> value_type;
+        typedef T& reference;
+        typedef T* pointer;
+        typedef std::forward_iterator_tag iterator_category;
+        typedef int difference_type;
+
+        GuardedIterator(pointer ptr, AccessWord& access_word,
+                ITER_MODE iter_mode=ITER_MODE::READ)
+            : _ptr{ptr},
+            _hold{access_word, iter_mode}
+        {}
+        // As above, for a Hold built from something else, so the hold is
+        // taken once rather than taken and then copied.
+        template <typename Source>
+            requires (!std::is_same_v<Hold, AccessHold>)
+                && std::is_constructible_v<Hold, Source&, ITER_MODE>
+        GuardedIterator(pointer ptr, Source& source,
+                ITER_MODE iter_mode=ITER_MODE::READ)
+            : _ptr{ptr},
+            _hold{source, iter_mode}
+        {}
+        GuardedIterator(pointer ptr, const Hold& hold)
+            : _ptr{ptr},
+            _hold{hold}
+        {}
+
+        self_type operator++(int)
+        {
+            assert( std::this_thread::get_id() == _hold.tid() );
+            self_type iter = *this;
+            _ptr++;
+            return iter;
+        }
+        self_type& operator++()
+        {
+            assert( std::this_thread::get_id() == _hold.tid() );
+            _ptr++;
+            return *this;
+        }
+        reference operator*() const
+        {
+            assert( std::this_thread::get_id() == _hold.tid() );
+            return *_ptr;
+        }
+        pointer operator->() const
+        {
+            assert( std::this_thread::get_id() == _hold.tid() );
+            return _ptr;
+        }
+        difference_type operator-(const self_type& rhs) const
+        { return _ptr - rhs._ptr; }
+        bool operator<(const self_type& rhs) const
+        { return _ptr < rhs._ptr; }
+        bool operator==(const self_type& rhs) const
+        { return _ptr == rhs._ptr; }
+        bool operator!=(const self_type& rhs) const
+        { return !(*this == rhs); }
+
+        ITER_MODE mode() const { return _hold.mode(); }
+
+    private:
+        pointer _ptr;
+        Hold _hold;
+};
+
+} // sa
+
+#endif // GUARDED_ITERATOR_H
@@ -0,0 +1,258 @@
+#ifndef MAPPED_SAFE_ARRAY_H
+#define MAPPED_SAFE_ARRAY_H
+
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access_ctr.h"
+#include "safe_array.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// A SafeArray whose storage is a memory-mapped file.  Opening one costs a
+// single mmap; pages are faulted in as they are touched and are shared, via
+// the page cache, with every other process mapping the same file.  The
+// iterators are SafeArray's own, with the same guarantee: one thread with
+// read/write iterators, or any number with read iterators.  (The guarantee
+// is per MappedSafeArray object; it does not extend across processes.)
+//
+// T must be trivially copyable, since the file holds raw element bytes.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class MappedSafeArray
+{
+    public:
+        typedef typename SafeArray<T>::SafeIterator SafeIterator;
+        typedef typename SafeArray<T>::size_type size_type;
+        typedef T value_type;
+        typedef std::shared_ptr<AccessCtr> AccessCtrPtr;
+        typedef std::shared_ptr<std::condition_variable> CondVarPtr;
+        typedef SafeIterator iterator;
+
+        enum class MODE
+        {
+            READ_ONLY,
+            READ_WRITE
+        };
+
+        // Mapped straight onto madvise(2).
+        enum class ADVICE
+        {
+            NORMAL = MADV_NORMAL,
+            SEQUENTIAL = MADV_SEQUENTIAL,
+            RANDOM = MADV_RANDOM,
+            WILLNEED = MADV_WILLNEED,
+            DONTNEED = MADV_DONTNEED
+        };
+
+        // Map an existing file, whose length must be a multiple of sizeof(T).
+        MappedSafeArray(const std::string& path, MODE mode=MODE::READ_ONLY)
+            : MappedSafeArray(path, mode, -1)
+        {}
+
+        // Create the file if need be and size it to 'size' elements (new
+        // bytes read as zero), then map it read/write.  Throws
+        // std::invalid_argument if size is negative.
+        MappedSafeArray(const std::string& path, size_type size)
+            : MappedSafeArray(path, MODE::READ_WRITE, _checked_size(size))
+        {}
+
+        MappedSafeArray(const MappedSafeArray&) = delete;
+        MappedSafeArray& operator=(const MappedSafeArray&) = delete;
+
+        ~MappedSafeArray()
+        {
+            FUNC_LOGGING();
+            if (_data)
+                munmap(_data, _size*sizeof(T));
+            close(_fd);
+        }
+
+        size_type size() const { return _size; }
+        MODE mode() const { return _mode; }
+
+        const T& operator[](size_type index) const
+        {
+            assert(index < _size);
+            return _data[index];
+        }
+
+        SafeIterator cbegin() const
+        {
+            FUNC_LOGGING();
+            return safe_read_iterator(0);
+        }
+        SafeIterator cend() const
+        {
+            FUNC_LOGGING();
+            return safe_read_iterator(_size);
+        }
+        // Throws std::logic_error on a READ_ONLY mapping, whose pages would
+        // fault on the first write.
+        SafeIterator begin()
+        {
+            FUNC_LOGGING();
+            return safe_rw_iterator(0);
+        }
+        SafeIterator end()
+        {
+            FUNC_LOGGING();
+            return safe_rw_iterator(_size);
+        }
+
+        int get_writer_ct() const { return _access_ctr->get_writer_ct(); }
+        int get_reader_ct() const { return _access_ctr->get_reader_ct(); }
+
+        // Contention statistics, as for SafeArray.
+        void set_stats_enabled(bool enabled)
+        {
+            _access_ctr->set_stats_enabled(enabled);
+        }
+        AccessStats get_stats() const { return _access_ctr->get_stats(); }
+        void set_watchdog(Watchdog* watchdog, const char* name="")
+        {
+            _access_ctr->set_watchdog(watchdog, name);
+        }
+
+        // Write dirty pages back to the file and wait for the I/O.  Takes a
+        // write session, so the file sees a state no writer was midway
+        // through.  Like begin(), throws on a READ_ONLY mapping.
+        void flush()
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_rw_iterator(0);
+            if (_data && msync(_data, _size*sizeof(T), MS_SYNC) != 0)
+                throw std::system_error(errno, std::system_category(),
+                        "msync " + _path);
+        }
+
+        // Tell the kernel how the mapping is about to be used.
+        void advise(ADVICE advice) const
+        {
+            if (_data && madvise(_data, _size*sizeof(T), (int)advice) != 0)
+                throw std::system_error(errno, std::system_category(),
+                        "madvise " + _path);
+        }
+
+    private:
+        static size_type _checked_size(size_type size)
+        {
+            if (size < 0)
+                throw std::invalid_argument("MappedSafeArray: negative size");
+            return size;
+        }
+
+        // A negative size maps the file as it is, without creating it.
+        MappedSafeArray(const std::string& path, MODE mode, long size)
+            : _path{path},
+            _mode{mode},
+            _fd{-1},
+            _data{nullptr},
+            _size{0},
+            _access_ctr{ new AccessCtr() },
+            _cond_var{ new std::condition_variable() }
+        {
+            FUNC_LOGGING();
+            const bool writable = (_mode == MODE::READ_WRITE);
+            const int flags = writable ? (O_RDWR | (size >= 0 ? O_CREAT : 0))
+                : O_RDONLY;
+            _fd = open(_path.c_str(), flags | O_CLOEXEC, 0644);
+            if (_fd < 0)
+                throw std::system_error(errno, std::system_category(),
+                        "open " + _path);
+            try
+            {
+                if (size >= 0 && ftruncate(_fd, size*sizeof(T)) != 0)
+                    throw std::system_error(errno, std::system_category(),
+                            "ftruncate " + _path);
+                struct stat st;
+                if (fstat(_fd, &st) != 0)
+                    throw std::system_error(errno, std::system_category(),
+                            "fstat " + _path);
+                if (st.st_size % sizeof(T) != 0)
+                    throw std::runtime_error(_path
+                            + ": size is not a multiple of the element size");
+                const auto count = (std::uint64_t)st.st_size / sizeof(T);
+                if (count
+                        > (std::uint64_t)std::numeric_limits<size_type>::max())
+                    throw std::runtime_error(_path
+                            + ": too large for MappedSafeArray");
+                _size = (size_type)count;
+                if (_size == 0)
+                    return;
+                void* p = mmap(nullptr, st.st_size,
+                        writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                        MAP_SHARED, _fd, 0);
+                if (p == MAP_FAILED)
+                    throw std::system_error(errno, std::system_category(),
+                            "mmap " + _path);
+                _data = static_cast<T*>(p);
+            }
+            catch (...)
+            {
+                close(_fd);
+                throw;
+            }
+        }
+
+        SafeIterator safe_rw_iterator(size_type offset)
+        {
+            if (_mode == MODE::READ_ONLY)
+                throw std::logic_error(_path + " is mapped read-only");
+            std::unique_lock<std::mutex> lock{_mutex};
+            _access_ctr->wait(*_cond_var, lock, AccessCtr::MODE::READ_WRITE,
+                    [this]{
+                        return !_access_ctr->get_has_other_accessors();
+                    });
+            return SafeIterator{_data+offset, _cond_var,
+                _access_ctr, _mutex, SafeIterator::ITER_MODE::READ_WRITE};
+        }
+        SafeIterator safe_read_iterator(size_type offset) const
+        {
+            std::unique_lock<std::mutex> lock{_mutex};
+            _access_ctr->wait(*_cond_var, lock, AccessCtr::MODE::READ,
+                    [this]{
+                        return !_access_ctr->get_has_other_writers();
+                    });
+            return SafeIterator{_data+offset, _cond_var, _access_ctr, _mutex};
+        }
+
+        const std::string _path;
+        const MODE _mode;
+        int _fd;
+        T* _data;
+        size_type _size;
+
+        AccessCtrPtr _access_ctr;
+
+        mutable CondVarPtr _cond_var;
+        mutable std::mutex _mutex;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // MAPPED_SAFE_ARRAY_H
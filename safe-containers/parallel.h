@@ -0,0 +1,104 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace sa
+{
+
+// Requests that a container be built by several threads at once, each
+// constructing (and so first-touching) one contiguous chunk.  Chunk i always
+// goes to the i-th thread, with the calling thread taking chunk 0, so with
+// NumaAllocator's FIRST_TOUCH policy chunk i lands on the node thread i ran
+// on.  on_thread_start, if set, runs first for each chunk on the thread that
+// will build it (the caller included), e.g. to pin that thread.
+struct ParallelInit
+{
+    int num_threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    void (*on_thread_start)(int chunk) = nullptr;
+};
+
+// Split [0, n) into num_threads contiguous chunks and call f(first, last,
+// chunk) for each, concurrently.  Returns once every chunk is done.  If any
+// chunk throws, the first exception (by chunk index) is rethrown after all
+// threads have joined, and on_error(first, last) is called on each chunk that
+// did succeed so the caller can undo its work.  A chunk whose thread could not
+// be started counts as failed; on_unstarted(chunk) is called for it on the
+// calling thread straight away, before anything is joined, so chunks that
+// wait on each other can be told not to wait for it.
+template <typename Func, typename OnError, typename OnUnstarted>
+void parallel_chunks(long n, const ParallelInit& init, Func f,
+        OnError on_error, OnUnstarted on_unstarted)
+{
+    const int num_chunks
+        = (int)std::max(1L, std::min<long>(init.num_threads, n));
+    auto chunk_first = [n, num_chunks](int chunk)
+    {
+        return n * chunk / num_chunks;
+    };
+
+    std::vector<std::exception_ptr> errors(num_chunks);
+    auto run = [&](int chunk)
+    {
+        try
+        {
+            if (init.on_thread_start)
+                init.on_thread_start(chunk);
+            f(chunk_first(chunk), chunk_first(chunk+1), chunk);
+        }
+        catch (...)
+        {
+            errors[chunk] = std::current_exception();
+        }
+    };
+    {
+        // If a thread can't be started, its chunk and those after it fail
+        // with that error; the threads already running are still joined.
+        std::vector<std::jthread> threads;
+        int chunk = 1;
+        try
+        {
+            threads.reserve(num_chunks - 1);
+            for ( ; chunk<num_chunks; ++chunk)
+                threads.emplace_back(run, chunk);
+        }
+        catch (...)
+        {
+            for ( ; chunk<num_chunks; ++chunk)
+            {
+                errors[chunk] = std::current_exception();
+                on_unstarted(chunk);
+            }
+        }
+        run(0);
+    }
+
+    const auto failed = std::find_if(errors.begin(), errors.end(),
+            [](const std::exception_ptr& e){ return (bool)e; });
+    if (failed == errors.end())
+        return;
+    for (int chunk=0; chunk<num_chunks; ++chunk)
+        if (!errors[chunk])
+            on_error(chunk_first(chunk), chunk_first(chunk+1));
+    std::rethrow_exception(*failed);
+}
+
+template <typename Func, typename OnError>
+void parallel_chunks(long n, const ParallelInit& init, Func f,
+        OnError on_error)
+{
+    parallel_chunks(n, init, f, on_error, [](int){});
+}
+
+template <typename Func>
+void parallel_chunks(long n, const ParallelInit& init, Func f)
+{
+    parallel_chunks(n, init, f, [](long, long){});
+}
+
+} // sa
+
+#endif // PARALLEL_H
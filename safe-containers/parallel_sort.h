@@ -0,0 +1,337 @@
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.h"
+
+namespace sa
+{
+
+// Sorts [first, last) on up to init.num_threads threads (see parallel.h):
+// each sorts one chunk, then rounds of merges, each merge split between all
+// the threads, combine the chunks.  Arithmetic elements ordered by
+// std::less are instead LSD radix sorted, also in parallel.  Both need a
+// buffer the size of the range.  Small ranges are sorted on the calling
+// thread.
+template <typename T, typename Compare=std::less<>>
+void parallel_sort(T* first, T* last, Compare comp=Compare(),
+        const ParallelInit& init=ParallelInit());
+
+// As above, but equivalent elements keep their order.
+template <typename T, typename Compare=std::less<>>
+void parallel_stable_sort(T* first, T* last, Compare comp=Compare(),
+        const ParallelInit& init=ParallelInit());
+
+namespace detail
+{
+    // Below this many elements a range is sorted on one thread.
+    constexpr long PARALLEL_SORT_MIN = 1 << 15;
+    // ...and radix sorted only from here up.
+    constexpr long RADIX_SORT_MIN = 1 << 12;
+
+    // Up to 8 bytes, for which radix_key has a key type; long double is
+    // merge sorted.
+    template <typename T, typename Compare>
+    concept radix_sortable = (std::integral<T> || std::floating_point<T>)
+        && !std::same_as<T, bool> && sizeof(T) <= 8
+        && (std::same_as<Compare, std::less<>>
+                || std::same_as<Compare, std::less<T>>);
+
+    // For radix_sortable T: an unsigned key that orders as T does.
+    template <typename T>
+    auto radix_key(T value)
+    {
+        using Key = std::conditional_t<sizeof(T) == 1, std::uint8_t,
+              std::conditional_t<sizeof(T) == 2, std::uint16_t,
+              std::conditional_t<sizeof(T) == 4, std::uint32_t,
+              std::uint64_t>>>;
+        static_assert(sizeof(Key) == sizeof(T));
+        constexpr Key SIGN = (Key)1 << (8 * sizeof(Key) - 1);
+        const Key bits = std::bit_cast<Key>(value);
+        if constexpr (std::floating_point<T>)
+            // Negative: reverse them, and put them first.
+            return (Key)((bits & SIGN) ? ~bits : bits | SIGN);
+        else if constexpr (std::is_signed_v<T>)
+            return (Key)(bits ^ SIGN);
+        else
+            return bits;
+    }
+
+    // One pass per byte of the key, least significant first, skipping
+    // bytes that are the same in every element.  Each pass, every thread
+    // counts the digits in its chunk; then, from all the counts, each
+    // thread gets where each of its digits starts in the output, and moves
+    // its chunk there.  Stable.  A chunk that fails to start, or whose
+    // on_thread_start throws, drops out of the barriers before the first
+    // one completes and sets failed, so the others stop there too rather
+    // than wait for it; the error is then rethrown with data unchanged.
+    template <typename T>
+    void radix_sort(T* data, long n, const ParallelInit& init)
+    {
+        constexpr int BUCKETS = 256;
+        constexpr int PASSES = sizeof(T);
+        // parallel_chunks runs this many chunks, all at once.
+        const int num_chunks
+            = (int)std::max(1L, std::min<long>(init.num_threads, n));
+        std::unique_ptr<T[]> buffer{ new T[n] };
+        std::vector<long> counts((std::size_t)num_chunks * BUCKETS);
+        T* from = data;
+        T* to = buffer.get();
+        int pass = 0;
+        bool skip = false;
+
+        // Runs on one thread between the counting and the moving.
+        auto plan = [&]() noexcept
+        {
+            long total = 0;
+            skip = false;
+            for (int b=0; b<BUCKETS; ++b)
+            {
+                long digit_total = 0;
+                for (int c=0; c<num_chunks; ++c)
+                    digit_total += counts[c*BUCKETS + b];
+                if (digit_total == n)
+                    skip = true;
+                for (int c=0; c<num_chunks; ++c)
+                {
+                    const long count = counts[c*BUCKETS + b];
+                    counts[c*BUCKETS + b] = total;
+                    total += count;
+                }
+            }
+        };
+        auto next = [&]() noexcept
+        {
+            if (!skip)
+                std::swap(from, to);
+            ++pass;
+        };
+        std::barrier counted{num_chunks, plan};
+        std::barrier moved{num_chunks, next};
+        std::atomic<bool> failed{false};
+        auto drop_out = [&]() noexcept
+        {
+            failed.store(true, std::memory_order_relaxed);
+            counted.arrive_and_drop();
+            moved.arrive_and_drop();
+        };
+
+        // on_thread_start is run here rather than by parallel_chunks, so a
+        // throw from it still leaves through drop_out.
+        ParallelInit chunk_init = init;
+        chunk_init.on_thread_start = nullptr;
+        parallel_chunks(n, chunk_init, [&](long chunk_first, long chunk_last,
+                    int chunk){
+                if (init.on_thread_start)
+                {
+                    try
+                    {
+                        init.on_thread_start(chunk);
+                    }
+                    catch (...)
+                    {
+                        drop_out();
+                        throw;
+                    }
+                }
+                long* const shared = counts.data() + chunk*BUCKETS;
+                // Local copies: stores to the elements could otherwise
+                // alias any of these, and force them to be reloaded.
+                long offsets[BUCKETS];
+                while (pass < PASSES)
+                {
+                    const int shift = 8 * pass;
+                    const T* const src = from;
+                    T* const dst = to;
+                    std::fill_n(offsets, BUCKETS, 0L);
+                    for (long i=chunk_first; i<chunk_last; ++i)
+                        ++offsets[(radix_key(src[i]) >> shift) & 0xff];
+                    std::copy_n(offsets, BUCKETS, shared);
+                    counted.arrive_and_wait();
+                    if (failed.load(std::memory_order_relaxed))
+                        return;
+                    if (!skip)
+                    {
+                        std::copy_n(shared, BUCKETS, offsets);
+                        for (long i=chunk_first; i<chunk_last; ++i)
+                        {
+                            const T value = src[i];
+                            dst[offsets[(radix_key(value) >> shift) & 0xff]++]
+                                = value;
+                        }
+                    }
+                    moved.arrive_and_wait();
+                }
+            }, [](long, long){}, [&](int){ drop_out(); });
+        if (from != data)
+            std::memcpy((void*)data, from, n * sizeof(T));
+    }
+
+    // How many of the first k elements of the stable merge of a[0, na) and
+    // b[0, nb) come from a.
+    template <typename T, typename Compare>
+    long merge_split(const T* a, long na, const T* b, long nb, long k,
+            Compare& comp)
+    {
+        long lo = std::max(0L, k - nb);
+        long hi = std::min(k, na);
+        while (lo < hi)
+        {
+            const long i = lo + (hi - lo) / 2;
+            const long j = k - i;
+            // a[i] would be out before b[j-1]: take more from a.
+            if (j > 0 && !comp(b[j-1], a[i]))
+                lo = i + 1;
+            else
+                hi = i;
+        }
+        return lo;
+    }
+
+    // Chunk sorts, then merge rounds between data and a buffer.  Each
+    // round pairs up the runs, and splits the whole output evenly between
+    // the threads; a thread's share may cross several merges.  Where each
+    // share starts in the inputs is found before any thread moves an
+    // element, since finding it reads the elements around it.
+    template <typename T, typename Compare, typename SortChunk>
+    void merge_sort(T* data, long n, Compare& comp, const ParallelInit& init,
+            SortChunk sort_chunk)
+    {
+        const int num_chunks
+            = (int)std::max(1L, std::min<long>(init.num_threads, n));
+        auto chunk_first = [n, num_chunks](int chunk)
+        {
+            return n * chunk / num_chunks;
+        };
+        std::vector<long> bounds(num_chunks + 1);
+        for (int c=0; c<=num_chunks; ++c)
+            bounds[c] = chunk_first(c);
+        parallel_chunks(n, init, [&](long first, long last, int){
+                sort_chunk(data + first, data + last);
+            });
+        if (num_chunks == 1)
+            return;
+
+        // The sorted chunks move to the buffer, leaving data to merge into.
+        std::vector<T> buffer(std::make_move_iterator(data),
+                std::make_move_iterator(data + n));
+        T* from = buffer.data();
+        T* to = data;
+        // The pairs are [bounds[p], bounds[p+1]) and [bounds[p+1],
+        // bounds[p+2]) for even p; a trailing run without a partner is just
+        // moved.
+        auto pair_last = [&bounds](std::size_t p)
+        {
+            return p+2 < bounds.size() ? bounds[p+2] : bounds[p+1];
+        };
+        std::vector<long> splits(num_chunks + 1);
+        while (bounds.size() > 2)
+        {
+            // splits[c]: how much of chunk c's output comes from the first
+            // run of the pair it starts in.
+            std::size_t p = 0;
+            for (int c=0; c<num_chunks; ++c)
+            {
+                const long k = chunk_first(c);
+                while (pair_last(p) <= k)
+                    p += 2;
+                splits[c] = merge_split(from + bounds[p],
+                        bounds[p+1] - bounds[p], from + bounds[p+1],
+                        pair_last(p) - bounds[p+1], k - bounds[p], comp);
+            }
+            parallel_chunks(n, init, [&](long out_first, long out_last,
+                        int chunk){
+                    for (std::size_t p=0; p+1<bounds.size(); p+=2)
+                    {
+                        const long first = bounds[p];
+                        const long mid = bounds[p+1];
+                        const long last = pair_last(p);
+                        const long lo = std::max(first, out_first);
+                        const long hi = std::min(last, out_last);
+                        if (lo >= hi)
+                            continue;
+                        const long ia = (lo == first) ? 0 : splits[chunk];
+                        const long ja = (hi == last)
+                            ? mid - first : splits[chunk+1];
+                        const long ib = lo - first - ia;
+                        const long jb = hi - first - ja;
+                        std::merge(std::make_move_iterator(from + first + ia),
+                                std::make_move_iterator(from + first + ja),
+                                std::make_move_iterator(from + mid + ib),
+                                std::make_move_iterator(from + mid + jb),
+                                to + lo, comp);
+                    }
+                });
+            std::vector<long> merged;
+            for (std::size_t p=0; p<bounds.size(); p+=2)
+                merged.push_back(bounds[p]);
+            if (merged.back() != n)
+                merged.push_back(n);
+            bounds.swap(merged);
+            std::swap(from, to);
+        }
+        if (from != data)
+            parallel_chunks(n, init, [&](long first, long last, int){
+                    std::move(from + first, from + last, data + first);
+                });
+    }
+}
+
+template <typename T, typename Compare>
+void parallel_sort(T* first, T* last, Compare comp, const ParallelInit& init)
+{
+    const long n = last - first;
+    if constexpr (detail::radix_sortable<T, Compare>)
+        if (n >= detail::RADIX_SORT_MIN)
+        {
+            detail::radix_sort(first, n, init);
+            return;
+        }
+    if (n < detail::PARALLEL_SORT_MIN || init.num_threads <= 1)
+    {
+        std::sort(first, last, comp);
+        return;
+    }
+    detail::merge_sort(first, n, comp, init, [&comp](T* f, T* l){
+            std::sort(f, l, comp);
+        });
+}
+
+template <typename T, typename Compare>
+void parallel_stable_sort(T* first, T* last, Compare comp,
+        const ParallelInit& init)
+{
+    const long n = last - first;
+    // Radix sorting is stable, but it would tell apart floating-point
+    // values std::less finds equivalent, such as -0.0 and 0.0.
+    if constexpr (detail::radix_sortable<T, Compare> && std::integral<T>)
+        if (n >= detail::RADIX_SORT_MIN)
+        {
+            detail::radix_sort(first, n, init);
+            return;
+        }
+    if (n < detail::PARALLEL_SORT_MIN || init.num_threads <= 1)
+    {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+    detail::merge_sort(first, n, comp, init, [&comp](T* f, T* l){
+            std::stable_sort(f, l, comp);
+        });
+}
+
+} // sa
+
+#endif // PARALLEL_SORT_H
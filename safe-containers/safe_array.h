@@ -1,17 +1,34 @@
 #ifndef SAFE_ARRAY_H
 #define SAFE_ARRAY_H
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <concepts>
 #include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <ranges>
+#include <stdexcept>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "access_ctr.h"
+#include "allocators.h"
+#include "bulk_copy.h"
+#include "parallel.h"
+#include "parallel_sort.h"
+#include "snapshot_io.h"
+#include "update_gate.h"
 
 #ifdef DEBUG_ACCESS
-    #define FUNC_LOGGING() ScopeTracker scope_tracker{__func__}
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
 #else
     #define FUNC_LOGGING() 0
 #endif
@@ -25,7 +42,22 @@ namespace sa
 
 // Starting off modifying https://gist.github.com/jeetsukumaran/307264
 
+// Constructor tags
+struct uninitialized_t { explicit uninitialized_t() = default; };
+inline constexpr uninitialized_t uninitialized{};
+struct from_range_t { explicit from_range_t() = default; };
+inline constexpr from_range_t from_range{};
+
+// Element types for which SafeArray offers per-element atomic updates.
 template <typename T>
+concept lock_free_atomic = std::is_trivially_copyable_v<T>
+    && std::atomic_ref<T>::is_always_lock_free
+    && alignof(T) >= std::atomic_ref<T>::required_alignment;
+
+// Element storage comes from Allocator (see allocators.h for cache-line,
+// huge-page and NUMA-placed variants); the synchronization state is always
+// on its own cache lines.
+template <typename T, typename Allocator=std::allocator<T>>
 class SafeArray
 {
     public:
@@ -35,6 +67,7 @@ class SafeArray
         typedef std::atomic<int> count_type;
         typedef std::atomic<bool> flag_type;
         typedef T value_type;
+        typedef Allocator allocator_type;
         typedef std::shared_ptr<AccessCtr> AccessCtrPtr;
         typedef std::shared_ptr<std::condition_variable> CondVarPtr;
         typedef SafeIterator iterator;
@@ -118,7 +151,8 @@ class SafeArray
                     _pause{50},
                     _iter_mode{iter_mode},
                     _mutex{&mutex},
-                    _tid{ std::this_thread::get_id() }
+                    _tid{ std::this_thread::get_id() },
+                    _hold{ access_ctr->hold_start(_ctr_mode()) }
                 {
                     FUNC_LOGGING();
                     _access_ctr->add_thread();
@@ -129,6 +163,7 @@ class SafeArray
                 {
                     FUNC_LOGGING();
                     _copy_data(rhs);
+                    _hold = _access_ctr->hold_copy(_ctr_mode(), rhs._hold);
                     _access_ctr->add_thread();
                     _update_counters(1);
                 }
@@ -137,14 +172,18 @@ class SafeArray
                 SafeIterator& operator=(const SafeIterator& rhs)
                 {
                     FUNC_LOGGING();
+                    _access_ctr->hold_end(_hold);
                     _copy_data(rhs);
+                    _hold = _access_ctr->hold_copy(_ctr_mode(), rhs._hold);
                     _access_ctr->add_thread();
                     _update_counters(1);
+                    return *this;
                 }
                 SafeIterator& operator=(SafeIterator&&) = delete;
                 ~SafeIterator()
                 {
                     FUNC_LOGGING();
+                    _access_ctr->hold_end(_hold);
                     std::lock_guard<std::mutex> lock{ *_mutex };
                     _update_counters(-1);
                     _cond_var->notify_all();
@@ -197,6 +236,11 @@ class SafeArray
                 { return !(*this == rhs); }
 
             private:
+                AccessCtr::MODE _ctr_mode() const
+                {
+                    return _iter_mode == ITER_MODE::READ_WRITE
+                        ? AccessCtr::MODE::READ_WRITE : AccessCtr::MODE::READ;
+                }
                 void _copy_data(const SafeIterator& other)
                 {
                     FUNC_LOGGING();
@@ -217,7 +261,8 @@ class SafeArray
                             _access_ctr->reader_update(update);
                             break;
                         case ITER_MODE::READ_WRITE:
-                            _access_ctr->reader_update(update);
+                            _access_ctr->reader_update(update,
+                                    AccessCtr::MODE::READ_WRITE);
                             _access_ctr->writer_update(update);
                             break;
                         default:
@@ -239,15 +284,90 @@ class SafeArray
                 ITER_MODE _iter_mode;
                 std::mutex* _mutex;
                 thread_id _tid;
+                AccessCtr::HoldToken _hold;
         };
 
-        SafeArray(size_type size) 
-            : _size(size),
-            _access_ctr{ new AccessCtr() },
-            _cond_var{ new std::condition_variable() },
-            _data{ new T[size] }
+        // Elements are default-initialized, as with new T[size]: class types
+        // are default constructed, trivial ones are left indeterminate.
+        SafeArray(size_type size, const Allocator& allocator=Allocator())
+            : SafeArray(size, allocator, Unconstructed{})
+        {
+            FUNC_LOGGING();
+            _construct([this](size_type first, size_type last){
+                    std::uninitialized_default_construct(_data+first,
+                            _data+last);
+                    });
+        }
+
+        // Storage only.  Nothing is written, so no page is touched until the
+        // array is first written; with NumaAllocator's FIRST_TOUCH policy that
+        // is what decides where each page lives.
+        SafeArray(size_type size, uninitialized_t,
+                const Allocator& allocator=Allocator())
+            requires std::is_trivially_default_constructible_v<T>
+                && std::is_trivially_destructible_v<T>
+            : SafeArray(size, allocator, Unconstructed{})
+        {}
+
+        SafeArray(size_type size, const T& value,
+                const Allocator& allocator=Allocator())
+            : SafeArray(size, allocator, Unconstructed{})
         {
             FUNC_LOGGING();
+            _construct([this, &value](size_type first, size_type last){
+                    std::uninitialized_fill(_data+first, _data+last, value);
+                    });
+        }
+
+        // Element i is constructed from gen(i).
+        template <typename Generator>
+            requires std::invocable<Generator&, size_type>
+                && (!std::convertible_to<Generator, T>)
+        SafeArray(size_type size, Generator gen,
+                const Allocator& allocator=Allocator())
+            : SafeArray(size, allocator, Unconstructed{})
+        {
+            FUNC_LOGGING();
+            _construct([this, &gen](size_type first, size_type last){
+                    _generate(gen, first, last);
+                    });
+        }
+
+        // As above, but chunks of the array are generated concurrently, each
+        // on the thread that ParallelInit assigns it (see parallel.h).  gen
+        // must be safe to call from several threads at once.
+        template <typename Generator>
+            requires std::invocable<Generator&, size_type>
+        SafeArray(size_type size, Generator gen, const ParallelInit& init,
+                const Allocator& allocator=Allocator())
+            : SafeArray(size, allocator, Unconstructed{})
+        {
+            FUNC_LOGGING();
+            _construct([this, &gen, &init](size_type, size_type){
+                    parallel_chunks(_size, init,
+                            [this, &gen](long first, long last, int){
+                                _generate(gen, first, last);
+                            },
+                            [this](long first, long last){
+                                std::destroy(_data+first, _data+last);
+                            });
+                    });
+        }
+
+        // A copy of any sized range, e.g. a std::vector being migrated.
+        // Throws std::length_error if the range is too long for size_type.
+        template <std::ranges::sized_range Range>
+            requires std::constructible_from<T,
+                     std::ranges::range_reference_t<Range>>
+        SafeArray(from_range_t, Range&& range,
+                const Allocator& allocator=Allocator())
+            : SafeArray(_range_size(range), allocator, Unconstructed{})
+        {
+            FUNC_LOGGING();
+            _construct([this, &range](size_type, size_type){
+                    std::uninitialized_copy_n(std::ranges::begin(range),
+                            _size, _data);
+                    });
         }
 
         SafeArray(const SafeArray&) = delete;
@@ -256,10 +376,11 @@ class SafeArray
         ~SafeArray()
         {
             FUNC_LOGGING();
-            delete[] _data;
+            _release();
         }
 
         size_type size() const { return _size; }
+        allocator_type get_allocator() const { return _allocator; }
 
         // Random access without explict construction of an iterator is
         // read-only, sorry
@@ -293,6 +414,312 @@ class SafeArray
             return safe_rw_iterator(_size);
         }
 
+        // Write a snapshot (see snapshot_io.h) to fd at its current offset.
+        // The elements go out with writev() straight from storage under a
+        // read session (SAVE_MODE::DIRECT), or from a private copy taken
+        // under one (SAVE_MODE::SNAPSHOT), so the session lasts only as long
+        // as a memcpy.
+        void save(int fd, SAVE_MODE mode=SAVE_MODE::DIRECT) const
+            requires std::is_trivially_copyable_v<T>
+        {
+            FUNC_LOGGING();
+            const SnapshotHeader header = detail::make_header<T>(_size);
+            const std::size_t bytes = _size * sizeof(T);
+            if (mode == SAVE_MODE::DIRECT)
+            {
+                const SafeIterator hold = safe_read_iterator(0);
+                detail::write_snapshot(fd, header, _data, bytes);
+                return;
+            }
+            // Fault the buffer in first so the session covers only the copy.
+            std::unique_ptr<char[]> copy{ new char[bytes] };
+            std::memset(copy.get(), 0, bytes);
+            {
+                const SafeIterator hold = safe_read_iterator(0);
+                std::memcpy(copy.get(), _data, bytes);
+            }
+            detail::write_snapshot(fd, header, copy.get(), bytes);
+        }
+
+        // Read back a snapshot written by save(), from fd's current offset.
+        // The data is streamed in chunks straight into the new array's
+        // storage, with readahead for the next chunk requested before each
+        // read.  Throws std::runtime_error on a malformed or mismatched
+        // snapshot and std::system_error on I/O errors.
+        static SafeArray load(int fd, const Allocator& allocator=Allocator())
+            requires std::is_trivially_copyable_v<T>
+        {
+            FUNC_LOGGING();
+            const std::uint64_t count = detail::read_header<T>(fd);
+            if (count > (std::uint64_t)std::numeric_limits<size_type>::max())
+                throw std::runtime_error("Snapshot is too large for SafeArray");
+            return SafeArray((size_type)count, allocator, Unconstructed{}, fd);
+        }
+
+        // Per-element atomic updates, for counters and histograms.  When T is
+        // lock-free under std::atomic_ref these act on one element through
+        // std::atomic_ref and take no session, so any number of threads can
+        // update at once.  They pass through an update gate instead, which
+        // snapshot() and reset() close so that they see no update
+        // half-done.
+        //
+        // Ordinary read and write sessions don't exclude atomic updates: an
+        // array updated this way should be read with atomic_load() or
+        // snapshot() and written with atomic_store(), the fetch_* operations
+        // or reset().
+        T atomic_load(size_type index,
+                std::memory_order order=std::memory_order_seq_cst) const
+            requires lock_free_atomic<T>
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate()};
+            return std::atomic_ref<T>(_data[index]).load(order);
+        }
+        void atomic_store(size_type index, T value,
+                std::memory_order order=std::memory_order_seq_cst)
+            requires lock_free_atomic<T>
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate()};
+            std::atomic_ref<T>(_data[index]).store(value, order);
+        }
+        T fetch_add(size_type index, T delta,
+                std::memory_order order=std::memory_order_seq_cst)
+            requires lock_free_atomic<T>
+                && (std::integral<T> || std::floating_point<T>)
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate()};
+            return std::atomic_ref<T>(_data[index]).fetch_add(delta, order);
+        }
+        T fetch_sub(size_type index, T delta,
+                std::memory_order order=std::memory_order_seq_cst)
+            requires lock_free_atomic<T>
+                && (std::integral<T> || std::floating_point<T>)
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate()};
+            return std::atomic_ref<T>(_data[index]).fetch_sub(delta, order);
+        }
+        T fetch_or(size_type index, T bits,
+                std::memory_order order=std::memory_order_seq_cst)
+            requires lock_free_atomic<T> && std::integral<T>
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate()};
+            return std::atomic_ref<T>(_data[index]).fetch_or(bits, order);
+        }
+        T fetch_and(size_type index, T bits,
+                std::memory_order order=std::memory_order_seq_cst)
+            requires lock_free_atomic<T> && std::integral<T>
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate()};
+            return std::atomic_ref<T>(_data[index]).fetch_and(bits, order);
+        }
+        // On failure, expected is updated to the element's current value.
+        bool compare_exchange(size_type index, T& expected, T desired,
+                std::memory_order order=std::memory_order_seq_cst)
+            requires lock_free_atomic<T>
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate()};
+            return std::atomic_ref<T>(_data[index]).compare_exchange_strong(
+                    expected, desired, order);
+        }
+
+        // A consistent copy of every element, and a reset of every element
+        // to 'value'.  Each takes a write session and closes the update gate
+        // for the duration.
+        std::vector<T> snapshot()
+            requires lock_free_atomic<T>
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_rw_iterator(0);
+            const UpdateGate::Closed closed{_gate()};
+            return std::vector<T>(_data, _data + _size);
+        }
+        void reset(const T& value=T())
+            requires lock_free_atomic<T>
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_rw_iterator(0);
+            const UpdateGate::Closed closed{_gate()};
+            std::fill_n(_data, _size, value);
+        }
+
+        // Bulk operations.  Each takes one session for the whole array,
+        // rather than one per element as a loop over an iterator does, and
+        // moves byte_copyable elements (see bulk_copy.h) with memset and
+        // memcpy, so they run at memory bandwidth.  Other element types are
+        // assigned, or moved from ranges passed as rvalues, one at a time.
+
+        void fill(const T& value)
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_rw_iterator(0);
+            if constexpr (byte_copyable<T>)
+            {
+                unsigned char bytes[sizeof(T)];
+                std::memcpy(bytes, &value, sizeof(T));
+                if (std::all_of(bytes, bytes + sizeof(T),
+                            [&bytes](unsigned char b){ return b == bytes[0]; }))
+                {
+                    std::memset((void*)_data, bytes[0], _size * sizeof(T));
+                    return;
+                }
+            }
+            std::fill_n(_data, _size, value);
+        }
+
+        // Replaces every element with those of range, which must be the
+        // same size as the array; throws std::length_error if it isn't.
+        template <std::ranges::sized_range Range>
+            requires std::assignable_from<T&,
+                     std::ranges::range_reference_t<Range>>
+        void assign(Range&& range)
+        {
+            FUNC_LOGGING();
+            if (std::ranges::size(range) != (std::size_t)_size)
+                throw std::length_error("SafeArray::assign(): range is not "
+                        "the size of the array");
+            const SafeIterator hold = safe_rw_iterator(0);
+            _copy_in(std::forward<Range>(range), 0);
+        }
+
+        // Copies every element to out, and returns out past the last.
+        template <typename Out>
+            requires std::output_iterator<Out, const T&>
+        Out copy_to(Out out) const
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_read_iterator(0);
+            if constexpr (byte_copyable<T>
+                    && detail::contiguous_storage_of<Out, T>)
+            {
+                detail::bulk_copy(std::to_address(out), _data,
+                        _size * sizeof(T));
+                return out + _size;
+            }
+            else
+                return std::copy_n(_data, _size, out);
+        }
+
+        // Overwrites the elements from offset on with those of range;
+        // throws std::out_of_range if they don't fit.
+        template <std::ranges::sized_range Range>
+            requires std::assignable_from<T&,
+                     std::ranges::range_reference_t<Range>>
+        void copy_from(Range&& range, size_type offset=0)
+        {
+            FUNC_LOGGING();
+            if (offset < 0 || offset > _size
+                    || std::ranges::size(range) > (std::size_t)(_size - offset))
+                throw std::out_of_range("SafeArray::copy_from(): range "
+                        "doesn't fit");
+            const SafeIterator hold = safe_rw_iterator(0);
+            _copy_in(std::forward<Range>(range), offset);
+        }
+
+        // Exchanges every element with other's, which must be the same
+        // size; throws std::length_error if it isn't.  Takes a write
+        // session on both arrays, always in the same order, so two threads
+        // swapping the same pair can't deadlock.
+        template <typename OtherAllocator>
+            requires std::swappable<T>
+        void swap_contents(SafeArray<T, OtherAllocator>& other)
+        {
+            FUNC_LOGGING();
+            if (other.size() != _size)
+                throw std::length_error("SafeArray::swap_contents(): arrays "
+                        "differ in size");
+            if ((const void*)&other == (const void*)this)
+                return;
+            if (std::less<const void*>{}(this, &other))
+            {
+                const SafeIterator hold = safe_rw_iterator(0);
+                auto other_hold = other.begin();
+                _swap_with(other_hold.operator->());
+            }
+            else
+            {
+                auto other_hold = other.begin();
+                const SafeIterator hold = safe_rw_iterator(0);
+                _swap_with(other_hold.operator->());
+            }
+        }
+
+        // Sorting and partitioning, each in one write session (the
+        // iterators can't: they are forward-only, and compare elements
+        // rather than positions).  sort() and stable_sort() run on
+        // init.num_threads threads, radix sorting arithmetic elements
+        // ordered by std::less; see parallel_sort.h.  Positions are indices,
+        // since no iterator would outlive the session.
+
+        template <typename Compare=std::less<>>
+            requires std::predicate<Compare&, const T&, const T&>
+        void sort(Compare comp=Compare(),
+                const ParallelInit& init=ParallelInit())
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_rw_iterator(0);
+            parallel_sort(_data, _data + _size, comp, init);
+        }
+        template <typename Compare=std::less<>>
+            requires std::predicate<Compare&, const T&, const T&>
+        void stable_sort(Compare comp=Compare(),
+                const ParallelInit& init=ParallelInit())
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_rw_iterator(0);
+            parallel_stable_sort(_data, _data + _size, comp, init);
+        }
+
+        // Puts the element that a sort would put at nth there, with none
+        // after it less and none before it greater; throws std::out_of_range
+        // if nth isn't in [0, size()].
+        template <typename Compare=std::less<>>
+            requires std::predicate<Compare&, const T&, const T&>
+        void nth_element(size_type nth, Compare comp=Compare())
+        {
+            FUNC_LOGGING();
+            if (nth < 0 || nth > _size)
+                throw std::out_of_range("SafeArray::nth_element(): nth is "
+                        "out of range");
+            const SafeIterator hold = safe_rw_iterator(0);
+            std::nth_element(_data, _data + nth, _data + _size, comp);
+        }
+
+        // Moves the elements satisfying pred before those that don't, and
+        // returns the index of the first that doesn't (size() if all do).
+        template <typename Predicate>
+            requires std::predicate<Predicate&, const T&>
+        size_type partition(Predicate pred)
+        {
+            FUNC_LOGGING();
+            const SafeIterator hold = safe_rw_iterator(0);
+            return (size_type)(std::partition(_data, _data + _size, pred)
+                    - _data);
+        }
+
+        // Contention statistics, for all iterators over this array; off by
+        // default.  See AccessCtr.
+        void set_stats_enabled(bool enabled)
+        {
+            _access_ctr->set_stats_enabled(enabled);
+        }
+        void set_starvation_threshold(std::chrono::nanoseconds threshold)
+        {
+            _access_ctr->set_starvation_threshold(threshold);
+        }
+        AccessStats get_stats() const { return _access_ctr->get_stats(); }
+        // Show holds and blocked waits on this array to 'watchdog' (null to
+        // stop), under 'name'.  See watchdog.h.
+        void set_watchdog(Watchdog* watchdog, const char* name="")
+        {
+            _access_ctr->set_watchdog(watchdog, name);
+        }
+
         int get_writer_ct() const 
         {
             FUNC_LOGGING();
@@ -305,11 +732,160 @@ class SafeArray
         }
 
     private:
+        struct Unconstructed {};
+
+        // Allocates, but constructs nothing; every public constructor
+        // delegates here.
+        SafeArray(size_type size, const Allocator& allocator, Unconstructed)
+            : _allocator(allocator),
+            _data{ std::allocator_traits<Allocator>::allocate(_allocator,
+                    size) },
+            _size(size),
+            _access_ctr{ new PaddedAccessCtr() },
+            _cond_var{ new PaddedCondVar() }
+        {}
+
+        // Fills the storage from a snapshot; see load().
+        SafeArray(size_type size, const Allocator& allocator, Unconstructed,
+                int fd)
+            : SafeArray(size, allocator, Unconstructed{})
+        {
+            FUNC_LOGGING();
+            _construct([this, fd](size_type, size_type){
+                    detail::read_streaming(fd, _data, _size*sizeof(T));
+                    });
+        }
+
+        // Runs construct(0, size).  Since the delegating constructor has
+        // already finished, a throw here would run ~SafeArray, so on failure
+        // we free the storage and leave nothing for it to do.  construct must
+        // itself destroy anything it built before throwing, as the
+        // std::uninitialized_* algorithms do.
+        template <typename Construct>
+        void _construct(Construct construct)
+        {
+            try
+            {
+                construct(0, _size);
+            }
+            catch (...)
+            {
+                std::allocator_traits<Allocator>::deallocate(_allocator,
+                        _data, _size);
+                _data = nullptr;
+                _size = 0;
+                throw;
+            }
+        }
+
+        template <typename Range>
+        static size_type _range_size(Range& range)
+        {
+            const auto n = std::ranges::size(range);
+            if ((std::uint64_t)n
+                    > (std::uint64_t)std::numeric_limits<size_type>::max())
+                throw std::length_error("SafeArray: range is too long for "
+                        "size_type");
+            return (size_type)n;
+        }
+
+        template <typename Generator>
+        void _generate(Generator& gen, size_type first, size_type last)
+        {
+            size_type i = first;
+            try
+            {
+                for ( ; i<last; ++i)
+                    ::new ((void*)(_data+i)) T(gen(i));
+            }
+            catch (...)
+            {
+                std::destroy(_data+first, _data+i);
+                throw;
+            }
+        }
+
+        // Copies range into the elements from offset on; the caller holds
+        // the array for writing and has checked that range fits.
+        template <typename Range>
+        void _copy_in(Range&& range, size_type offset)
+        {
+            typedef std::ranges::range_value_t<Range> From;
+            const std::size_t n = std::ranges::size(range);
+            if constexpr (byte_copyable<T>
+                    && std::ranges::contiguous_range<Range>
+                    && std::same_as<std::remove_cv_t<From>, T>)
+                detail::bulk_copy(_data + offset, std::ranges::data(range),
+                        n * sizeof(T));
+            else if constexpr (std::is_lvalue_reference_v<Range>)
+                std::copy_n(std::ranges::begin(range), n, _data + offset);
+            else
+                std::copy_n(std::make_move_iterator(std::ranges::begin(range)),
+                        n, _data + offset);
+        }
+
+        // Exchanges every element with those at theirs; the caller holds
+        // both arrays for writing.
+        void _swap_with(T* theirs)
+        {
+            if constexpr (byte_copyable<T>)
+            {
+                constexpr std::size_t CHUNK = 4096 / sizeof(T) + 1;
+                alignas(T) unsigned char buffer[CHUNK * sizeof(T)];
+                for (size_type i=0; i<_size; i+=CHUNK)
+                {
+                    const std::size_t bytes
+                        = std::min<std::size_t>(CHUNK, _size - i) * sizeof(T);
+                    std::memcpy(buffer, (const void*)(_data + i), bytes);
+                    std::memcpy((void*)(_data + i), (const void*)(theirs + i),
+                            bytes);
+                    std::memcpy((void*)(theirs + i), buffer, bytes);
+                }
+            }
+            else
+                std::swap_ranges(_data, _data + _size, theirs);
+        }
+
+        // Made on first use, so arrays that never see an atomic update don't
+        // pay for one.
+        UpdateGate& _gate() const
+        {
+            UpdateGate* gate = _update_gate.load(std::memory_order_acquire);
+            if (gate)
+                return *gate;
+            UpdateGate* fresh = new UpdateGate();
+            if (_update_gate.compare_exchange_strong(gate, fresh,
+                        std::memory_order_acq_rel))
+                return *fresh;
+            delete fresh;
+            return *gate;
+        }
+
+        void _release()
+        {
+            delete _update_gate.load(std::memory_order_relaxed);
+            _update_gate.store(nullptr, std::memory_order_relaxed);
+            if (!_data)
+                return;
+            std::destroy_n(_data, _size);
+            std::allocator_traits<Allocator>::deallocate(_allocator, _data,
+                    _size);
+            _data = nullptr;
+            _size = 0;
+        }
+
+        // Padding the heap-allocated control blocks out to whole cache lines
+        // keeps iterator bookkeeping from false-sharing with element data.
+        struct alignas(CACHE_LINE_SIZE) PaddedAccessCtr : AccessCtr {};
+        struct alignas(CACHE_LINE_SIZE) PaddedCondVar
+            : std::condition_variable {};
+
         SafeIterator safe_rw_iterator(size_type offset)
         {
             std::unique_lock<std::mutex> lock{_mutex};
-            _cond_var->wait(lock, [this]{
-                    return !_access_ctr->get_has_other_accessors();
+            _access_ctr->wait(*_cond_var, lock, AccessCtr::MODE::READ_WRITE,
+                    [this]{
+                        return !_access_ctr->get_has_other_accessors();
                     });
             return SafeIterator{_data+offset, _cond_var,
                 _access_ctr, _mutex, SafeIterator::ITER_MODE::READ_WRITE};
@@ -317,19 +893,22 @@ class SafeArray
         SafeIterator safe_read_iterator(size_type offset) const
         {
             std::unique_lock<std::mutex> lock{_mutex};
-            _cond_var->wait(lock, [this]{
-                    return !_access_ctr->get_has_other_writers();
+            _access_ctr->wait(*_cond_var, lock, AccessCtr::MODE::READ,
+                    [this]{
+                        return !_access_ctr->get_has_other_writers();
                     });
             return SafeIterator{_data+offset, _cond_var, _access_ctr, _mutex};
         }
 
+        Allocator _allocator;
         T* _data;
         size_type _size;
 
         AccessCtrPtr _access_ctr;
 
         mutable CondVarPtr _cond_var;
-        mutable std::mutex _mutex;
+        alignas(CACHE_LINE_SIZE) mutable std::mutex _mutex;
+        mutable std::atomic<UpdateGate*> _update_gate{nullptr};
     };
 //}
 
@@ -0,0 +1,110 @@
+#ifndef SAFE_ARRAY_FIXED_H
+#define SAFE_ARRAY_FIXED_H
+
+#include <array>
+#include <cassert>
+
+#include "access_word.h"
+#include "guarded_iterator.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+namespace fixed
+{
+
+// A SafeArray whose size is fixed at compile time.  The elements live inline
+// in a std::array and the synchronization state is a single AccessWord, so
+// constructing one allocates nothing and the whole object is N*sizeof(T)
+// plus 16 bytes.  Iteration semantics are those of sa::SafeArray: one thread
+// with read/write iterators, or any number with read iterators.
+template <typename T, int N>
+class SafeArray
+{
+    static_assert(N >= 0, "SafeArray size must be non-negative");
+
+    public:
+        typedef int size_type;
+        typedef T value_type;
+        typedef GuardedIterator<T> SafeIterator;
+        typedef GuardedIterator<const T> ConstSafeIterator;
+        typedef SafeIterator iterator;
+        typedef ConstSafeIterator const_iterator;
+        typedef T* Iterator;
+
+        SafeArray() = default;
+        SafeArray(const T& value)
+        {
+            _data.fill(value);
+        }
+
+        SafeArray(const SafeArray&) = delete;
+        SafeArray& operator=(const SafeArray&) = delete;
+
+        static constexpr size_type size() { return N; }
+
+        // Random access without explict construction of an iterator is
+        // read-only, sorry
+        const T& operator[](size_type index) const
+        {
+            assert(index < N);
+            return _data[index];
+        }
+
+        Iterator unsafe_begin() { return _data.data(); }
+        Iterator unsafe_end() { return _data.data() + N; }
+
+        ConstSafeIterator cbegin() const
+        {
+            FUNC_LOGGING();
+            return safe_read_iterator(0);
+        }
+        ConstSafeIterator cend() const
+        {
+            FUNC_LOGGING();
+            return safe_read_iterator(N);
+        }
+        SafeIterator begin()
+        {
+            FUNC_LOGGING();
+            return safe_rw_iterator(0);
+        }
+        SafeIterator end()
+        {
+            FUNC_LOGGING();
+            return safe_rw_iterator(N);
+        }
+
+        // Unlike sa::SafeArray, the reader count is across all threads; the
+        // writer count is for the calling thread.
+        int get_writer_ct() const { return _access_word.get_writer_ct(); }
+        int get_reader_ct() const { return _access_word.get_reader_ct(); }
+
+    private:
+        SafeIterator safe_rw_iterator(size_type offset)
+        {
+            return SafeIterator{_data.data()+offset, _access_word,
+                SafeIterator::ITER_MODE::READ_WRITE};
+        }
+        ConstSafeIterator safe_read_iterator(size_type offset) const
+        {
+            return ConstSafeIterator{_data.data()+offset, _access_word};
+        }
+
+        std::array<T, N> _data{};
+        mutable AccessWord _access_word;
+};
+
+} // fixed
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_ARRAY_FIXED_H
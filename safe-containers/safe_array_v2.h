@@ -11,7 +11,8 @@
 #include "access_ctr.h"
 
 #ifdef DEBUG_ACCESS
-    #define FUNC_LOGGING() ScopeTracker st{__func__}
+    #define FUNC_LOGGING() static const ScopeName st_name{__func__}; \
+        ScopeTracker st{st_name}
 #else
     #define FUNC_LOGGING() 0
 #endif
@@ -0,0 +1,261 @@
+#ifndef SAFE_BIT_ARRAY_H
+#define SAFE_BIT_ARRAY_H
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+#include "access_word.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// A packed array of flags, one bit each, for what would otherwise be a
+// SafeArray<bool> or SafeArray<char>.
+//
+// Single bits are set, cleared and tested with atomic operations on the
+// 64-bit word that holds them, so they need no session at all.  Whole-array
+// operations -- count(), find_first(), and the bulk &=, |= and ^= -- run
+// under sessions in the usual way: a read session to scan, a write session
+// to modify.  Sessions exclude one another but not the per-bit operations,
+// which are always safe: a bulk operation sees, and never loses, each
+// concurrent per-bit update, though it may see some and not others.
+class SafeBitArray
+{
+    public:
+        typedef std::size_t size_type;
+        typedef std::uint64_t word_type;
+        typedef AccessWord::MODE MODE;
+
+        static constexpr size_type npos = static_cast<size_type>(-1);
+        static constexpr size_type WORD_BITS = 64;
+
+        // All bits start clear.
+        explicit SafeBitArray(size_type size)
+            : _size{size},
+            _num_words{ (size + WORD_BITS - 1) / WORD_BITS },
+            _words{ new std::atomic<word_type>[_num_words]() }
+        {}
+
+        SafeBitArray(const SafeBitArray&) = delete;
+        SafeBitArray& operator=(const SafeBitArray&) = delete;
+
+        size_type size() const { return _size; }
+
+        // Per-bit operations; no session needed.
+
+        bool test(size_type i,
+                std::memory_order order=std::memory_order_seq_cst) const
+        {
+            assert(i < _size);
+            return _word(i).load(order) & _mask(i);
+        }
+        void set(size_type i,
+                std::memory_order order=std::memory_order_seq_cst)
+        {
+            assert(i < _size);
+            _word(i).fetch_or(_mask(i), order);
+        }
+        void clear(size_type i,
+                std::memory_order order=std::memory_order_seq_cst)
+        {
+            assert(i < _size);
+            _word(i).fetch_and(~_mask(i), order);
+        }
+        void flip(size_type i,
+                std::memory_order order=std::memory_order_seq_cst)
+        {
+            assert(i < _size);
+            _word(i).fetch_xor(_mask(i), order);
+        }
+        // Sets bit i and returns its previous value, so exactly one of any
+        // number of racing callers sees false.
+        bool test_and_set(size_type i,
+                std::memory_order order=std::memory_order_seq_cst)
+        {
+            assert(i < _size);
+            return _word(i).fetch_or(_mask(i), order) & _mask(i);
+        }
+        bool test_and_clear(size_type i,
+                std::memory_order order=std::memory_order_seq_cst)
+        {
+            assert(i < _size);
+            return _word(i).fetch_and(~_mask(i), order) & _mask(i);
+        }
+
+        // Read-session operations.
+
+        // Number of set bits.
+        size_type count() const
+        {
+            FUNC_LOGGING();
+            const AccessHold hold{_access_word, MODE::READ};
+            // Four independent sums keep several popcnts in flight.
+            size_type sums[4] = {};
+            size_type w = 0;
+            for ( ; w+4<=_num_words; w+=4)
+                for (int k=0; k<4; ++k)
+                    sums[k] += std::popcount(_load(w+k));
+            for ( ; w<_num_words; ++w)
+                sums[0] += std::popcount(_load(w));
+            return sums[0] + sums[1] + sums[2] + sums[3];
+        }
+        bool any() const { return find_first() != npos; }
+        bool none() const { return !any(); }
+
+        // Index of the first set bit at or after 'from', or npos.
+        size_type find_first(size_type from=0) const
+        {
+            FUNC_LOGGING();
+            if (from >= _size)
+                return npos;
+            const AccessHold hold{_access_word, MODE::READ};
+            size_type w = from / WORD_BITS;
+            word_type word = _load(w) & (~word_type(0) << (from % WORD_BITS));
+            while (word == 0)
+            {
+                if (++w == _num_words)
+                    return npos;
+                word = _load(w);
+            }
+            return w * WORD_BITS + std::countr_zero(word);
+        }
+
+        // Call f(i) for every set bit i, in order, under one read session.
+        template <typename Func>
+        void for_each_set(Func f) const
+        {
+            FUNC_LOGGING();
+            const AccessHold hold{_access_word, MODE::READ};
+            for (size_type w=0; w<_num_words; ++w)
+                for (word_type word=_load(w); word; word&=word-1)
+                    f(w * WORD_BITS + std::countr_zero(word));
+        }
+
+        // Write-session operations.
+
+        void set_all()
+        {
+            FUNC_LOGGING();
+            const AccessHold hold{_access_word, MODE::READ_WRITE};
+            for (size_type w=0; w<_num_words; ++w)
+                _words[w].store(_valid_bits(w), std::memory_order_relaxed);
+        }
+        void clear_all()
+        {
+            FUNC_LOGGING();
+            const AccessHold hold{_access_word, MODE::READ_WRITE};
+            for (size_type w=0; w<_num_words; ++w)
+                _words[w].store(0, std::memory_order_relaxed);
+        }
+
+        // Combine rhs into this array, bit by bit.  Takes a write session on
+        // this array and a read session on rhs, in address order, so two
+        // threads doing a &= b and b &= a can't deadlock.  The arrays must be
+        // the same size.
+        SafeBitArray& operator&=(const SafeBitArray& rhs)
+        {
+            FUNC_LOGGING();
+            _combine(rhs, [](std::atomic<word_type>& w, word_type r){
+                    w.fetch_and(r, std::memory_order_relaxed);
+                    });
+            return *this;
+        }
+        SafeBitArray& operator|=(const SafeBitArray& rhs)
+        {
+            FUNC_LOGGING();
+            _combine(rhs, [](std::atomic<word_type>& w, word_type r){
+                    w.fetch_or(r, std::memory_order_relaxed);
+                    });
+            return *this;
+        }
+        SafeBitArray& operator^=(const SafeBitArray& rhs)
+        {
+            FUNC_LOGGING();
+            _combine(rhs, [](std::atomic<word_type>& w, word_type r){
+                    w.fetch_xor(r, std::memory_order_relaxed);
+                    });
+            return *this;
+        }
+
+        // Readers across all threads; writers for the calling thread.
+        int get_writer_ct() const { return _access_word.get_writer_ct(); }
+        int get_reader_ct() const { return _access_word.get_reader_ct(); }
+
+    private:
+        std::atomic<word_type>& _word(size_type i) const
+        {
+            return _words[i / WORD_BITS];
+        }
+        static word_type _mask(size_type i)
+        {
+            return word_type(1) << (i % WORD_BITS);
+        }
+        word_type _load(size_type w) const
+        {
+            return _words[w].load(std::memory_order_relaxed);
+        }
+        // Bits of word w that are inside the array; the rest stay clear.
+        word_type _valid_bits(size_type w) const
+        {
+            const size_type tail = _size % WORD_BITS;
+            return (w + 1 == _num_words && tail != 0)
+                ? (word_type(1) << tail) - 1 : ~word_type(0);
+        }
+
+        template <typename Op>
+        void _combine(const SafeBitArray& rhs, Op op)
+        {
+            if (rhs._size != _size)
+                throw std::invalid_argument(
+                        "SafeBitArray: combining arrays of different sizes");
+            if (&rhs == this)
+            {
+                const AccessHold hold{_access_word, MODE::READ_WRITE};
+                _apply(rhs, op);
+                return;
+            }
+            if (std::less<const SafeBitArray*>{}(this, &rhs))
+            {
+                const AccessHold mine{_access_word, MODE::READ_WRITE};
+                const AccessHold theirs{rhs._access_word, MODE::READ};
+                _apply(rhs, op);
+            }
+            else
+            {
+                const AccessHold theirs{rhs._access_word, MODE::READ};
+                const AccessHold mine{_access_word, MODE::READ_WRITE};
+                _apply(rhs, op);
+            }
+        }
+        template <typename Op>
+        void _apply(const SafeBitArray& rhs, Op op)
+        {
+            for (size_type w=0; w<_num_words; ++w)
+                op(_words[w], rhs._load(w));
+        }
+
+        const size_type _size;
+        const size_type _num_words;
+        std::unique_ptr<std::atomic<word_type>[]> _words;
+        mutable AccessWord _access_word;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_BIT_ARRAY_H
@@ -0,0 +1,251 @@
+#ifndef SAFE_COLUMNS_H
+#define SAFE_COLUMNS_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "access_word.h"
+#include "allocators.h"
+#include "column_span.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// Records of type (Ts...) stored column by column: each field in its own
+// contiguous, cache-aligned array, so a scan over one field streams only
+// that field through the cache and vectorizes like a plain array.
+//
+// Each column has its own AccessWord, so the SafeArray rule -- one thread
+// with read/write access, or any number with read access -- applies per
+// column: column<0>() and ccolumn<1>() from different threads don't wait on
+// one another.  Row iterators, which touch every field, hold every column,
+// taking them in index order so they can't deadlock with one another.
+template <typename... Ts>
+class SafeColumns
+{
+    static_assert(sizeof...(Ts) > 0, "SafeColumns needs at least one column");
+
+    public:
+        typedef int size_type;
+        typedef std::tuple<Ts...> value_type;
+        typedef AccessWord::MODE ITER_MODE;
+
+        static constexpr std::size_t NUM_COLUMNS = sizeof...(Ts);
+
+        template <std::size_t I>
+        using column_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+        // Walks the rows, dereferencing to a tuple of references to the
+        // row's fields.  Holds every column.
+        template <bool Const>
+        class RowIterator
+        {
+            public:
+                typedef RowIterator self_type;
+                typedef std::tuple<Ts...> value_type;
+                typedef std::conditional_t<Const, std::tuple<const Ts&...>,
+                        std::tuple<Ts&...>> reference;
+                typedef std::forward_iterator_tag iterator_category;
+                typedef int difference_type;
+
+                RowIterator(const SafeColumns* columns, size_type index,
+                        ITER_MODE iter_mode)
+                    : _holds{ columns->_take_all(iter_mode,
+                            std::index_sequence_for<Ts...>{}) },
+                    _columns{columns},
+                    _index{index}
+                {}
+
+                self_type operator++(int)
+                {
+                    assert( std::this_thread::get_id() == _holds[0].tid() );
+                    self_type iter = *this;
+                    ++_index;
+                    return iter;
+                }
+                self_type& operator++()
+                {
+                    assert( std::this_thread::get_id() == _holds[0].tid() );
+                    ++_index;
+                    return *this;
+                }
+                reference operator*() const
+                {
+                    assert( std::this_thread::get_id() == _holds[0].tid() );
+                    return _row(std::index_sequence_for<Ts...>{});
+                }
+                // This row's field I.
+                template <std::size_t I>
+                std::tuple_element_t<I, reference> get() const
+                {
+                    assert( std::this_thread::get_id() == _holds[0].tid() );
+                    return std::get<I>(_columns->_columns).data[_index];
+                }
+                size_type index() const { return _index; }
+
+                difference_type operator-(const self_type& rhs) const
+                { return _index - rhs._index; }
+                bool operator<(const self_type& rhs) const
+                { return _index < rhs._index; }
+                bool operator==(const self_type& rhs) const
+                { return _index == rhs._index; }
+                bool operator!=(const self_type& rhs) const
+                { return !(*this == rhs); }
+
+                ITER_MODE mode() const { return _holds[0].mode(); }
+
+            private:
+                template <std::size_t... Is>
+                reference _row(std::index_sequence<Is...>) const
+                {
+                    return reference{ std::get<Is>(_columns->_columns)
+                        .data[_index]... };
+                }
+
+                std::array<AccessHold, NUM_COLUMNS> _holds;
+                const SafeColumns* _columns;
+                size_type _index;
+        };
+
+        typedef RowIterator<false> SafeIterator;
+        typedef RowIterator<true> ConstSafeIterator;
+        typedef SafeIterator iterator;
+        typedef ConstSafeIterator const_iterator;
+
+        // Every field of every row is default-initialized, as for SafeArray.
+        explicit SafeColumns(size_type size)
+            : _size{size},
+            _columns{ ((void)sizeof(Ts), size)... }
+        {}
+
+        SafeColumns(const SafeColumns&) = delete;
+        SafeColumns& operator=(const SafeColumns&) = delete;
+
+        size_type size() const { return _size; }
+
+        // Read-only, like SafeArray's operator[].
+        template <std::size_t I>
+        const column_type<I>& get(size_type index) const
+        {
+            assert(index < _size);
+            return std::get<I>(_columns).data[index];
+        }
+
+        // Column I as a span, read-only or read/write.
+        template <std::size_t I>
+        ColumnSpan<const column_type<I>> ccolumn() const
+        {
+            FUNC_LOGGING();
+            auto& col = std::get<I>(_columns);
+            return ColumnSpan<const column_type<I>>{col.data, (size_t)_size,
+                col.access_word, ITER_MODE::READ};
+        }
+        template <std::size_t I>
+        ColumnSpan<column_type<I>> column()
+        {
+            FUNC_LOGGING();
+            auto& col = std::get<I>(_columns);
+            return ColumnSpan<column_type<I>>{col.data, (size_t)_size,
+                col.access_word, ITER_MODE::READ_WRITE};
+        }
+
+        ConstSafeIterator cbegin() const
+        {
+            FUNC_LOGGING();
+            return ConstSafeIterator{this, 0, ITER_MODE::READ};
+        }
+        ConstSafeIterator cend() const
+        {
+            FUNC_LOGGING();
+            return ConstSafeIterator{this, _size, ITER_MODE::READ};
+        }
+        SafeIterator begin()
+        {
+            FUNC_LOGGING();
+            return SafeIterator{this, 0, ITER_MODE::READ_WRITE};
+        }
+        SafeIterator end()
+        {
+            FUNC_LOGGING();
+            return SafeIterator{this, _size, ITER_MODE::READ_WRITE};
+        }
+
+        // For column I: read holds across all threads, write holds by the
+        // calling thread.
+        template <std::size_t I>
+        int get_writer_ct() const
+        {
+            return std::get<I>(_columns).access_word.get_writer_ct();
+        }
+        template <std::size_t I>
+        int get_reader_ct() const
+        {
+            return std::get<I>(_columns).access_word.get_reader_ct();
+        }
+
+    private:
+        template <typename T>
+        struct Column
+        {
+            explicit Column(size_type size)
+                : data{ allocator.allocate(size) },
+                size{size}
+            {
+                try
+                {
+                    std::uninitialized_default_construct_n(data, size);
+                }
+                catch (...)
+                {
+                    allocator.deallocate(data, size);
+                    throw;
+                }
+            }
+            Column(const Column&) = delete;
+            ~Column()
+            {
+                std::destroy_n(data, size);
+                allocator.deallocate(data, size);
+            }
+
+            CacheAlignedAllocator<T> allocator;
+            T* data;
+            size_type size;
+            // On its own line, so holds on neighbouring columns don't
+            // false-share.
+            alignas(CACHE_LINE_SIZE) mutable AccessWord access_word;
+        };
+
+        // Braced initialization runs left to right, so the holds are taken
+        // in column order.
+        template <std::size_t... Is>
+        std::array<AccessHold, NUM_COLUMNS> _take_all(ITER_MODE mode,
+                std::index_sequence<Is...>) const
+        {
+            return { AccessHold{std::get<Is>(_columns).access_word, mode}... };
+        }
+
+        const size_type _size;
+        std::tuple<Column<Ts>...> _columns;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_COLUMNS_H
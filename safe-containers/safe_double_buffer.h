@@ -0,0 +1,308 @@
+#ifndef SAFE_DOUBLE_BUFFER_H
+#define SAFE_DOUBLE_BUFFER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// A SafeDoubleBuffer keeps NumBuffers complete copies of an array.  Readers
+// always see the most recently published copy (the 'front') and never wait
+// on a writer.  One writer at a time fills a private 'back' copy without
+// holding anything readers care about, then publish()es it, which flips it to
+// the front in a single atomic store.  A copy is only handed to a writer
+// again once every reader still looking at it has let go.
+//
+// Usage:
+//     auto w = buf.write();           // may wait for stragglers on the back
+//     for (auto& x : w) x = ...;      // readers are not blocked
+//     w.publish();
+//
+//     auto r = buf.read();            // one load + one pin, never blocks
+//     for (const auto& x : r) ...;    // a complete, unchanging generation
+template <typename T, int NumBuffers=2>
+class SafeDoubleBuffer
+{
+    static_assert(NumBuffers >= 2, "SafeDoubleBuffer needs at least 2 buffers");
+    static_assert(NumBuffers <= 255, "Buffer index must fit in 8 bits");
+
+    public:
+        class ReadHandle;
+        class WriteHandle;
+
+        typedef int size_type;
+        typedef T value_type;
+        typedef std::uint64_t generation_type;
+
+    private:
+        // The front word packs the published buffer's index into the low 8
+        // bits and its generation into the rest, so one load yields both.
+        static constexpr int INDEX_BITS = 8;
+        static constexpr std::uint64_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+        struct Buffer
+        {
+            // Owned, so a constructor that throws part way frees it.
+            std::unique_ptr<T[]> data;
+            std::atomic<int> pins{0};
+        };
+
+        static int _index(std::uint64_t front) { return front & INDEX_MASK; }
+        static generation_type _generation(std::uint64_t front)
+        { return front >> INDEX_BITS; }
+
+        static void _unpin(Buffer& buffer)
+        {
+            if (buffer.pins.fetch_sub(1) == 1)
+                buffer.pins.notify_all();
+        }
+
+    public:
+        // A ReadHandle pins one published generation for as long as it
+        // lives.  It may be copied (each copy holds its own pin) and handed to
+        // other threads.
+        class ReadHandle
+        {
+            public:
+                typedef const T* const_iterator;
+                typedef const_iterator iterator;
+
+                ReadHandle(const ReadHandle& rhs)
+                    : _buffer{rhs._buffer},
+                    _size{rhs._size},
+                    _generation{rhs._generation}
+                {
+                    if (_buffer)
+                        _buffer->pins.fetch_add(1);
+                }
+                ReadHandle(ReadHandle&& rhs)
+                    : _buffer{rhs._buffer},
+                    _size{rhs._size},
+                    _generation{rhs._generation}
+                {
+                    rhs._buffer = nullptr;
+                }
+                ReadHandle& operator=(ReadHandle rhs)
+                {
+                    std::swap(_buffer, rhs._buffer);
+                    _size = rhs._size;
+                    _generation = rhs._generation;
+                    return *this;
+                }
+                ~ReadHandle()
+                {
+                    if (_buffer)
+                        _unpin(*_buffer);
+                }
+
+                const_iterator begin() const { return _buffer->data.get(); }
+                const_iterator end() const
+                { return _buffer->data.get() + _size; }
+                const T* data() const { return _buffer->data.get(); }
+                size_type size() const { return _size; }
+                generation_type generation() const { return _generation; }
+
+                const T& operator[](size_type index) const
+                {
+                    assert(index < _size);
+                    return _buffer->data[index];
+                }
+
+            private:
+                friend class SafeDoubleBuffer;
+                ReadHandle(Buffer& buffer, size_type size,
+                        generation_type generation)
+                    : _buffer{&buffer},
+                    _size{size},
+                    _generation{generation}
+                {}
+
+                Buffer* _buffer;
+                size_type _size;
+                generation_type _generation;
+        };
+
+        // A WriteHandle owns the back buffer exclusively until it is
+        // published or destroyed.  Destroying it without publishing discards
+        // the work; the buffer simply becomes eligible for the next writer.
+        class WriteHandle
+        {
+            public:
+                typedef T* iterator;
+
+                WriteHandle(const WriteHandle&) = delete;
+                WriteHandle& operator=(const WriteHandle&) = delete;
+                WriteHandle(WriteHandle&& rhs)
+                    : _owner{rhs._owner},
+                    _index{rhs._index},
+                    _lock{std::move(rhs._lock)}
+                {
+                    rhs._owner = nullptr;
+                }
+                WriteHandle& operator=(WriteHandle&&) = delete;
+                ~WriteHandle() = default;
+
+                iterator begin() { return data(); }
+                iterator end() { return data() + _owner->_size; }
+                T* data()
+                {
+                    assert( _owner );
+                    return _owner->_buffers[_index].data.get();
+                }
+                size_type size() const { return _owner->_size; }
+
+                T& operator[](size_type index)
+                {
+                    assert(index < _owner->_size);
+                    return data()[index];
+                }
+
+                // Start from the current front rather than whatever stale
+                // generation this buffer last held.  Useful for incremental
+                // edits; a full rebuild does not need it.
+                void copy_front()
+                {
+                    FUNC_LOGGING();
+                    const ReadHandle front = _owner->read();
+                    std::copy(front.begin(), front.end(), data());
+                }
+
+                // Make the back buffer the front.  Returns the generation
+                // readers will now see.  The handle is spent afterwards.
+                generation_type publish()
+                {
+                    FUNC_LOGGING();
+                    assert( _owner );
+                    const generation_type generation = _owner->_publish(_index);
+                    _owner = nullptr;
+                    _lock.unlock();
+                    return generation;
+                }
+
+            private:
+                friend class SafeDoubleBuffer;
+                WriteHandle(SafeDoubleBuffer& owner, int index,
+                        std::unique_lock<std::mutex>&& lock)
+                    : _owner{&owner},
+                    _index{index},
+                    _lock{std::move(lock)}
+                {}
+
+                SafeDoubleBuffer* _owner;
+                int _index;
+                std::unique_lock<std::mutex> _lock;
+        };
+
+        SafeDoubleBuffer(size_type size, const T& value=T())
+            : _size{size},
+            _front{0}
+        {
+            FUNC_LOGGING();
+            for (auto& buffer : _buffers)
+            {
+                buffer.data.reset(new T[size]);
+                std::fill(buffer.data.get(), buffer.data.get()+size, value);
+            }
+        }
+
+        SafeDoubleBuffer(const SafeDoubleBuffer&) = delete;
+        SafeDoubleBuffer& operator=(const SafeDoubleBuffer&) = delete;
+
+        ~SafeDoubleBuffer()
+        {
+            FUNC_LOGGING();
+            assert( std::all_of(_buffers.begin(), _buffers.end(),
+                        [](const Buffer& b){ return b.pins.load() == 0; }) );
+        }
+
+        size_type size() const { return _size; }
+        generation_type generation() const
+        {
+            return _generation(_front.load(std::memory_order_acquire));
+        }
+
+        // Pin the latest published generation.  Never waits: if a publish
+        // races with the pin we just retry against the new front.
+        ReadHandle read() const
+        {
+            FUNC_LOGGING();
+            for (;;)
+            {
+                const std::uint64_t front = _front.load();
+                Buffer& buffer = _buffers[_index(front)];
+                buffer.pins.fetch_add(1);
+                // The pin and this re-load are both seq_cst, as are the
+                // writer's publish and its pin check in _claim(), so either
+                // the writer sees our pin or we see that it moved the front.
+                if (_front.load() == front)
+                    return ReadHandle{buffer, _size, _generation(front)};
+                _unpin(buffer);
+            }
+        }
+
+        // Claim a back buffer.  Only one WriteHandle exists at a time; other
+        // writers queue here, but readers are never involved.
+        WriteHandle write()
+        {
+            FUNC_LOGGING();
+            std::unique_lock<std::mutex> lock{_write_mutex};
+            const int index = _claim();
+            return WriteHandle{*this, index, std::move(lock)};
+        }
+
+    private:
+        // Prefer any idle back buffer; otherwise wait for the readers of the
+        // oldest one to drain.  Called with _write_mutex held, so the front
+        // cannot move underneath us.
+        int _claim()
+        {
+            const int front = _index(_front.load());
+            for (int i=1; i<NumBuffers; ++i)
+            {
+                const int index = (front + i) % NumBuffers;
+                if (_buffers[index].pins.load() == 0)
+                    return index;
+            }
+            const int index = (front + 1) % NumBuffers;
+            Buffer& buffer = _buffers[index];
+            for (int pins = buffer.pins.load(); pins != 0;
+                    pins = buffer.pins.load())
+                buffer.pins.wait(pins);
+            return index;
+        }
+
+        generation_type _publish(int index)
+        {
+            const generation_type generation
+                = _generation(_front.load(std::memory_order_relaxed)) + 1;
+            _front.store( (generation << INDEX_BITS) | index );
+            return generation;
+        }
+
+        size_type _size;
+        mutable std::array<Buffer, NumBuffers> _buffers;
+        std::atomic<std::uint64_t> _front;
+        std::mutex _write_mutex;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_DOUBLE_BUFFER_H
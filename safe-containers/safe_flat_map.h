@@ -0,0 +1,382 @@
+#ifndef SAFE_FLAT_MAP_H
+#define SAFE_FLAT_MAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "epoch.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// A sorted map stored as two contiguous arrays, one of keys and one of
+// values.  Lookups run a branch-free binary search over an immutable
+// snapshot, so they never wait on a writer.  Writes are buffered and merged
+// into a fresh snapshot in batches; until a batch is merged it is not
+// visible to lookups.  Call merge() to force pending writes through.
+//
+// The current snapshot is published as a plain pointer, and readers pin the
+// EpochDomain (see epoch.h) rather than take a reference count, so a lookup
+// writes to no memory shared with other readers.  A merge retires the
+// snapshot it replaces there, to be freed once no reader can still hold it.
+template <typename K, typename V, typename Compare=std::less<K>>
+class SafeFlatMap
+{
+    public:
+        class Snapshot;
+        class Range;
+
+        class SnapshotPtr;
+
+        typedef int size_type;
+        typedef K key_type;
+        typedef V mapped_type;
+
+        // One published generation of the map.  Holding a SnapshotPtr keeps
+        // it alive and unchanged no matter how many merges happen meanwhile.
+        class Snapshot
+        {
+            public:
+                size_type size() const { return _keys.size(); }
+                const K* keys() const { return _keys.data(); }
+                const V* values() const { return _values.data(); }
+
+                // Index of the first key not less than 'key'.  The loop
+                // always runs log2(size) times and the comparison feeds a
+                // conditional move, not a branch.
+                size_type lower_bound(const K& key) const
+                {
+                    const K* const keys = _keys.data();
+                    size_type n = size();
+                    if (n == 0)
+                        return 0;
+                    const K* base = keys;
+                    while (n > 1)
+                    {
+                        const size_type half = n / 2;
+                        base = _comp(base[half], key) ? base + half : base;
+                        n -= half;
+                    }
+                    return (base - keys) + _comp(*base, key);
+                }
+                // Index of the first key greater than 'key'.
+                size_type upper_bound(const K& key) const
+                {
+                    const K* const keys = _keys.data();
+                    size_type n = size();
+                    if (n == 0)
+                        return 0;
+                    const K* base = keys;
+                    while (n > 1)
+                    {
+                        const size_type half = n / 2;
+                        base = !_comp(key, base[half]) ? base + half : base;
+                        n -= half;
+                    }
+                    return (base - keys) + !_comp(key, *base);
+                }
+
+                const V* find(const K& key) const
+                {
+                    const size_type index = lower_bound(key);
+                    if (index == size() || _comp(key, _keys[index]))
+                        return nullptr;
+                    return &_values[index];
+                }
+
+            private:
+                friend class SafeFlatMap;
+                Snapshot(const Compare& comp) : _comp{comp} {}
+
+                std::vector<K> _keys;
+                std::vector<V> _values;
+                Compare _comp;
+        };
+
+        // The current snapshot, pinned in the EpochDomain for as long as the
+        // SnapshotPtr lives.  Like a SafeSkipListMap iterator it belongs to
+        // the thread that took it, and holding one delays the freeing of
+        // everything retired to the EpochDomain, so don't keep it for long.
+        class SnapshotPtr
+        {
+            public:
+                const Snapshot* get() const { return _snapshot; }
+                const Snapshot* operator->() const { return _snapshot; }
+                const Snapshot& operator*() const { return *_snapshot; }
+
+            private:
+                friend class SafeFlatMap;
+                // Pins before loading, so the snapshot can't be freed between
+                // the two.
+                SnapshotPtr(const std::atomic<const Snapshot*>& snapshot)
+                    : _guard{ EpochDomain::instance() },
+                    _snapshot{ snapshot.load(std::memory_order_acquire) }
+                {}
+
+                EpochDomain::Guard _guard;
+                const Snapshot* _snapshot;
+        };
+
+        // A contiguous run of entries [first, last) in one snapshot.
+        class Range
+        {
+            public:
+                class Iterator
+                {
+                    public:
+                        typedef Iterator self_type;
+                        typedef std::pair<const K&, const V&> value_type;
+                        typedef value_type reference;
+                        typedef std::forward_iterator_tag iterator_category;
+                        typedef int difference_type;
+
+                        Iterator(const Snapshot* snapshot, size_type index)
+                            : _snapshot{snapshot}, _index{index}
+                        {}
+                        self_type operator++(int)
+                        {
+                            self_type iter = *this;
+                            ++_index;
+                            return iter;
+                        }
+                        self_type& operator++()
+                        {
+                            ++_index;
+                            return *this;
+                        }
+                        reference operator*() const
+                        {
+                            return reference{ _snapshot->keys()[_index],
+                                _snapshot->values()[_index] };
+                        }
+                        difference_type operator-(const self_type& rhs) const
+                        { return _index - rhs._index; }
+                        bool operator==(const self_type& rhs) const
+                        { return _index == rhs._index; }
+                        bool operator!=(const self_type& rhs) const
+                        { return !(*this == rhs); }
+
+                    private:
+                        const Snapshot* _snapshot;
+                        size_type _index;
+                };
+
+                Iterator begin() const { return Iterator{_snapshot.get(), _first}; }
+                Iterator end() const { return Iterator{_snapshot.get(), _last}; }
+                size_type size() const { return _last - _first; }
+                bool empty() const { return _first == _last; }
+                const K* keys() const { return _snapshot->keys() + _first; }
+                const V* values() const { return _snapshot->values() + _first; }
+
+            private:
+                friend class SafeFlatMap;
+                Range(SnapshotPtr snapshot, size_type first, size_type last)
+                    : _snapshot{std::move(snapshot)},
+                    _first{first},
+                    _last{last}
+                {}
+
+                SnapshotPtr _snapshot;
+                size_type _first;
+                size_type _last;
+        };
+
+        SafeFlatMap(size_type batch_size=1024, const Compare& comp=Compare())
+            : _batch_size{batch_size},
+            _comp{comp},
+            _snapshot{ new Snapshot{comp} }
+        {
+            FUNC_LOGGING();
+        }
+
+        SafeFlatMap(const SafeFlatMap&) = delete;
+        SafeFlatMap& operator=(const SafeFlatMap&) = delete;
+
+        // No other thread may be using the map; snapshots already retired are
+        // left to the EpochDomain.
+        ~SafeFlatMap()
+        {
+            FUNC_LOGGING();
+            delete _snapshot.load(std::memory_order_relaxed);
+        }
+
+        // The current generation.  Everything below is a convenience over
+        // this; hold on to the pointer to run several queries consistently.
+        SnapshotPtr snapshot() const { return SnapshotPtr{_snapshot}; }
+
+        size_type size() const { return snapshot()->size(); }
+
+        std::optional<V> find(const K& key) const
+        {
+            const SnapshotPtr snap = snapshot();
+            const V* value = snap->find(key);
+            if (!value)
+                return std::nullopt;
+            return *value;
+        }
+        bool contains(const K& key) const
+        {
+            return snapshot()->find(key) != nullptr;
+        }
+
+        // Entries with lo <= key < hi.
+        Range range(const K& lo, const K& hi) const
+        {
+            SnapshotPtr snap = snapshot();
+            const size_type first = snap->lower_bound(lo);
+            const size_type last = std::max(first, snap->lower_bound(hi));
+            return Range{std::move(snap), first, last};
+        }
+        // Entries with key >= lo.
+        Range range_from(const K& lo) const
+        {
+            SnapshotPtr snap = snapshot();
+            const size_type first = snap->lower_bound(lo);
+            const size_type last = snap->size();
+            return Range{std::move(snap), first, last};
+        }
+
+        // Buffered writes.  Later writes to the same key win, in the order
+        // the calls returned.  Once batch_size writes are pending the caller
+        // merges them, unless another thread is already merging.
+        void insert(const K& key, const V& value)
+        {
+            _buffer( PendingOp{key, value, false} );
+        }
+        void erase(const K& key)
+        {
+            _buffer( PendingOp{key, V(), true} );
+        }
+
+        size_type pending() const
+        {
+            std::lock_guard<std::mutex> lock{_pending_mutex};
+            return _pending.size();
+        }
+
+        // Fold every pending write into a new snapshot and publish it.
+        // Readers keep using the previous snapshot until the store.
+        void merge()
+        {
+            FUNC_LOGGING();
+            std::lock_guard<std::mutex> lock{_merge_mutex};
+            _merge();
+        }
+
+    private:
+        struct PendingOp
+        {
+            K key;
+            V value;
+            bool erase;
+        };
+
+        void _buffer(PendingOp&& op)
+        {
+            bool full;
+            {
+                std::lock_guard<std::mutex> lock{_pending_mutex};
+                _pending.push_back( std::move(op) );
+                full = (size_type)_pending.size() >= _batch_size;
+            }
+            if (!full)
+                return;
+            std::unique_lock<std::mutex> lock{_merge_mutex, std::try_to_lock};
+            if (lock)
+                _merge();
+        }
+
+        // Called with _merge_mutex held.  Taking the batch under that lock
+        // keeps batches merging in the order they were buffered.
+        void _merge()
+        {
+            std::vector<PendingOp> batch;
+            {
+                std::lock_guard<std::mutex> lock{_pending_mutex};
+                batch.swap(_pending);
+            }
+            if (batch.empty())
+                return;
+
+            auto op_less = [this](const PendingOp& a, const PendingOp& b)
+            {
+                return _comp(a.key, b.key);
+            };
+            std::stable_sort(batch.begin(), batch.end(), op_less);
+            // Keep only the last write to each key.
+            auto keep = batch.begin();
+            for (auto it=keep+1; it!=batch.end(); ++it)
+            {
+                if ( _comp(keep->key, it->key) )
+                    ++keep;
+                if (keep != it)
+                    *keep = std::move(*it);
+            }
+            batch.erase(keep + 1, batch.end());
+
+            // Only a merge replaces the snapshot, so this one stays put.
+            const Snapshot* old = _snapshot.load(std::memory_order_relaxed);
+            std::unique_ptr<Snapshot> next{ new Snapshot{_comp} };
+            next->_keys.reserve(old->size() + batch.size());
+            next->_values.reserve(old->size() + batch.size());
+
+            size_type i = 0;
+            const size_type n = old->size();
+            for (auto& op : batch)
+            {
+                for ( ; i<n && _comp(old->_keys[i], op.key); ++i)
+                {
+                    next->_keys.push_back( old->_keys[i] );
+                    next->_values.push_back( old->_values[i] );
+                }
+                if (i < n && !_comp(op.key, old->_keys[i]))
+                    ++i;
+                if (op.erase)
+                    continue;
+                next->_keys.push_back( std::move(op.key) );
+                next->_values.push_back( std::move(op.value) );
+            }
+            for ( ; i<n; ++i)
+            {
+                next->_keys.push_back( old->_keys[i] );
+                next->_values.push_back( old->_values[i] );
+            }
+            _snapshot.store(next.release(), std::memory_order_release);
+            // Old snapshots are as big as the map, so don't let them pile up
+            // waiting for the retire threshold.
+            EpochDomain::instance().retire(const_cast<Snapshot*>(old));
+            EpochDomain::instance().collect();
+        }
+
+        const size_type _batch_size;
+        const Compare _comp;
+
+        std::atomic<const Snapshot*> _snapshot;
+        static_assert(std::atomic<const Snapshot*>::is_always_lock_free,
+                "SafeFlatMap's lookups rely on a lock-free snapshot pointer");
+
+        std::vector<PendingOp> _pending;
+        mutable std::mutex _pending_mutex;
+        std::mutex _merge_mutex;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_FLAT_MAP_H
@@ -0,0 +1,208 @@
+#ifndef SAFE_GROUP_H
+#define SAFE_GROUP_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "access_word.h"
+#include "allocators.h"
+#include "column_span.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// Several arrays, of element types Ts... and independent sizes, that are
+// always used together and so share one synchronization domain.  All of
+// them live in a single slab allocation (each starting on a cache line), and
+// one AccessWord guards the lot: read() or write() takes one session that
+// covers every array, where separate SafeArrays would need one acquisition,
+// and one AccessCtr, condition variable and mutex, apiece.
+//
+//     sa::SafeGroup<int, double> group{100, 20};
+//     {
+//         auto session = group.write();
+//         auto [ids, weights] = session.all();
+//         ...
+//     }
+template <typename... Ts>
+class SafeGroup
+{
+    static_assert(sizeof...(Ts) > 0, "SafeGroup needs at least one array");
+
+    public:
+        typedef std::size_t size_type;
+        typedef AccessWord::MODE MODE;
+
+        static constexpr std::size_t NUM_ARRAYS = sizeof...(Ts);
+
+        template <std::size_t I>
+        using element_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+        // One read or write session over every array in the group, handing
+        // out ColumnSpans that share its hold, so an array's elements stay
+        // guarded for as long as its span is alive, and the session is taken
+        // once however many spans there are.  Like the hold, the session
+        // and its spans belong to the thread that took it.
+        template <bool Const>
+        class Session
+        {
+            public:
+                template <std::size_t I>
+                using span_type = ColumnSpan<std::conditional_t<Const,
+                      const element_type<I>, element_type<I>>>;
+
+                Session(const SafeGroup& group, MODE mode)
+                    : _hold{ std::make_shared<const AccessHold>(
+                            group._access_word, mode) },
+                    _group{group}
+                {}
+
+                template <std::size_t I>
+                span_type<I> get() const
+                {
+                    return span_type<I>{ _group.template _data<I>(),
+                        _group._sizes[I], _hold };
+                }
+                // Every array's span, for structured bindings.
+                auto all() const
+                {
+                    return _all(std::index_sequence_for<Ts...>{});
+                }
+
+                MODE mode() const { return _hold->mode(); }
+
+            private:
+                template <std::size_t... Is>
+                auto _all(std::index_sequence<Is...>) const
+                {
+                    return std::tuple{ get<Is>()... };
+                }
+
+                std::shared_ptr<const AccessHold> _hold;
+                const SafeGroup& _group;
+        };
+
+        typedef Session<true> ReadSession;
+        typedef Session<false> WriteSession;
+
+        // One size per array.  Elements are default-initialized, as for
+        // SafeArray.
+        template <std::convertible_to<size_type>... Sizes>
+            requires (sizeof...(Sizes) == NUM_ARRAYS)
+        explicit SafeGroup(Sizes... sizes)
+            : _sizes{ (size_type)sizes... }
+        {
+            FUNC_LOGGING();
+            size_type offset = 0;
+            size_type i = 0;
+            ((_offsets[i] = offset = detail::round_up(offset, ALIGN),
+              offset += _sizes[i] * sizeof(Ts), ++i), ...);
+            _bytes = std::max<size_type>(
+                    detail::round_up(offset, CACHE_LINE_SIZE), ALIGN);
+            _slab = static_cast<std::byte*>(
+                    ::operator new(_bytes, std::align_val_t{ALIGN}) );
+            try
+            {
+                _construct(std::index_sequence_for<Ts...>{});
+            }
+            catch (...)
+            {
+                ::operator delete(_slab, std::align_val_t{ALIGN});
+                throw;
+            }
+        }
+
+        SafeGroup(const SafeGroup&) = delete;
+        SafeGroup& operator=(const SafeGroup&) = delete;
+
+        ~SafeGroup()
+        {
+            FUNC_LOGGING();
+            _destroy_first(NUM_ARRAYS, std::index_sequence_for<Ts...>{});
+            ::operator delete(_slab, std::align_val_t{ALIGN});
+        }
+
+        template <std::size_t I>
+        size_type size() const { return _sizes[I]; }
+        // Bytes in the slab, padding included.
+        size_type get_slab_size() const { return _bytes; }
+
+        ReadSession read() const
+        {
+            FUNC_LOGGING();
+            return ReadSession{*this, MODE::READ};
+        }
+        WriteSession write()
+        {
+            FUNC_LOGGING();
+            return WriteSession{*this, MODE::READ_WRITE};
+        }
+
+        // Readers across all threads; writers for the calling thread.
+        int get_writer_ct() const { return _access_word.get_writer_ct(); }
+        int get_reader_ct() const { return _access_word.get_reader_ct(); }
+
+    private:
+        static constexpr size_type ALIGN
+            = std::max({ CACHE_LINE_SIZE, alignof(Ts)... });
+
+        template <std::size_t I>
+        element_type<I>* _data() const
+        {
+            return std::launder(
+                    reinterpret_cast<element_type<I>*>(_slab + _offsets[I]) );
+        }
+
+        // Constructs the arrays in order; if one throws, destroys those
+        // already built.
+        template <std::size_t... Is>
+        void _construct(std::index_sequence<Is...>)
+        {
+            std::size_t built = 0;
+            try
+            {
+                ((std::uninitialized_default_construct_n(
+                    reinterpret_cast<element_type<Is>*>(_slab + _offsets[Is]),
+                    _sizes[Is]), ++built), ...);
+            }
+            catch (...)
+            {
+                _destroy_first(built, std::index_sequence_for<Ts...>{});
+                throw;
+            }
+        }
+        template <std::size_t... Is>
+        void _destroy_first(std::size_t n, std::index_sequence<Is...>)
+        {
+            ((Is < n ? (void)std::destroy_n(_data<Is>(), _sizes[Is])
+              : (void)0), ...);
+        }
+
+        const std::array<size_type, NUM_ARRAYS> _sizes;
+        std::array<size_type, NUM_ARRAYS> _offsets{};
+        size_type _bytes{0};
+        std::byte* _slab{nullptr};
+        mutable AccessWord _access_word;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_GROUP_H
@@ -0,0 +1,262 @@
+#ifndef SAFE_RING_BUFFER_H
+#define SAFE_RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// A fixed-capacity ring of the most recent samples.  Any number of writers
+// push() concurrently; each claims a sequence number with one atomic
+// increment and then fills its own slot.  Readers copy out windows of the
+// ring without ever blocking a writer.
+//
+// Each slot carries its own sequence word, used as a seqlock: odd while the
+// slot is being written, 2*(seq+1) once sample 'seq' is complete.  A reader
+// checks the word before and after copying, so a sample that was overwritten
+// mid-copy is detected and never returned torn.  The payload itself is
+// stored as relaxed atomic words, which keeps the racing copy well defined.
+template <typename T>
+class SafeRingBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+            "SafeRingBuffer copies samples bytewise under a seqlock");
+
+    public:
+        typedef int size_type;
+        typedef T value_type;
+        typedef std::uint64_t sequence_type;
+        typedef std::chrono::steady_clock clock_type;
+
+        // The samples appended to 'out' by a copy are exactly the consecutive
+        // run [first, next).  If first is later than what was asked for, the
+        // samples in between had already been overwritten.  Pass next back
+        // in as 'since' to continue where this copy stopped.
+        struct CopyResult
+        {
+            sequence_type first;
+            sequence_type next;
+        };
+
+        SafeRingBuffer(size_type capacity)
+            : _capacity{ std::bit_ceil((std::uint64_t)std::max(capacity, 1)) },
+            _mask{_capacity - 1},
+            _slots{ new Slot[_capacity] },
+            _head{0}
+        {
+            FUNC_LOGGING();
+        }
+
+        SafeRingBuffer(const SafeRingBuffer&) = delete;
+        SafeRingBuffer& operator=(const SafeRingBuffer&) = delete;
+
+        ~SafeRingBuffer()
+        {
+            FUNC_LOGGING();
+            delete[] _slots;
+        }
+
+        // Capacity is rounded up to a power of two.
+        size_type capacity() const { return _capacity; }
+        size_type size() const
+        {
+            return std::min(_head.load(std::memory_order_acquire), _capacity);
+        }
+        // The sequence number the next push() will get.
+        sequence_type next_sequence() const
+        {
+            return _head.load(std::memory_order_acquire);
+        }
+        // The oldest sequence number that may still be in the ring.
+        sequence_type oldest_sequence() const
+        {
+            return _oldest(_head.load(std::memory_order_acquire));
+        }
+
+        sequence_type push(const T& value)
+        {
+            return push(value, clock_type::now());
+        }
+        sequence_type push(const T& value, clock_type::time_point stamp)
+        {
+            const sequence_type seq
+                = _head.fetch_add(1, std::memory_order_relaxed);
+            Slot& slot = _slots[seq & _mask];
+
+            // A writer that has lapped a slower one waits for it to finish
+            // with this slot; otherwise this never spins.
+            const sequence_type prior
+                = (seq < _capacity) ? 0 : _complete(seq - _capacity);
+            while (slot.seq.load(std::memory_order_acquire) != prior)
+                std::this_thread::yield();
+
+            slot.seq.store(_complete(seq) - 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.stamp.store(stamp.time_since_epoch().count(),
+                    std::memory_order_relaxed);
+            _store(slot, value);
+            slot.seq.store(_complete(seq), std::memory_order_release);
+            return seq;
+        }
+
+        // Read a single sample.  False if it is not yet complete or has
+        // already been overwritten.
+        bool try_get(sequence_type seq, T& value) const
+        {
+            clock_type::rep stamp;
+            return _read(seq, value, stamp) == READ_STATUS::OK;
+        }
+
+        // Append everything from 'since' up to the newest complete sample.
+        CopyResult copy_since(sequence_type since, std::vector<T>& out) const
+        {
+            FUNC_LOGGING();
+            return _copy(since, out, clock_type::time_point::min());
+        }
+        // Append the newest n samples (fewer if the ring holds fewer).
+        CopyResult copy_last(size_type n, std::vector<T>& out) const
+        {
+            FUNC_LOGGING();
+            const sequence_type head = _head.load(std::memory_order_acquire);
+            const sequence_type n_seq = std::max(n, 0);
+            const sequence_type since = (head > n_seq) ? head - n_seq : 0;
+            return _copy(since, out, clock_type::time_point::min());
+        }
+        // Append samples stamped no earlier than now - window.
+        template <typename Rep, typename Period>
+        CopyResult copy_window(std::chrono::duration<Rep, Period> window,
+                std::vector<T>& out) const
+        {
+            FUNC_LOGGING();
+            const auto cutoff = clock_type::now()
+                - std::chrono::duration_cast<clock_type::duration>(window);
+            return _copy(0, out, cutoff);
+        }
+
+    private:
+        static constexpr int NUM_WORDS
+            = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+        // A lapped reader starts over from the new oldest sample this many
+        // times before settling for what it has.
+        static constexpr int MAX_RESTARTS = 4;
+
+        enum class READ_STATUS
+        {
+            OK,
+            NOT_READY,
+            OVERWRITTEN
+        };
+
+        struct Slot
+        {
+            std::atomic<sequence_type> seq{0};
+            std::atomic<clock_type::rep> stamp{0};
+            std::atomic<std::uint64_t> words[NUM_WORDS];
+        };
+
+        static sequence_type _complete(sequence_type seq)
+        {
+            return 2*(seq + 1);
+        }
+        sequence_type _oldest(sequence_type head) const
+        {
+            return (head > _capacity) ? head - _capacity : 0;
+        }
+
+        static void _store(Slot& slot, const T& value)
+        {
+            std::uint64_t words[NUM_WORDS] = {};
+            std::memcpy(words, &value, sizeof(T));
+            for (int i=0; i<NUM_WORDS; ++i)
+                slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        READ_STATUS _read(sequence_type seq, T& value,
+                clock_type::rep& stamp) const
+        {
+            const Slot& slot = _slots[seq & _mask];
+            const sequence_type before
+                = slot.seq.load(std::memory_order_acquire);
+            if (before != _complete(seq))
+                return (before < _complete(seq)) ? READ_STATUS::NOT_READY
+                    : READ_STATUS::OVERWRITTEN;
+
+            std::uint64_t words[NUM_WORDS];
+            for (int i=0; i<NUM_WORDS; ++i)
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            stamp = slot.stamp.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != before)
+                return READ_STATUS::OVERWRITTEN;
+
+            std::memcpy(&value, words, sizeof(T));
+            return READ_STATUS::OK;
+        }
+
+        CopyResult _copy(sequence_type since, std::vector<T>& out,
+                clock_type::time_point cutoff) const
+        {
+            const std::size_t base = out.size();
+            sequence_type head = _head.load(std::memory_order_acquire);
+            sequence_type first = std::max(since, _oldest(head));
+            sequence_type seq = first;
+            int restarts = 0;
+            T value;
+            clock_type::rep stamp;
+            while (seq < head)
+            {
+                switch ( _read(seq, value, stamp) )
+                {
+                    case READ_STATUS::OK:
+                        if (stamp < cutoff.time_since_epoch().count()
+                                && out.size() == base)
+                            first = seq + 1;
+                        else
+                            out.push_back(value);
+                        ++seq;
+                        break;
+                    case READ_STATUS::NOT_READY:
+                        // A writer is still filling this slot; everything we
+                        // have so far is consecutive, so stop here.
+                        return CopyResult{first, seq};
+                    case READ_STATUS::OVERWRITTEN:
+                        if (++restarts > MAX_RESTARTS)
+                            return CopyResult{first, seq};
+                        out.resize(base);
+                        head = _head.load(std::memory_order_acquire);
+                        first = seq = std::max(seq + 1, _oldest(head));
+                        break;
+                }
+            }
+            return CopyResult{first, seq};
+        }
+
+        const sequence_type _capacity;
+        const sequence_type _mask;
+        Slot* _slots;
+        alignas(64) std::atomic<sequence_type> _head;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_RING_BUFFER_H
@@ -0,0 +1,498 @@
+#ifndef SAFE_SKIP_LIST_MAP_H
+#define SAFE_SKIP_LIST_MAP_H
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "epoch.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// An ordered map for heavy concurrent insert/erase.  This is the 'lazy'
+// skip list of Herlihy and Shavit: find() and contains() take no locks at
+// all, and insert()/erase() lock only the handful of nodes they relink, so
+// writers to different parts of the key space do not serialize.  Unlinked
+// nodes are handed to the EpochDomain and freed once no reader can still be
+// walking over them.
+//
+// Range scans come in two flavours, chosen when the map is constructed:
+//     RANGE_MODE::WEAK      scans run alongside writers.  A scan sees every
+//                           key that was present for its whole duration, and
+//                           may or may not see keys inserted or erased while
+//                           it runs.  Keys always come out in order.
+//     RANGE_MODE::SNAPSHOT  scans exclude writers for their lifetime, in the
+//                           spirit of SafeArray: many scans at once, or many
+//                           writers at once, but not both.  A thread must not
+//                           write while it holds a scan.
+// Values are immutable once inserted; to change one, erase and re-insert.
+template <typename K, typename V, typename Compare=std::less<K>>
+class SafeSkipListMap
+{
+    public:
+        class Range;
+
+        typedef long size_type;
+        typedef K key_type;
+        typedef V mapped_type;
+        typedef std::pair<const K, V> value_type;
+
+        enum class RANGE_MODE
+        {
+            WEAK,
+            SNAPSHOT
+        };
+
+    private:
+        static constexpr int MAX_LEVEL = 24;
+
+        struct Node
+        {
+            Node(int top_level)
+                : top{top_level},
+                next{ new std::atomic<Node*>[top_level+1] }
+            {
+                for (int i=0; i<=top; ++i)
+                    next[i].store(nullptr, std::memory_order_relaxed);
+            }
+            Node(const K& key, const V& value, int top_level)
+                : Node(top_level)
+            {
+                kv.emplace(key, value);
+            }
+            ~Node() { delete[] next; }
+
+            const K& key() const { return kv->first; }
+
+            std::optional<value_type> kv;   // empty only for the head
+            const int top;
+            std::atomic<Node*>* next;
+            std::atomic<bool> marked{false};
+            std::atomic<bool> fully_linked{false};
+            std::mutex mutex;
+        };
+
+        // Writers share the gate with each other, scans share it with each
+        // other, and the two groups exclude one another.  Only used in
+        // RANGE_MODE::SNAPSHOT, so WEAK writers pay nothing for it.
+        class ScanGate
+        {
+            public:
+                void writer_enter()
+                {
+                    for (;;)
+                    {
+                        for (int s = _scanners.load(); s != 0;
+                                s = _scanners.load())
+                            _scanners.wait(s);
+                        _writers.fetch_add(1);
+                        if (_scanners.load() == 0)
+                            return;
+                        writer_exit();
+                    }
+                }
+                void writer_exit()
+                {
+                    if (_writers.fetch_sub(1) == 1)
+                        _writers.notify_all();
+                }
+                void scanner_enter()
+                {
+                    _scanners.fetch_add(1);
+                    for (int w = _writers.load(); w != 0; w = _writers.load())
+                        _writers.wait(w);
+                }
+                void scanner_exit()
+                {
+                    if (_scanners.fetch_sub(1) == 1)
+                        _scanners.notify_all();
+                }
+
+            private:
+                std::atomic<int> _writers{0};
+                std::atomic<int> _scanners{0};
+        };
+
+        class WriteScope
+        {
+            public:
+                WriteScope(SafeSkipListMap& map)
+                    : _gate{ map._range_mode == RANGE_MODE::SNAPSHOT
+                        ? &map._gate : nullptr }
+                {
+                    if (_gate)
+                        _gate->writer_enter();
+                }
+                WriteScope(const WriteScope&) = delete;
+                ~WriteScope()
+                {
+                    if (_gate)
+                        _gate->writer_exit();
+                }
+            private:
+                ScanGate* _gate;
+        };
+
+    public:
+        // An ordered scan of [lo, hi).  The Range pins the epoch, so the
+        // nodes it walks stay valid until it is destroyed; destroy it on the
+        // thread that created it, and don't keep it longer than needed, as it
+        // holds back reclamation for the whole process.
+        class Range
+        {
+            public:
+                class Iterator
+                {
+                    public:
+                        typedef Iterator self_type;
+                        typedef SafeSkipListMap::value_type value_type;
+                        typedef const value_type& reference;
+                        typedef const value_type* pointer;
+                        typedef std::forward_iterator_tag iterator_category;
+                        typedef long difference_type;
+
+                        Iterator(const Range* range, Node* node)
+                            : _range{range}, _node{node}
+                        {}
+                        self_type operator++(int)
+                        {
+                            self_type iter = *this;
+                            ++*this;
+                            return iter;
+                        }
+                        self_type& operator++()
+                        {
+                            _node = _range->_skip(
+                                    _node->next[0].load(std::memory_order_acquire) );
+                            return *this;
+                        }
+                        reference operator*() const { return *_node->kv; }
+                        pointer operator->() const { return &*_node->kv; }
+                        bool operator==(const self_type& rhs) const
+                        { return _node == rhs._node; }
+                        bool operator!=(const self_type& rhs) const
+                        { return !(*this == rhs); }
+
+                    private:
+                        const Range* _range;
+                        Node* _node;
+                };
+
+                Range(const Range&) = delete;
+                Range& operator=(const Range&) = delete;
+                ~Range()
+                {
+                    if (_gate)
+                        _gate->scanner_exit();
+                }
+
+                Iterator begin() const { return Iterator{this, _first}; }
+                Iterator end() const { return Iterator{this, nullptr}; }
+
+            private:
+                friend class SafeSkipListMap;
+                Range(const SafeSkipListMap& map, std::optional<K> lo,
+                        std::optional<K> hi)
+                    : _map{map},
+                    _gate{ map._range_mode == RANGE_MODE::SNAPSHOT
+                        ? &map._gate : nullptr },
+                    _hi{std::move(hi)},
+                    _first{nullptr},
+                    _guard{ EpochDomain::instance() }
+                {
+                    if (_gate)
+                        _gate->scanner_enter();
+                    Node* node = lo ? _map._lower_bound(*lo)
+                        : _map._head->next[0].load(std::memory_order_acquire);
+                    _first = _skip(node);
+                }
+
+                // Step past nodes that are mid-insert or mid-erase, and stop
+                // at the upper bound.
+                Node* _skip(Node* node) const
+                {
+                    while (node && ( !node->fully_linked.load()
+                                || node->marked.load() ))
+                        node = node->next[0].load(std::memory_order_acquire);
+                    if (node && _hi && !_map._comp(node->key(), *_hi))
+                        return nullptr;
+                    return node;
+                }
+
+                const SafeSkipListMap& _map;
+                ScanGate* _gate;
+                std::optional<K> _hi;
+                Node* _first;
+                EpochDomain::Guard _guard;
+        };
+
+        SafeSkipListMap(RANGE_MODE range_mode=RANGE_MODE::WEAK,
+                const Compare& comp=Compare())
+            : _range_mode{range_mode},
+            _comp{comp},
+            _head{ new Node(MAX_LEVEL-1) },
+            _size{0}
+        {
+            FUNC_LOGGING();
+            _head->fully_linked = true;
+        }
+
+        SafeSkipListMap(const SafeSkipListMap&) = delete;
+        SafeSkipListMap& operator=(const SafeSkipListMap&) = delete;
+
+        // No other thread may be using the map; nodes already retired are
+        // left to the EpochDomain.
+        ~SafeSkipListMap()
+        {
+            FUNC_LOGGING();
+            Node* node = _head;
+            while (node)
+            {
+                Node* next = node->next[0].load(std::memory_order_relaxed);
+                delete node;
+                node = next;
+            }
+        }
+
+        size_type size() const { return _size.load(std::memory_order_relaxed); }
+        bool empty() const { return size() == 0; }
+        RANGE_MODE range_mode() const { return _range_mode; }
+
+        // Returns false (and leaves the map alone) if the key is present.
+        bool insert(const K& key, const V& value)
+        {
+            FUNC_LOGGING();
+            WriteScope write_scope{*this};
+            const int top_level = _random_level();
+            Node* preds[MAX_LEVEL];
+            Node* succs[MAX_LEVEL];
+            for (;;)
+            {
+                EpochDomain::Guard guard{ EpochDomain::instance() };
+                const int found = _find(key, preds, succs);
+                if (found != -1)
+                {
+                    Node* node = succs[found];
+                    if ( !node->marked.load() )
+                    {
+                        while ( !node->fully_linked.load() )
+                            std::this_thread::yield();
+                        return false;
+                    }
+                    continue;   // Being erased; try again once it's gone
+                }
+
+                LockedPreds locked;
+                if ( !locked.lock(preds, top_level, [&](int level){
+                            return !succs[level] || !succs[level]->marked.load();
+                            }, succs) )
+                    continue;
+
+                Node* node = new Node(key, value, top_level);
+                for (int level=0; level<=top_level; ++level)
+                    node->next[level].store(succs[level],
+                            std::memory_order_relaxed);
+                for (int level=0; level<=top_level; ++level)
+                    preds[level]->next[level].store(node,
+                            std::memory_order_release);
+                node->fully_linked.store(true);
+                _size.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        // Returns false if the key was not present.
+        bool erase(const K& key)
+        {
+            FUNC_LOGGING();
+            WriteScope write_scope{*this};
+            Node* victim = nullptr;
+            std::unique_lock<std::mutex> victim_lock;
+            int top_level = -1;
+            Node* preds[MAX_LEVEL];
+            Node* succs[MAX_LEVEL];
+            EpochDomain::Guard guard{ EpochDomain::instance() };
+            for (;;)
+            {
+                const int found = _find(key, preds, succs);
+                if (!victim)
+                {
+                    if (found == -1)
+                        return false;
+                    Node* node = succs[found];
+                    if ( !node->fully_linked.load() || node->top != found
+                            || node->marked.load() )
+                        return false;
+                    victim = node;
+                    top_level = victim->top;
+                    victim_lock = std::unique_lock<std::mutex>{victim->mutex};
+                    if ( victim->marked.load() )
+                        return false;
+                    victim->marked.store(true);
+                }
+
+                for (int level=0; level<=top_level; ++level)
+                    succs[level] = victim;
+                LockedPreds locked;
+                if ( !locked.lock(preds, top_level, [](int){ return true; },
+                            succs) )
+                    continue;
+
+                for (int level=top_level; level>=0; --level)
+                    preds[level]->next[level].store(
+                            victim->next[level].load(std::memory_order_relaxed),
+                            std::memory_order_release);
+                victim_lock.unlock();
+                _size.fetch_sub(1, std::memory_order_relaxed);
+                EpochDomain::instance().retire(victim);
+                return true;
+            }
+        }
+
+        bool contains(const K& key) const
+        {
+            EpochDomain::Guard guard{ EpochDomain::instance() };
+            return _find_node(key) != nullptr;
+        }
+
+        std::optional<V> find(const K& key) const
+        {
+            EpochDomain::Guard guard{ EpochDomain::instance() };
+            const Node* node = _find_node(key);
+            if (!node)
+                return std::nullopt;
+            return node->kv->second;
+        }
+
+        Range range(const K& lo, const K& hi) const
+        {
+            FUNC_LOGGING();
+            return Range{*this, lo, hi};
+        }
+        Range range_from(const K& lo) const
+        {
+            FUNC_LOGGING();
+            return Range{*this, lo, std::nullopt};
+        }
+        Range all() const
+        {
+            FUNC_LOGGING();
+            return Range{*this, std::nullopt, std::nullopt};
+        }
+
+    private:
+        // Locks the distinct predecessors on levels [0, top_level] (bottom
+        // up, i.e. in descending key order, which is what keeps insert and
+        // erase deadlock free) and checks none of them moved.
+        class LockedPreds
+        {
+            public:
+                template <typename SuccOk>
+                bool lock(Node** preds, int top_level, SuccOk succ_ok,
+                        Node** succs)
+                {
+                    Node* prev = nullptr;
+                    for (int level=0; level<=top_level; ++level)
+                    {
+                        Node* pred = preds[level];
+                        if (pred != prev)
+                        {
+                            _locks[_ct++] = std::unique_lock<std::mutex>{
+                                pred->mutex};
+                            prev = pred;
+                        }
+                        if ( pred->marked.load() || !succ_ok(level)
+                                || pred->next[level].load() != succs[level] )
+                            return false;
+                    }
+                    return true;
+                }
+            private:
+                std::unique_lock<std::mutex> _locks[MAX_LEVEL];
+                int _ct{0};
+        };
+
+        // Fills preds/succs on every level; returns the highest level on
+        // which 'key' was found, or -1.
+        int _find(const K& key, Node** preds, Node** succs) const
+        {
+            int found = -1;
+            Node* pred = _head;
+            for (int level=MAX_LEVEL-1; level>=0; --level)
+            {
+                Node* curr = pred->next[level].load(std::memory_order_acquire);
+                while (curr && _comp(curr->key(), key))
+                {
+                    pred = curr;
+                    curr = pred->next[level].load(std::memory_order_acquire);
+                }
+                if (found == -1 && curr && !_comp(key, curr->key()))
+                    found = level;
+                preds[level] = pred;
+                succs[level] = curr;
+            }
+            return found;
+        }
+
+        const Node* _find_node(const K& key) const
+        {
+            Node* preds[MAX_LEVEL];
+            Node* succs[MAX_LEVEL];
+            const int found = _find(key, preds, succs);
+            if (found == -1)
+                return nullptr;
+            const Node* node = succs[found];
+            if ( !node->fully_linked.load() || node->marked.load() )
+                return nullptr;
+            return node;
+        }
+
+        // First node with key >= 'key', possibly one being erased.
+        Node* _lower_bound(const K& key) const
+        {
+            Node* preds[MAX_LEVEL];
+            Node* succs[MAX_LEVEL];
+            _find(key, preds, succs);
+            return succs[0];
+        }
+
+        // Geometric with p = 1/2, from a per-thread xorshift generator.
+        static int _random_level()
+        {
+            static thread_local std::uint64_t state
+                = std::hash<std::thread::id>{}(std::this_thread::get_id())
+                | 1;
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            const int level = std::countr_one(state);
+            return level < MAX_LEVEL ? level : MAX_LEVEL - 1;
+        }
+
+        const RANGE_MODE _range_mode;
+        const Compare _comp;
+        Node* const _head;
+        std::atomic<size_type> _size;
+        mutable ScanGate _gate;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SAFE_SKIP_LIST_MAP_H
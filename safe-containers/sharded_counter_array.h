@@ -0,0 +1,132 @@
+#ifndef SHARDED_COUNTER_ARRAY_H
+#define SHARDED_COUNTER_ARRAY_H
+
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "access_word.h"
+#include "allocators.h"
+#include "update_gate.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// An array of counters for when even SafeArray::fetch_add contends: many
+// threads hammering a few hot elements all bounce the same cache lines.
+// Each counter is kept as Shards partial sums, one per group of threads,
+// with each shard's counters contiguous and on cache lines of their own, so
+// add() only ever writes the calling thread's shard.  Reads merge the
+// shards.
+//
+// load() sums one counter's shards as they stand and may miss adds in
+// flight; snapshot() and reset() take a write session and close the update
+// gate, so they see every add either wholly done or not started.
+template <typename T=long, int Shards=16>
+    requires (std::integral<T> || std::floating_point<T>)
+class ShardedCounterArray
+{
+    static_assert(Shards > 0, "ShardedCounterArray needs at least one shard");
+
+    public:
+        typedef std::size_t size_type;
+        typedef T value_type;
+
+        explicit ShardedCounterArray(size_type size)
+            : _size{size},
+            _stride{ detail::round_up(size*sizeof(Counter), CACHE_LINE_SIZE)
+                / sizeof(Counter) },
+            _counters{ _allocator.allocate(_stride * Shards) }
+        {
+            FUNC_LOGGING();
+            for (size_type i=0; i<_stride*Shards; ++i)
+                ::new ((void*)(_counters+i)) Counter(T());
+        }
+
+        ShardedCounterArray(const ShardedCounterArray&) = delete;
+        ShardedCounterArray& operator=(const ShardedCounterArray&) = delete;
+
+        ~ShardedCounterArray()
+        {
+            FUNC_LOGGING();
+            std::destroy_n(_counters, _stride*Shards);
+            _allocator.deallocate(_counters, _stride*Shards);
+        }
+
+        size_type size() const { return _size; }
+
+        void add(size_type index, T delta=T(1))
+        {
+            assert(index < _size);
+            const UpdateGate::Pass pass{_gate};
+            _shard(_my_shard())[index].fetch_add(delta,
+                    std::memory_order_relaxed);
+        }
+
+        T load(size_type index) const
+        {
+            assert(index < _size);
+            T sum = T();
+            for (int s=0; s<Shards; ++s)
+                sum += _shard(s)[index].load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        std::vector<T> snapshot()
+        {
+            FUNC_LOGGING();
+            const AccessHold hold{_access_word, AccessWord::MODE::READ_WRITE};
+            const UpdateGate::Closed closed{_gate};
+            std::vector<T> sums(_size, T());
+            for (int s=0; s<Shards; ++s)
+                for (size_type i=0; i<_size; ++i)
+                    sums[i] += _shard(s)[i].load(std::memory_order_relaxed);
+            return sums;
+        }
+
+        void reset()
+        {
+            FUNC_LOGGING();
+            const AccessHold hold{_access_word, AccessWord::MODE::READ_WRITE};
+            const UpdateGate::Closed closed{_gate};
+            for (size_type i=0; i<_stride*Shards; ++i)
+                _counters[i].store(T(), std::memory_order_relaxed);
+        }
+
+    private:
+        typedef std::atomic<T> Counter;
+
+        Counter* _shard(int s) const { return _counters + s*_stride; }
+
+        static int _my_shard()
+        {
+            static std::atomic<int> next{0};
+            thread_local const int shard
+                = next.fetch_add(1, std::memory_order_relaxed) % Shards;
+            return shard;
+        }
+
+        const size_type _size;
+        const size_type _stride;    // Counters per shard, padded to a line
+        CacheAlignedAllocator<Counter> _allocator;
+        Counter* _counters;
+        UpdateGate _gate;
+        AccessWord _access_word;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SHARDED_COUNTER_ARRAY_H
@@ -0,0 +1,554 @@
+#ifndef SHARED_MEMORY_SAFE_ARRAY_H
+#define SHARED_MEMORY_SAFE_ARRAY_H
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "access_word.h"
+#include "allocators.h"
+#include "guarded_iterator.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// A SafeArray whose elements and synchronization state both live in a POSIX
+// shared memory segment, so the usual guarantee -- one thread with read/write
+// iterators, or any number with read iterators -- holds across every process
+// that opens the segment by name.
+//
+// AccessCtr can't be used here: it keys on std::thread::id and keeps its
+// counts in a heap unordered_map.  Instead the segment holds a robust,
+// process-shared pthread mutex and condition variable (futex-based on Linux)
+// and a fixed table of holders, one slot per (pid, tid) with that thread's
+// read and write counts.  If a process dies while holding the mutex the next
+// locker gets EOWNERDEAD and makes it consistent; if it dies mid-session its
+// slot is reaped once a waiter notices, via kill(pid, 0), that the pid is
+// gone.  Waiters poll for that every REAP_INTERVAL_MS.  kill() still finds a
+// dead holder that is an unreaped zombie, or whose pid has been reused, so
+// such a holder's slot stays until its parent reaps it or the new process
+// exits.  A process opening the segment waits up to CREATE_TIMEOUT_MS for its
+// creator to finish setting it up, and throws std::runtime_error if it
+// doesn't: a creator that died part way leaves a segment that must be
+// unlink()ed.
+//
+// T must be trivially copyable, and the segment is zero-filled on creation.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class SharedMemorySafeArray
+{
+    struct Segment;
+
+    public:
+        typedef AccessWord::MODE MODE;
+        typedef int size_type;
+        typedef T value_type;
+
+        static constexpr int MAX_HOLDERS = 128;
+        static constexpr long REAP_INTERVAL_MS = 100;
+        static constexpr long CREATE_TIMEOUT_MS = 1000;
+
+        // One hold on the shared segment's read or write session, taken on
+        // construction (and on copy) and released on destruction.
+        class Hold
+        {
+            public:
+                typedef SharedMemorySafeArray::MODE MODE;
+
+                Hold(Segment& segment, MODE mode)
+                    : _segment{&segment},
+                    _mode{mode},
+                    _tid{ std::this_thread::get_id() }
+                {
+                    _segment->acquire(_mode);
+                }
+                Hold(const Hold& rhs)
+                    : _segment{rhs._segment},
+                    _mode{rhs._mode},
+                    _tid{ std::this_thread::get_id() }
+                {
+                    assert( _tid == rhs._tid );
+                    _segment->acquire(_mode);
+                }
+                Hold& operator=(const Hold& rhs)
+                {
+                    if (this != &rhs)
+                    {
+                        Hold copy{rhs};
+                        std::swap(_segment, copy._segment);
+                        std::swap(_mode, copy._mode);
+                    }
+                    return *this;
+                }
+                ~Hold()
+                {
+                    assert( std::this_thread::get_id() == _tid );
+                    _segment->release(_mode);
+                }
+
+                MODE mode() const { return _mode; }
+                std::thread::id tid() const { return _tid; }
+
+            private:
+                Segment* _segment;
+                MODE _mode;
+                std::thread::id _tid;
+        };
+
+        typedef GuardedIterator<T, Hold> SafeIterator;
+        typedef GuardedIterator<const T, Hold> ConstSafeIterator;
+        typedef SafeIterator iterator;
+        typedef ConstSafeIterator const_iterator;
+
+        // Open the segment called 'name' (e.g. "/workers"), creating it with
+        // room for 'size' elements if it does not exist yet.  Throws
+        // std::runtime_error if it exists with a different size or layout,
+        // and std::invalid_argument if size is negative.
+        SharedMemorySafeArray(const std::string& name, size_type size)
+            : SharedMemorySafeArray(name, _checked_size(size), Open{})
+        {}
+        // Open an existing segment, taking its size from the segment header.
+        explicit SharedMemorySafeArray(const std::string& name)
+            : SharedMemorySafeArray(name, -1, Open{})
+        {}
+
+        SharedMemorySafeArray(const SharedMemorySafeArray&) = delete;
+        SharedMemorySafeArray& operator=(const SharedMemorySafeArray&)
+            = delete;
+
+        // Unmaps the segment; it persists until unlink()ed.
+        ~SharedMemorySafeArray()
+        {
+            FUNC_LOGGING();
+            munmap(_segment, _bytes);
+        }
+
+        // Remove the name; processes that have it open keep their mapping.
+        static void unlink(const std::string& name)
+        {
+            if (shm_unlink(name.c_str()) != 0 && errno != ENOENT)
+                throw std::system_error(errno, std::system_category(),
+                        "shm_unlink " + name);
+        }
+
+        size_type size() const { return _size; }
+        const std::string& name() const { return _name; }
+
+        const T& operator[](size_type index) const
+        {
+            assert(index < _size);
+            return _data[index];
+        }
+
+        ConstSafeIterator cbegin() const
+        {
+            FUNC_LOGGING();
+            return ConstSafeIterator{_data, *_segment, MODE::READ};
+        }
+        ConstSafeIterator cend() const
+        {
+            FUNC_LOGGING();
+            return ConstSafeIterator{_data+_size, *_segment, MODE::READ};
+        }
+        SafeIterator begin()
+        {
+            FUNC_LOGGING();
+            return SafeIterator{_data, *_segment, MODE::READ_WRITE};
+        }
+        SafeIterator end()
+        {
+            FUNC_LOGGING();
+            return SafeIterator{_data+_size, *_segment, MODE::READ_WRITE};
+        }
+
+        // Totals across every process.
+        int get_reader_ct() const
+        { return _segment->count(&Holder::reader_ct); }
+        int get_writer_ct() const
+        { return _segment->count(&Holder::writer_ct); }
+
+    private:
+        static constexpr std::uint32_t MAGIC = 0x53414d53; // "SAMS"
+        static constexpr std::uint32_t VERSION = 1;
+
+        struct Holder
+        {
+            pid_t pid;
+            pid_t tid;
+            int reader_ct;
+            int writer_ct;
+        };
+
+        // The segment header; the elements follow it, starting on a cache
+        // line.
+        struct Segment
+        {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint64_t elem_size;
+            std::uint64_t size;
+            // Set last by the creator, once everything above and below it is
+            // initialized.
+            std::atomic<std::uint32_t> ready;
+
+            pthread_mutex_t mutex;
+            pthread_cond_t cond_var;
+            Holder holders[MAX_HOLDERS];
+
+            void init(size_type n)
+            {
+                magic = MAGIC;
+                version = VERSION;
+                elem_size = sizeof(T);
+                size = n;
+
+                pthread_mutexattr_t mattr;
+                pthread_mutexattr_init(&mattr);
+                pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+                pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+                pthread_mutex_init(&mutex, &mattr);
+                pthread_mutexattr_destroy(&mattr);
+
+                pthread_condattr_t cattr;
+                pthread_condattr_init(&cattr);
+                pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+                pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+                pthread_cond_init(&cond_var, &cattr);
+                pthread_condattr_destroy(&cattr);
+
+                ready.store(1, std::memory_order_release);
+            }
+
+            void acquire(MODE mode)
+            {
+                FUNC_LOGGING();
+                const pid_t pid = getpid();
+                const pid_t tid = (pid_t)syscall(SYS_gettid);
+                lock();
+                Holder* self = find(pid, tid);
+                while (!may_acquire(mode, self))
+                {
+                    timespec deadline;
+                    clock_gettime(CLOCK_MONOTONIC, &deadline);
+                    deadline.tv_nsec += REAP_INTERVAL_MS * 1000000;
+                    deadline.tv_sec += deadline.tv_nsec / 1000000000;
+                    deadline.tv_nsec %= 1000000000;
+                    const int r = pthread_cond_timedwait(&cond_var, &mutex,
+                            &deadline);
+                    if (r == EOWNERDEAD)
+                        recover();
+                    else if (r == ETIMEDOUT)
+                        reap();
+                    else if (r != 0)
+                    {
+                        pthread_mutex_unlock(&mutex);
+                        fail(r, "pthread_cond_timedwait");
+                    }
+                    self = find(pid, tid);
+                }
+                if (!self)
+                    self = claim(pid, tid);
+                ++self->reader_ct;
+                if (mode == MODE::READ_WRITE)
+                    ++self->writer_ct;
+                pthread_mutex_unlock(&mutex);
+            }
+
+            // Called from ~Hold, so it reports errors on stderr rather than
+            // throw, and leaves the table as it is.
+            void release(MODE mode) noexcept
+            {
+                FUNC_LOGGING();
+                if (const int r = lock_or_error())
+                {
+                    report(r, "pthread_mutex_lock");
+                    return;
+                }
+                Holder* self = find(getpid(), (pid_t)syscall(SYS_gettid));
+                if (!self)
+                {
+                    // Reaped, or never claimed: nothing to release.
+                    pthread_mutex_unlock(&mutex);
+                    std::fprintf(stderr, "SharedMemorySafeArray: releasing a "
+                            "hold with no holder slot\n");
+                    return;
+                }
+                --self->reader_ct;
+                if (mode == MODE::READ_WRITE)
+                    --self->writer_ct;
+                if (self->reader_ct == 0 && self->writer_ct == 0)
+                    self->pid = 0;
+                pthread_mutex_unlock(&mutex);
+                pthread_cond_broadcast(&cond_var);
+            }
+
+            int count(int Holder::* field)
+            {
+                lock();
+                int total = 0;
+                for (const Holder& h : holders)
+                    if (h.pid != 0)
+                        total += h.*field;
+                pthread_mutex_unlock(&mutex);
+                return total;
+            }
+
+            // Same rule as AccessCtr: a writer excludes every other thread;
+            // readers only exclude other threads' writers.
+            bool may_acquire(MODE mode, const Holder* self) const
+            {
+                for (const Holder& h : holders)
+                {
+                    if (h.pid == 0 || &h == self)
+                        continue;
+                    if (h.writer_ct > 0
+                            || (mode == MODE::READ_WRITE && h.reader_ct > 0))
+                        return false;
+                }
+                return true;
+            }
+
+            Holder* find(pid_t pid, pid_t tid)
+            {
+                for (Holder& h : holders)
+                    if (h.pid == pid && h.tid == tid)
+                        return &h;
+                return nullptr;
+            }
+
+            Holder* claim(pid_t pid, pid_t tid)
+            {
+                for (Holder& h : holders)
+                    if (h.pid == 0)
+                    {
+                        // The slot is free until pid is set, so that goes
+                        // last (see recover()).
+                        h.tid = tid;
+                        h.reader_ct = 0;
+                        h.writer_ct = 0;
+                        std::atomic_signal_fence(std::memory_order_seq_cst);
+                        h.pid = pid;
+                        return &h;
+                    }
+                pthread_mutex_unlock(&mutex);
+                throw std::runtime_error("SharedMemorySafeArray: more than "
+                        + std::to_string(MAX_HOLDERS) + " holders");
+            }
+
+            void lock()
+            {
+                if (const int r = lock_or_error())
+                    fail(r, "pthread_mutex_lock");
+            }
+            // Returns 0 once the mutex is locked, else the error.
+            int lock_or_error() noexcept
+            {
+                const int r = pthread_mutex_lock(&mutex);
+                if (r == EOWNERDEAD)
+                {
+                    recover();
+                    return 0;
+                }
+                return r;
+            }
+
+            // The previous owner of the mutex died holding it.  The holder
+            // table is only ever changed a field at a time, and a slot is
+            // claimed by setting its pid last and freed by clearing it last,
+            // so whatever the owner was doing the table is still usable; drop
+            // the dead process's slots and carry on.
+            void recover()
+            {
+                pthread_mutex_consistent(&mutex);
+                reap();
+            }
+
+            // Free the slots of processes that have exited mid-session.
+            void reap()
+            {
+                bool reaped = false;
+                for (Holder& h : holders)
+                    if (h.pid != 0 && kill(h.pid, 0) != 0 && errno == ESRCH)
+                    {
+                        h.reader_ct = 0;
+                        h.writer_ct = 0;
+                        std::atomic_signal_fence(std::memory_order_seq_cst);
+                        h.pid = 0;
+                        reaped = true;
+                    }
+                if (reaped)
+                    pthread_cond_broadcast(&cond_var);
+            }
+
+            [[noreturn]] static void fail(int err, const char* what)
+            {
+                throw std::system_error(err, std::system_category(), what);
+            }
+            static void report(int err, const char* what) noexcept
+            {
+                std::fprintf(stderr, "SharedMemorySafeArray: %s: %s\n", what,
+                        std::strerror(err));
+            }
+        };
+
+        static constexpr std::size_t DATA_OFFSET
+            = (sizeof(Segment) + CACHE_LINE_SIZE - 1)
+            / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+        struct Open {};
+
+        static size_type _checked_size(size_type size)
+        {
+            if (size < 0)
+                throw std::invalid_argument("SharedMemorySafeArray: negative "
+                        "size");
+            return size;
+        }
+
+        // A negative size opens an existing segment only.
+        SharedMemorySafeArray(const std::string& name, size_type size, Open)
+            : _name{name},
+            _segment{nullptr},
+            _data{nullptr},
+            _size{0},
+            _bytes{0}
+        {
+            FUNC_LOGGING();
+            const auto deadline = std::chrono::steady_clock::now()
+                + std::chrono::milliseconds(CREATE_TIMEOUT_MS);
+            bool created = false;
+            int fd = -1;
+            if (size >= 0)
+            {
+                fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL
+                        | O_CLOEXEC, 0600);
+                created = (fd >= 0);
+                if (!created && errno != EEXIST)
+                    throw std::system_error(errno, std::system_category(),
+                            "shm_open " + _name);
+            }
+            if (!created)
+                fd = shm_open(_name.c_str(), O_RDWR | O_CLOEXEC, 0);
+            if (fd < 0)
+                throw std::system_error(errno, std::system_category(),
+                        "shm_open " + _name);
+
+            try
+            {
+                if (created)
+                {
+                    _bytes = DATA_OFFSET + (std::size_t)size*sizeof(T);
+                    if (ftruncate(fd, _bytes) != 0)
+                        throw std::system_error(errno, std::system_category(),
+                                "ftruncate " + _name);
+                }
+                else
+                    _bytes = _wait_for_size(fd, deadline);
+                void* p = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+                if (p == MAP_FAILED)
+                    throw std::system_error(errno, std::system_category(),
+                            "mmap " + _name);
+                close(fd);
+                fd = -1;
+                _segment = static_cast<Segment*>(p);
+                _data = reinterpret_cast<T*>(static_cast<char*>(p)
+                        + DATA_OFFSET);
+
+                if (created)
+                    _segment->init(size);
+                else
+                {
+                    while (!_segment->ready.load(std::memory_order_acquire))
+                        _wait_for_creator(deadline);
+                    if (_segment->magic != MAGIC
+                            || _segment->version != VERSION
+                            || _segment->elem_size != sizeof(T)
+                            || _segment->size > (std::uint64_t)
+                                std::numeric_limits<size_type>::max()
+                            || (size >= 0
+                                && _segment->size != (std::uint64_t)size)
+                            || DATA_OFFSET + _segment->size*sizeof(T) != _bytes)
+                        throw std::runtime_error(_name
+                                + ": segment layout does not match");
+                }
+                _size = (size_type)_segment->size;
+            }
+            catch (...)
+            {
+                if (fd >= 0)
+                    close(fd);
+                if (_segment)
+                    munmap(_segment, _bytes);
+                if (created)
+                    shm_unlink(_name.c_str());
+                throw;
+            }
+        }
+
+        // A segment that exists may not be sized yet; wait until its creator
+        // has ftruncate()d it.
+        std::size_t _wait_for_size(int fd,
+                std::chrono::steady_clock::time_point deadline) const
+        {
+            for (;;)
+            {
+                struct stat st;
+                if (fstat(fd, &st) != 0)
+                    throw std::system_error(errno, std::system_category(),
+                            "fstat " + _name);
+                if ((std::size_t)st.st_size >= DATA_OFFSET)
+                    return st.st_size;
+                _wait_for_creator(deadline);
+            }
+        }
+
+        void _wait_for_creator(std::chrono::steady_clock::time_point deadline)
+            const
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                throw std::runtime_error(_name + ": not set up within "
+                        + std::to_string(CREATE_TIMEOUT_MS)
+                        + "ms; its creator may have died");
+            std::this_thread::yield();
+        }
+
+        const std::string _name;
+        Segment* _segment;
+        T* _data;
+        size_type _size;
+        std::size_t _bytes;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SHARED_MEMORY_SAFE_ARRAY_H
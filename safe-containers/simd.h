@@ -0,0 +1,476 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+#include "safe_array.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define SA_SIMD_X86 1
+#endif
+// Kernels are inlined into a dispatcher compiled for the target level.
+#define SA_SIMD_INLINE __attribute__((always_inline))
+
+// Whole-array reductions and searches over arithmetic SafeArrays, each run
+// under one read session straight over the storage rather than element by
+// element through a SafeIterator:
+//
+//     sa::SafeArray<float> prices(1 << 20);
+//     ...
+//     const double total = sa::simd::sum(prices);
+//     const auto first_spike = sa::simd::find_first_above(prices, 100.f);
+//
+// The kernels are written once, over GCC vector extensions, and compiled
+// for AVX2 and AVX-512 as well as for the build's own target; the widest
+// the CPU supports is picked at run time.  Each also takes a std::span, for
+// storage already held some other way (the unsafe_span() of a ColumnSpan,
+// from SafeColumns or a SafeGroup session).
+namespace sa::simd
+{
+
+template <typename T>
+concept element = std::same_as<T, float> || std::same_as<T, double>
+    || std::same_as<T, std::int32_t> || std::same_as<T, std::int64_t>;
+
+// What sum() and dot() accumulate in: int64_t for the integer types, double
+// for the floating-point ones.  Integer overflow wraps; floating-point sums
+// are added in a different order from a sequential loop, so may differ from
+// one in the last bits.
+template <element T>
+using sum_type = std::conditional_t<std::integral<T>, std::int64_t, double>;
+
+enum class LEVEL
+{
+    SCALAR,
+    AVX2,
+    AVX512      // F, DQ, BW and VL, as on every AVX-512 CPU since Skylake-SP
+};
+
+// The widest level this CPU supports.
+inline LEVEL detected_level()
+{
+#ifdef SA_SIMD_X86
+    static const LEVEL level = []{
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")
+                && __builtin_cpu_supports("avx512dq")
+                && __builtin_cpu_supports("avx512bw")
+                && __builtin_cpu_supports("avx512vl"))
+            return LEVEL::AVX512;
+        return __builtin_cpu_supports("avx2") ? LEVEL::AVX2 : LEVEL::SCALAR;
+    }();
+    return level;
+#else
+    return LEVEL::SCALAR;
+#endif
+}
+
+namespace detail
+{
+
+inline std::atomic<LEVEL> max_level{LEVEL::AVX512};
+
+constexpr std::size_t UNROLL = 4;   // Independent accumulators per kernel
+
+// BYTES of T at a time.  No vector is passed or returned by value, as that
+// would be an ABI that differs between levels.
+template <typename T, std::size_t BYTES>
+struct Lanes
+{
+    static constexpr std::size_t N = BYTES / sizeof(T);
+    typedef T Vec __attribute__((vector_size(BYTES)));
+    // For loads from element storage, which is aligned only for T.
+    typedef T Unaligned __attribute__((vector_size(BYTES),
+                aligned(alignof(T)), may_alias));
+    typedef sum_type<T> Acc
+        __attribute__((vector_size(N * sizeof(sum_type<T>))));
+    typedef decltype(Vec{} > Vec{}) Mask;   // Lanes of all ones or zeros
+
+    SA_SIMD_INLINE static const Unaligned& at(const T* p)
+    {
+        return *reinterpret_cast<const Unaligned*>(p);
+    }
+    SA_SIMD_INLINE static bool any(const Mask& m)
+    {
+        std::uint64_t words[BYTES / 8];
+        std::memcpy(words, &m, BYTES);
+        std::uint64_t all = 0;
+        for (std::uint64_t w : words)
+            all |= w;
+        return all != 0;
+    }
+    template <typename V>
+    SA_SIMD_INLINE static auto total(const V& v)
+    {
+        std::remove_cvref_t<decltype(v[0])> t = 0;
+        for (std::size_t i=0; i<N; ++i)
+            t += v[i];
+        return t;
+    }
+};
+
+// Each kernel runs its vector loop for BYTES > 0, and finishes the elements
+// left over, or does them all for BYTES == 0, with a plain loop.
+
+template <std::size_t BYTES, typename T>
+SA_SIMD_INLINE inline sum_type<T> sum(const T* p, std::size_t n)
+{
+    sum_type<T> total = 0;
+    std::size_t i = 0;
+    if constexpr (BYTES > 0)
+    {
+        using L = Lanes<T, BYTES>;
+        using Acc = typename L::Acc;
+        Acc a0{}, a1{}, a2{}, a3{};
+        for ( ; i + UNROLL*L::N <= n; i += UNROLL*L::N)
+        {
+            a0 += __builtin_convertvector(L::at(p + i), Acc);
+            a1 += __builtin_convertvector(L::at(p + i + L::N), Acc);
+            a2 += __builtin_convertvector(L::at(p + i + 2*L::N), Acc);
+            a3 += __builtin_convertvector(L::at(p + i + 3*L::N), Acc);
+        }
+        total = L::total((a0 + a1) + (a2 + a3));
+    }
+    for ( ; i<n; ++i)
+        total += p[i];
+    return total;
+}
+
+// best = the lesser, or for MAX the greater, of best and x; lane by lane
+// for vectors.  NaNs are skipped, as by std::fmax: a NaN best gives way to
+// x, and a NaN x never replaces best, so a NaN doesn't stick in its lane.
+// (Two selects rather than one on or-ed masks, which AVX-512 scalarizes.)
+template <bool MAX, typename V, typename X>
+SA_SIMD_INLINE inline void keep(V& best, const X& x)
+{
+    const V v = x;
+    best = (best == best) ? best : v;
+    if constexpr (MAX)
+        best = (v > best) ? v : best;
+    else
+        best = (v < best) ? v : best;
+}
+
+// n > 0.
+template <std::size_t BYTES, bool MAX, typename T>
+SA_SIMD_INLINE inline T extreme(const T* p, std::size_t n)
+{
+    T best = p[0];
+    std::size_t i = 1;
+    if constexpr (BYTES > 0)
+    {
+        using L = Lanes<T, BYTES>;
+        if (n >= UNROLL*L::N)
+        {
+            typename L::Vec m0 = L::at(p), m1 = L::at(p + L::N),
+                m2 = L::at(p + 2*L::N), m3 = L::at(p + 3*L::N);
+            for (i=UNROLL*L::N; i + UNROLL*L::N <= n; i += UNROLL*L::N)
+            {
+                keep<MAX>(m0, L::at(p + i));
+                keep<MAX>(m1, L::at(p + i + L::N));
+                keep<MAX>(m2, L::at(p + i + 2*L::N));
+                keep<MAX>(m3, L::at(p + i + 3*L::N));
+            }
+            keep<MAX>(m0, m1);
+            keep<MAX>(m2, m3);
+            keep<MAX>(m0, m2);
+            for (std::size_t k=0; k<L::N; ++k)
+                keep<MAX>(best, m0[k]);
+        }
+    }
+    for ( ; i<n; ++i)
+        keep<MAX>(best, p[i]);
+    return best;
+}
+
+template <std::size_t BYTES, typename T>
+SA_SIMD_INLINE inline std::size_t count_above(const T* p, std::size_t n,
+        T threshold)
+{
+    std::size_t count = 0;
+    std::size_t i = 0;
+    if constexpr (BYTES > 0)
+    {
+        using L = Lanes<T, BYTES>;
+        const typename L::Vec t = typename L::Vec{} + threshold;
+        // Each lane counts down by one per hit.
+        typename L::Mask c0{}, c1{}, c2{}, c3{};
+        for ( ; i + UNROLL*L::N <= n; i += UNROLL*L::N)
+        {
+            c0 += L::at(p + i) > t;
+            c1 += L::at(p + i + L::N) > t;
+            c2 += L::at(p + i + 2*L::N) > t;
+            c3 += L::at(p + i + 3*L::N) > t;
+        }
+        count = -L::total((c0 + c1) + (c2 + c3));
+    }
+    for ( ; i<n; ++i)
+        count += p[i] > threshold;
+    return count;
+}
+
+// Returns n if there is none.
+template <std::size_t BYTES, typename T>
+SA_SIMD_INLINE inline std::size_t find_first_above(const T* p,
+        std::size_t n, T threshold)
+{
+    std::size_t i = 0;
+    if constexpr (BYTES > 0)
+    {
+        using L = Lanes<T, BYTES>;
+        const typename L::Vec t = typename L::Vec{} + threshold;
+        // Only tests whether a block has a hit, by whether its maximum is
+        // above threshold; the plain loop below then finds it.
+        for ( ; i + UNROLL*L::N <= n; i += UNROLL*L::N)
+        {
+            typename L::Vec m0 = L::at(p + i), m1 = L::at(p + i + L::N);
+            keep<true>(m0, L::at(p + i + 2*L::N));
+            keep<true>(m1, L::at(p + i + 3*L::N));
+            keep<true>(m0, m1);
+            if (L::any(m0 > t))
+                break;
+        }
+    }
+    for ( ; i<n; ++i)
+        if (p[i] > threshold)
+            return i;
+    return n;
+}
+
+template <std::size_t BYTES, typename T>
+SA_SIMD_INLINE inline sum_type<T> dot(const T* a, const T* b,
+        std::size_t n)
+{
+    sum_type<T> total = 0;
+    std::size_t i = 0;
+    if constexpr (BYTES > 0)
+    {
+        using L = Lanes<T, BYTES>;
+        using Acc = typename L::Acc;
+        Acc a0{}, a1{}, a2{}, a3{};
+        for ( ; i + UNROLL*L::N <= n; i += UNROLL*L::N)
+        {
+            a0 += __builtin_convertvector(L::at(a + i), Acc)
+                * __builtin_convertvector(L::at(b + i), Acc);
+            a1 += __builtin_convertvector(L::at(a + i + L::N), Acc)
+                * __builtin_convertvector(L::at(b + i + L::N), Acc);
+            a2 += __builtin_convertvector(L::at(a + i + 2*L::N), Acc)
+                * __builtin_convertvector(L::at(b + i + 2*L::N), Acc);
+            a3 += __builtin_convertvector(L::at(a + i + 3*L::N), Acc)
+                * __builtin_convertvector(L::at(b + i + 3*L::N), Acc);
+        }
+        total = L::total((a0 + a1) + (a2 + a3));
+    }
+    for ( ; i<n; ++i)
+        total += (sum_type<T>)a[i] * b[i];
+    return total;
+}
+
+#ifdef SA_SIMD_X86
+template <typename Kernel>
+[[gnu::target("avx2")]] auto run_avx2(const Kernel& kernel)
+{
+    return kernel.template operator()<32>();
+}
+template <typename Kernel>
+[[gnu::target("avx512f,avx512dq,avx512bw,avx512vl")]]
+auto run_avx512(const Kernel& kernel)
+{
+    return kernel.template operator()<64>();
+}
+#endif
+
+// Calls kernel.operator()<BYTES>(), compiled for the current level.
+template <typename Kernel>
+auto dispatch(const Kernel& kernel)
+{
+    const LEVEL level = std::min(detected_level(),
+            max_level.load(std::memory_order_relaxed));
+#ifdef SA_SIMD_X86
+    if (level == LEVEL::AVX512)
+        return run_avx512(kernel);
+    if (level == LEVEL::AVX2)
+        return run_avx2(kernel);
+#endif
+    (void)level;
+    return kernel.template operator()<0>();
+}
+
+} // detail
+
+// The level kernels run at: the detected level, capped by set_max_level().
+inline LEVEL get_level()
+{
+    return std::min(detected_level(),
+            detail::max_level.load(std::memory_order_relaxed));
+}
+// Caps the level for every thread, e.g. to compare against SCALAR.
+inline void set_max_level(LEVEL level)
+{
+    detail::max_level.store(level, std::memory_order_relaxed);
+}
+
+template <element T>
+sum_type<T> sum(std::span<const T> data)
+{
+    return detail::dispatch([data]<std::size_t BYTES>() SA_SIMD_INLINE {
+            return detail::sum<BYTES>(data.data(), data.size());
+            });
+}
+
+// Empty for an empty span.  NaNs are skipped; the result is NaN only if
+// every element is.
+template <element T>
+std::optional<T> min(std::span<const T> data)
+{
+    if (data.empty())
+        return std::nullopt;
+    return detail::dispatch([data]<std::size_t BYTES>() SA_SIMD_INLINE {
+            return detail::extreme<BYTES, false>(data.data(), data.size());
+            });
+}
+template <element T>
+std::optional<T> max(std::span<const T> data)
+{
+    if (data.empty())
+        return std::nullopt;
+    return detail::dispatch([data]<std::size_t BYTES>() SA_SIMD_INLINE {
+            return detail::extreme<BYTES, true>(data.data(), data.size());
+            });
+}
+
+// Elements strictly greater than threshold.
+template <element T>
+std::size_t count_above(std::span<const T> data,
+        std::type_identity_t<T> threshold)
+{
+    return detail::dispatch([=]<std::size_t BYTES>() SA_SIMD_INLINE {
+            return detail::count_above<BYTES>(data.data(), data.size(),
+                    threshold);
+            });
+}
+
+// The index of the first element strictly greater than threshold, if any.
+template <element T>
+std::optional<std::size_t> find_first_above(std::span<const T> data,
+        std::type_identity_t<T> threshold)
+{
+    const std::size_t i = detail::dispatch(
+            [=]<std::size_t BYTES>() SA_SIMD_INLINE {
+                return detail::find_first_above<BYTES>(data.data(),
+                        data.size(), threshold);
+            });
+    if (i == data.size())
+        return std::nullopt;
+    return i;
+}
+
+// a and b must be the same size; throws std::invalid_argument if they
+// aren't.
+template <element T>
+sum_type<T> dot(std::span<const T> a, std::span<const T> b)
+{
+    if (a.size() != b.size())
+        throw std::invalid_argument("sa::simd::dot(): operands differ in "
+                "size");
+    return detail::dispatch([a, b]<std::size_t BYTES>() SA_SIMD_INLINE {
+            return detail::dot<BYTES>(a.data(), b.data(), a.size());
+            });
+}
+
+// The same over a SafeArray, under one read session for the whole kernel.
+
+template <element T, typename Allocator>
+sum_type<T> sum(const SafeArray<T, Allocator>& array)
+{
+    FUNC_LOGGING();
+    auto hold = array.cbegin();
+    return sum(std::span<const T>(hold.operator->(), array.size()));
+}
+
+template <element T, typename Allocator>
+std::optional<T> min(const SafeArray<T, Allocator>& array)
+{
+    FUNC_LOGGING();
+    auto hold = array.cbegin();
+    return min(std::span<const T>(hold.operator->(), array.size()));
+}
+
+template <element T, typename Allocator>
+std::optional<T> max(const SafeArray<T, Allocator>& array)
+{
+    FUNC_LOGGING();
+    auto hold = array.cbegin();
+    return max(std::span<const T>(hold.operator->(), array.size()));
+}
+
+template <element T, typename Allocator>
+std::size_t count_above(const SafeArray<T, Allocator>& array,
+        std::type_identity_t<T> threshold)
+{
+    FUNC_LOGGING();
+    auto hold = array.cbegin();
+    return count_above(std::span<const T>(hold.operator->(), array.size()),
+            threshold);
+}
+
+template <element T, typename Allocator>
+std::optional<std::size_t> find_first_above(
+        const SafeArray<T, Allocator>& array,
+        std::type_identity_t<T> threshold)
+{
+    FUNC_LOGGING();
+    auto hold = array.cbegin();
+    return find_first_above(
+            std::span<const T>(hold.operator->(), array.size()), threshold);
+}
+
+// Holds both arrays for reading, in address order as swap_contents() does,
+// so two dot()s over the same pair can't deadlock behind a queued writer; a
+// and b may be the same array, which is held once.
+template <element T, typename A1, typename A2>
+sum_type<T> dot(const SafeArray<T, A1>& a, const SafeArray<T, A2>& b)
+{
+    FUNC_LOGGING();
+    if ((const void*)&a == (const void*)&b)
+    {
+        auto hold = a.cbegin();
+        const std::span<const T> both(hold.operator->(), a.size());
+        return dot(both, both);
+    }
+    if (std::less<const void*>{}(&a, &b))
+    {
+        auto hold_a = a.cbegin();
+        auto hold_b = b.cbegin();
+        return dot(std::span<const T>(hold_a.operator->(), a.size()),
+                std::span<const T>(hold_b.operator->(), b.size()));
+    }
+    auto hold_b = b.cbegin();
+    auto hold_a = a.cbegin();
+    return dot(std::span<const T>(hold_a.operator->(), a.size()),
+            std::span<const T>(hold_b.operator->(), b.size()));
+}
+
+} // sa::simd
+
+#undef SA_SIMD_X86
+#undef SA_SIMD_INLINE
+#undef FUNC_LOGGING
+
+#endif // SIMD_H
@@ -0,0 +1,163 @@
+#ifndef SNAPSHOT_IO_H
+#define SNAPSHOT_IO_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace sa
+{
+
+// The on-disk format written by SafeArray::save() and read back by
+// SafeArray::load(): this header, then count*elem_size bytes of raw element
+// data.  Snapshots are read and written at the descriptor's current offset,
+// so several can follow one another in a file or down a pipe.
+struct SnapshotHeader
+{
+    static constexpr std::uint32_t MAGIC = 0x4e534153; // "SASN"
+    static constexpr std::uint32_t VERSION = 1;
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t elem_size;
+    std::uint64_t count;
+    std::uint64_t reserved;
+};
+
+// DIRECT writes straight from the array's storage, holding a read session
+// for the whole write.  SNAPSHOT holds the read session only long enough to
+// memcpy the elements into a private buffer, then writes that, so readers
+// and writers of the array wait for a memcpy rather than for the disk.
+enum class SAVE_MODE
+{
+    DIRECT,
+    SNAPSHOT
+};
+
+namespace detail
+{
+    // Largest single read/write Linux will do; bigger requests come back
+    // short anyway.
+    constexpr std::size_t MAX_IO = 0x7ffff000;
+
+    // writev() until every byte of iov[0..n) is out, retrying on EINTR and
+    // picking up after short writes.  Modifies iov.
+    inline void write_all(int fd, iovec* iov, int n)
+    {
+        while (n > 0)
+        {
+            const ssize_t written = writev(fd, iov, n);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::system_category(),
+                        "writev");
+            }
+            std::size_t left = written;
+            while (n > 0 && left >= iov->iov_len)
+            {
+                left -= iov->iov_len;
+                ++iov;
+                --n;
+            }
+            if (n > 0)
+            {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+    }
+
+    // read() exactly 'bytes' bytes; a short file is an error.
+    inline void read_all(int fd, void* buf, std::size_t bytes)
+    {
+        char* p = static_cast<char*>(buf);
+        while (bytes > 0)
+        {
+            const ssize_t got = read(fd, p, std::min(bytes, MAX_IO));
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::system_category(),
+                        "read");
+            }
+            if (got == 0)
+                throw std::runtime_error("Snapshot is truncated");
+            p += got;
+            bytes -= got;
+        }
+    }
+
+    // Stream 'bytes' bytes from fd into buf in CHUNK-sized reads, asking the
+    // kernel to start fetching each chunk while the one before it is being
+    // copied in.  The hints are ignored (ESPIPE) on pipes and sockets.
+    inline void read_streaming(int fd, void* buf, std::size_t bytes)
+    {
+        constexpr std::size_t CHUNK = 8u << 20;
+        const off_t start = lseek(fd, 0, SEEK_CUR);
+        if (start >= 0)
+            posix_fadvise(fd, start, bytes, POSIX_FADV_SEQUENTIAL);
+        char* p = static_cast<char*>(buf);
+        for (std::size_t done=0; done<bytes; done+=CHUNK)
+        {
+            const std::size_t len = std::min(CHUNK, bytes - done);
+            if (start >= 0 && done + len < bytes)
+                posix_fadvise(fd, start + done + len,
+                        std::min(CHUNK, bytes - done - len),
+                        POSIX_FADV_WILLNEED);
+            read_all(fd, p + done, len);
+        }
+    }
+
+    template <typename T>
+    SnapshotHeader make_header(std::size_t count)
+    {
+        return SnapshotHeader{SnapshotHeader::MAGIC, SnapshotHeader::VERSION,
+            sizeof(T), count, 0};
+    }
+
+    // Reads and validates a header for elements of type T, returning the
+    // element count.
+    template <typename T>
+    std::uint64_t read_header(int fd)
+    {
+        SnapshotHeader header;
+        read_all(fd, &header, sizeof(header));
+        if (header.magic != SnapshotHeader::MAGIC)
+            throw std::runtime_error("Not a SafeArray snapshot");
+        if (header.version != SnapshotHeader::VERSION)
+            throw std::runtime_error("Unsupported snapshot version "
+                    + std::to_string(header.version));
+        if (header.elem_size != sizeof(T))
+            throw std::runtime_error("Snapshot element size "
+                    + std::to_string(header.elem_size) + " does not match "
+                    + std::to_string(sizeof(T)));
+        return header.count;
+    }
+
+    // Header and data in as few writev() calls as the kernel allows.
+    inline void write_snapshot(int fd, const SnapshotHeader& header,
+            const void* data, std::size_t bytes)
+    {
+        SnapshotHeader h = header;
+        iovec iov[2] = {
+            { &h, sizeof(h) },
+            { const_cast<void*>(data), bytes }
+        };
+        write_all(fd, iov, bytes ? 2 : 1);
+    }
+}
+
+} // sa
+
+#endif // SNAPSHOT_IO_H
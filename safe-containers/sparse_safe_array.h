@@ -0,0 +1,389 @@
+#ifndef SPARSE_SAFE_ARRAY_H
+#define SPARSE_SAFE_ARRAY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+#include "access_word.h"
+#include "allocators.h"
+#include "epoch.h"
+#include "../scopetracker.h"
+
+#ifdef DEBUG_ACCESS
+    #define FUNC_LOGGING() static const ScopeName scope_name{__func__}; \
+        ScopeTracker scope_tracker{scope_name}
+#else
+    #define FUNC_LOGGING() 0
+#endif
+
+namespace sa
+{
+
+// A SafeArray over a huge, sparsely populated index space.  The space is cut
+// into pages of PageSize elements that are only allocated when first written
+// (through at()); an absent page reads as default_value.  Memory use follows
+// the populated pages, not size().
+//
+// Pages are found through a two-level directory of atomic pointers, so a
+// lookup is two acquire loads and never takes a lock.  Lookups pin the
+// EpochDomain instead (see epoch.h), and release_default_pages() retires
+// what it unlinks there rather than freeing it, so a lookup racing with it
+// reads a page that is still allocated.  Iterators visit only
+// the populated pages, in index order, and report where they are with
+// index().  Sessions are those of sa::SafeArray -- one thread with read/write
+// iterators, or any number with read iterators -- kept in an AccessWord.
+template <typename T, std::size_t PageSize=1024>
+    requires std::copy_constructible<T>
+class SparseSafeArray
+{
+    static_assert(PageSize > 0, "PageSize must be positive");
+
+    public:
+        typedef std::size_t size_type;
+        typedef T value_type;
+        typedef AccessWord::MODE ITER_MODE;
+
+        static constexpr size_type PAGE_SIZE = PageSize;
+        static constexpr size_type LEAF_SIZE = 1024;    // Pages per leaf
+
+        template <typename Value>
+        class PageIterator
+        {
+            public:
+                typedef PageIterator self_type;
+                typedef std::remove_const_t<Value> value_type;
+                typedef Value& reference;
+                typedef Value* pointer;
+                typedef std::forward_iterator_tag iterator_category;
+                typedef std::ptrdiff_t difference_type;
+
+                PageIterator(const SparseSafeArray* array, size_type index,
+                        ITER_MODE iter_mode)
+                    : _hold{array->_access_word, iter_mode},
+                    _array{array},
+                    _index{ array->_next_populated(index) },
+                    _ptr{ _page_ptr() }
+                {}
+
+                self_type operator++(int)
+                {
+                    self_type iter = *this;
+                    ++*this;
+                    return iter;
+                }
+                self_type& operator++()
+                {
+                    assert( std::this_thread::get_id() == _hold.tid() );
+                    if (++_index % PageSize != 0)
+                        ++_ptr;
+                    else
+                    {
+                        _index = _array->_next_populated(_index);
+                        _ptr = _page_ptr();
+                    }
+                    return *this;
+                }
+                reference operator*() const
+                {
+                    assert( std::this_thread::get_id() == _hold.tid() );
+                    return *_ptr;
+                }
+                pointer operator->() const
+                {
+                    assert( std::this_thread::get_id() == _hold.tid() );
+                    return _ptr;
+                }
+                // The element's position in the whole index space.
+                size_type index() const { return _index; }
+
+                bool operator==(const self_type& rhs) const
+                { return _index == rhs._index; }
+                bool operator!=(const self_type& rhs) const
+                { return !(*this == rhs); }
+
+                ITER_MODE mode() const { return _hold.mode(); }
+
+            private:
+                pointer _page_ptr() const
+                {
+                    if (_index >= _array->_size)
+                        return nullptr;
+                    return _array->_page(_index / PageSize)
+                        + _index % PageSize;
+                }
+
+                AccessHold _hold;   // First, so it is held for the rest
+                const SparseSafeArray* _array;
+                size_type _index;
+                pointer _ptr;
+        };
+
+        typedef PageIterator<T> SafeIterator;
+        typedef PageIterator<const T> ConstSafeIterator;
+        typedef SafeIterator iterator;
+        typedef ConstSafeIterator const_iterator;
+
+        SparseSafeArray(size_type size, const T& default_value=T())
+            : _size{size},
+            _num_pages{ (size + PageSize - 1) / PageSize },
+            _num_leaves{ (_num_pages + LEAF_SIZE - 1) / LEAF_SIZE },
+            _leaves{ new std::atomic<Leaf*>[_num_leaves]() },
+            _default{default_value}
+        {}
+
+        SparseSafeArray(const SparseSafeArray&) = delete;
+        SparseSafeArray& operator=(const SparseSafeArray&) = delete;
+
+        ~SparseSafeArray()
+        {
+            FUNC_LOGGING();
+            for (size_type l=0; l<_num_leaves; ++l)
+            {
+                Leaf* leaf = _leaves[l].load(std::memory_order_relaxed);
+                if (!leaf)
+                    continue;
+                for (auto& page : leaf->pages)
+                    _free_page(page.load(std::memory_order_relaxed));
+                delete leaf;
+            }
+        }
+
+        size_type size() const { return _size; }
+        const T& default_value() const { return _default; }
+
+        // Read-only, like SafeArray's; absent pages give default_value().
+        // A copy, since the page may be released once the epoch is
+        // unpinned.
+        T operator[](size_type index) const
+        {
+            assert(index < _size);
+            const EpochDomain::Guard guard{ EpochDomain::instance() };
+            const T* page = _page(index / PageSize);
+            return page ? page[index % PageSize] : _default;
+        }
+
+        ConstSafeIterator cbegin() const
+        {
+            FUNC_LOGGING();
+            return ConstSafeIterator{this, 0, ITER_MODE::READ};
+        }
+        ConstSafeIterator cend() const
+        {
+            FUNC_LOGGING();
+            return ConstSafeIterator{this, _size, ITER_MODE::READ};
+        }
+        SafeIterator begin()
+        {
+            FUNC_LOGGING();
+            return SafeIterator{this, 0, ITER_MODE::READ_WRITE};
+        }
+        SafeIterator end()
+        {
+            FUNC_LOGGING();
+            return SafeIterator{this, _size, ITER_MODE::READ_WRITE};
+        }
+        // A read/write iterator at 'index', allocating its page (filled with
+        // default_value) if need be.  Incrementing it carries on through the
+        // populated pages.
+        SafeIterator at(size_type index)
+        {
+            FUNC_LOGGING();
+            assert(index < _size);
+            const AccessHold hold{_access_word, ITER_MODE::READ_WRITE};
+            _populate(index / PageSize);
+            return SafeIterator{this, index, ITER_MODE::READ_WRITE};
+        }
+
+        // Free every page whose elements all equal default_value(), taking a
+        // write session to do so.  Returns the number of pages freed.  Their
+        // memory is gone by the time it returns: after the session it waits
+        // out any lookups still reading them (see
+        // EpochDomain::synchronize()), so it must not be called by a thread
+        // that has the EpochDomain pinned, e.g. through a SafeSkipListMap
+        // iterator.  Nor by one holding an iterator on this array, which
+        // could be left pointing into a freed page: debug builds assert there
+        // is no write iterator, and a read iterator would deadlock.
+        size_type release_default_pages()
+            requires std::equality_comparable<T>
+        {
+            FUNC_LOGGING();
+            assert( _access_word.get_writer_ct() == 0 );
+            size_type freed;
+            {
+                const AccessHold hold{_access_word, ITER_MODE::READ_WRITE};
+                freed = _unlink_default_pages();
+            }
+            EpochDomain::instance().synchronize();
+            return freed;
+        }
+
+        size_type get_page_ct() const
+        {
+            return _page_ct.load(std::memory_order_relaxed);
+        }
+        // Bytes held by pages and directory, excluding the object itself.
+        size_type get_memory_usage() const
+        {
+            return get_page_ct() * PageSize * sizeof(T)
+                + _leaf_ct.load(std::memory_order_relaxed) * sizeof(Leaf)
+                + _num_leaves * sizeof(std::atomic<Leaf*>);
+        }
+
+        // As for sa::fixed::SafeArray: readers across all threads, writers
+        // for the calling thread.
+        int get_writer_ct() const { return _access_word.get_writer_ct(); }
+        int get_reader_ct() const { return _access_word.get_reader_ct(); }
+
+    private:
+        struct Leaf
+        {
+            std::atomic<T*> pages[LEAF_SIZE];
+        };
+
+        static constexpr std::align_val_t PAGE_ALIGN{
+            std::max(alignof(T), CACHE_LINE_SIZE) };
+
+        // Unlinks and retires the pages release_default_pages() frees, and
+        // any leaf left empty; under a write session.
+        size_type _unlink_default_pages()
+            requires std::equality_comparable<T>
+        {
+            size_type freed = 0;
+            for (size_type l=0; l<_num_leaves; ++l)
+            {
+                Leaf* leaf = _leaves[l].load(std::memory_order_relaxed);
+                if (!leaf)
+                    continue;
+                bool empty = true;
+                for (auto& slot : leaf->pages)
+                {
+                    T* page = slot.load(std::memory_order_relaxed);
+                    if (!page)
+                        continue;
+                    if (std::all_of(page, page + PageSize,
+                                [this](const T& t){ return t == _default; }))
+                    {
+                        slot.store(nullptr, std::memory_order_release);
+                        EpochDomain::instance().retire(page,
+                                [](void* p){ _free_page(static_cast<T*>(p)); });
+                        _page_ct.fetch_sub(1, std::memory_order_relaxed);
+                        ++freed;
+                    }
+                    else
+                        empty = false;
+                }
+                if (empty)
+                {
+                    _leaves[l].store(nullptr, std::memory_order_release);
+                    EpochDomain::instance().retire(leaf);
+                    _leaf_ct.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+            return freed;
+        }
+
+        T* _page(size_type p) const
+        {
+            const Leaf* leaf
+                = _leaves[p / LEAF_SIZE].load(std::memory_order_acquire);
+            return leaf
+                ? leaf->pages[p % LEAF_SIZE].load(std::memory_order_acquire)
+                : nullptr;
+        }
+
+        // Index of the first element at or after 'index' that is on a
+        // populated page, or _size.
+        size_type _next_populated(size_type index) const
+        {
+            if (index >= _size)
+                return _size;
+            if (_page(index / PageSize))
+                return index;
+            for (size_type p=index/PageSize+1; p<_num_pages; )
+            {
+                const Leaf* leaf
+                    = _leaves[p / LEAF_SIZE].load(std::memory_order_acquire);
+                if (!leaf)
+                {
+                    p = (p / LEAF_SIZE + 1) * LEAF_SIZE;
+                    continue;
+                }
+                if (leaf->pages[p % LEAF_SIZE].load(std::memory_order_acquire))
+                    return p * PageSize;
+                ++p;
+            }
+            return _size;
+        }
+
+        // Only called in a write session, but the directory is published
+        // with CAS all the same so lock-free readers see whole pages.
+        void _populate(size_type p)
+        {
+            std::atomic<Leaf*>& leaf_slot = _leaves[p / LEAF_SIZE];
+            Leaf* leaf = leaf_slot.load(std::memory_order_acquire);
+            if (!leaf)
+            {
+                Leaf* fresh = new Leaf{};
+                if (leaf_slot.compare_exchange_strong(leaf, fresh,
+                            std::memory_order_acq_rel))
+                {
+                    leaf = fresh;
+                    _leaf_ct.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                    delete fresh;
+            }
+            std::atomic<T*>& page_slot = leaf->pages[p % LEAF_SIZE];
+            T* page = page_slot.load(std::memory_order_acquire);
+            if (page)
+                return;
+            T* fresh = static_cast<T*>(
+                    ::operator new(PageSize*sizeof(T), PAGE_ALIGN) );
+            try
+            {
+                std::uninitialized_fill_n(fresh, PageSize, _default);
+            }
+            catch (...)
+            {
+                ::operator delete(fresh, PAGE_ALIGN);
+                throw;
+            }
+            if (page_slot.compare_exchange_strong(page, fresh,
+                        std::memory_order_acq_rel))
+                _page_ct.fetch_add(1, std::memory_order_relaxed);
+            else
+                _free_page(fresh);
+        }
+
+        static void _free_page(T* page)
+        {
+            if (!page)
+                return;
+            std::destroy_n(page, PageSize);
+            ::operator delete(page, PAGE_ALIGN);
+        }
+
+        const size_type _size;
+        const size_type _num_pages;
+        const size_type _num_leaves;
+        std::unique_ptr<std::atomic<Leaf*>[]> _leaves;
+        const T _default;
+
+        std::atomic<size_type> _page_ct{0};
+        std::atomic<size_type> _leaf_ct{0};
+        mutable AccessWord _access_word;
+};
+
+} // sa
+
+#undef FUNC_LOGGING
+
+#endif // SPARSE_SAFE_ARRAY_H
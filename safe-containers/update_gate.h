@@ -0,0 +1,114 @@
+#ifndef UPDATE_GATE_H
+#define UPDATE_GATE_H
+
+#include <atomic>
+#include <cstddef>
+
+#include "allocators.h"
+
+namespace sa
+{
+
+// Admits any number of concurrent atomic updaters until a closer shuts it,
+// then waits for those already inside to leave.  Updaters enter and leave
+// through one of STRIPES padded counters, picked per thread, so they don't
+// all contend on one cache line.  Closing is for whole-container operations
+// (snapshot, reset) that must see no update half-applied; only one thread
+// may close at a time, which callers ensure by holding a write session.
+class UpdateGate
+{
+    public:
+        static constexpr int STRIPES = 16;
+
+        UpdateGate() = default;
+        UpdateGate(const UpdateGate&) = delete;
+        UpdateGate& operator=(const UpdateGate&) = delete;
+
+        // Returns the stripe to hand back to leave().  Blocks while closed.
+        int enter()
+        {
+            const int stripe = _stripe();
+            std::atomic<int>& count = _stripes[stripe].count;
+            for (;;)
+            {
+                // seq_cst on both sides: either the closer sees our count or
+                // we see its flag.
+                count.fetch_add(1, std::memory_order_seq_cst);
+                if (!_closed.load(std::memory_order_seq_cst))
+                    return stripe;
+                leave(stripe);
+                _closed.wait(true, std::memory_order_acquire);
+            }
+        }
+        void leave(int stripe)
+        {
+            std::atomic<int>& count = _stripes[stripe].count;
+            if (count.fetch_sub(1, std::memory_order_seq_cst) == 1
+                    && _closed.load(std::memory_order_seq_cst))
+                count.notify_all();
+        }
+
+        // Stop new updaters and wait until the ones inside have left.
+        void close()
+        {
+            _closed.store(true, std::memory_order_seq_cst);
+            for (Stripe& stripe : _stripes)
+            {
+                int c;
+                while ((c = stripe.count.load(std::memory_order_seq_cst)) != 0)
+                    stripe.count.wait(c, std::memory_order_seq_cst);
+            }
+        }
+        void open()
+        {
+            _closed.store(false, std::memory_order_release);
+            _closed.notify_all();
+        }
+
+        // Passes through the gate for its lifetime.
+        class Pass
+        {
+            public:
+                Pass(UpdateGate& gate)
+                    : _gate{gate},
+                    _stripe{ gate.enter() }
+                {}
+                Pass(const Pass&) = delete;
+                ~Pass() { _gate.leave(_stripe); }
+            private:
+                UpdateGate& _gate;
+                const int _stripe;
+        };
+
+        // Closes the gate for its lifetime.
+        class Closed
+        {
+            public:
+                Closed(UpdateGate& gate) : _gate{gate} { _gate.close(); }
+                Closed(const Closed&) = delete;
+                ~Closed() { _gate.open(); }
+            private:
+                UpdateGate& _gate;
+        };
+
+    private:
+        struct alignas(CACHE_LINE_SIZE) Stripe
+        {
+            std::atomic<int> count{0};
+        };
+
+        static int _stripe()
+        {
+            static std::atomic<int> next{0};
+            thread_local const int stripe
+                = next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+            return stripe;
+        }
+
+        Stripe _stripes[STRIPES];
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> _closed{false};
+};
+
+} // sa
+
+#endif // UPDATE_GATE_H
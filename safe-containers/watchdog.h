@@ -0,0 +1,260 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace sa
+{
+
+// Finds the session that is blocking everyone.
+//
+// Containers attached to a watchdog (SafeArray::set_watchdog()) register
+// each hold when it opens and each wait that actually blocks, with its
+// thread, mode, start time, the container's name and the thread's current
+// Tag.  Registration is a claim on a preallocated slot; all the looking is
+// done by a background thread, which every 'interval' scans the slots for
+// holds older than hold_threshold and waits older than wait_threshold.  For
+// each container where it finds one it hasn't reported before, it calls the
+// callback with everything open on that container, oldest first.
+//
+// The watchdog must outlive the holds on containers attached to it.  When
+// all CAPACITY slots are taken, further holds and waits go untracked and
+// are counted by get_untracked_ct().
+class Watchdog
+{
+    public:
+        static constexpr int CAPACITY = 1024;
+
+        enum class ROLE : std::uint8_t
+        {
+            HOLDER,
+            WAITER
+        };
+
+        struct Entry
+        {
+            std::thread::id thread;
+            ROLE role;
+            bool writer;
+            const char* tag;                // Tag in effect, or ""
+            std::chrono::nanoseconds age;   // At the time of the sample
+        };
+
+        struct Report
+        {
+            const void* container;
+            const char* name;               // As given to set_watchdog()
+            std::vector<Entry> holders;
+            std::vector<Entry> waiters;
+        };
+
+        typedef std::function<void(const Report&)> Callback;
+
+        // Labels the holds and waits the calling thread opens during its
+        // lifetime; tags nest.  'tag' must outlive them.
+        class Tag
+        {
+            public:
+                explicit Tag(const char* tag)
+                    : _prev{_current}
+                {
+                    _current = tag;
+                }
+                Tag(const Tag&) = delete;
+                ~Tag() { _current = _prev; }
+
+                static const char* current() { return _current; }
+
+            private:
+                static inline thread_local const char* _current = "";
+                const char* const _prev;
+        };
+
+        Watchdog(std::chrono::nanoseconds hold_threshold,
+                std::chrono::nanoseconds wait_threshold, Callback callback,
+                std::chrono::milliseconds interval
+                    =std::chrono::milliseconds(100))
+            : _hold_threshold{hold_threshold},
+            _wait_threshold{wait_threshold},
+            _callback{std::move(callback)},
+            _interval{interval},
+            _reported(CAPACITY, 0),
+            _sampler{ [this](std::stop_token stop){ _run(stop); } }
+        {}
+
+        Watchdog(const Watchdog&) = delete;
+        Watchdog& operator=(const Watchdog&) = delete;
+
+        ~Watchdog()
+        {
+            _sampler.request_stop();
+            _wake.notify_all();
+        }
+
+        // Registers an open hold or a blocked wait on 'container', started
+        // at 'since' (steady_clock nanoseconds).  Returns the slot to pass
+        // to leave(), or -1 if none was free.
+        int enter(const void* container, const char* name, ROLE role,
+                bool writer, std::uint64_t since)
+        {
+            static std::atomic<int> next{0};
+            thread_local const int first
+                = next.fetch_add(1, std::memory_order_relaxed) % CAPACITY;
+            for (int i=0; i<CAPACITY; ++i)
+            {
+                const int s = (first + i) % CAPACITY;
+                Slot& slot = _slots[s];
+                std::uint64_t state = slot.state.load(
+                        std::memory_order_relaxed);
+                if (state % 4 != FREE || !slot.state.compare_exchange_strong(
+                            state, state + 1, std::memory_order_acquire))
+                    continue;
+                slot.container.store(container, std::memory_order_relaxed);
+                slot.name.store(name, std::memory_order_relaxed);
+                slot.tag.store(Tag::current(), std::memory_order_relaxed);
+                slot.thread.store(std::this_thread::get_id(),
+                        std::memory_order_relaxed);
+                slot.role.store(role, std::memory_order_relaxed);
+                slot.writer.store(writer, std::memory_order_relaxed);
+                slot.since.store(since, std::memory_order_relaxed);
+                slot.state.store(state + 2, std::memory_order_release);
+                return s;
+            }
+            _untracked.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        void leave(int s)
+        {
+            std::atomic<std::uint64_t>& state = _slots[s].state;
+            state.store(state.load(std::memory_order_relaxed) + 2,
+                    std::memory_order_release);
+        }
+
+        std::uint64_t get_untracked_ct() const
+        {
+            return _untracked.load(std::memory_order_relaxed);
+        }
+
+        static std::uint64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+    private:
+        // state counts up by one per transition, so it is also a generation:
+        // FREE, then WRITING while enter() fills the slot, then LIVE until
+        // leave(), then FREE again.
+        static constexpr std::uint64_t FREE = 0;
+        static constexpr std::uint64_t LIVE = 2;
+
+        struct alignas(64) Slot
+        {
+            std::atomic<std::uint64_t> state{0};
+            std::atomic<const void*> container{nullptr};
+            std::atomic<const char*> name{nullptr};
+            std::atomic<const char*> tag{nullptr};
+            std::atomic<std::thread::id> thread{};
+            std::atomic<ROLE> role{ROLE::HOLDER};
+            std::atomic<bool> writer{false};
+            std::atomic<std::uint64_t> since{0};
+        };
+
+        struct Sample
+        {
+            const void* container;
+            const char* name;
+            Entry entry;
+            bool fresh;         // Over threshold and not yet reported
+        };
+
+        void _run(std::stop_token stop)
+        {
+            std::mutex mutex;
+            std::unique_lock<std::mutex> lock{mutex};
+            while (!_wake.wait_for(lock, stop, _interval,
+                        [&stop]{ return stop.stop_requested(); }))
+                _sample();
+        }
+
+        void _sample()
+        {
+            const std::uint64_t now = now_ns();
+            std::vector<Sample> samples;
+            for (int s=0; s<CAPACITY; ++s)
+            {
+                Slot& slot = _slots[s];
+                const std::uint64_t state
+                    = slot.state.load(std::memory_order_acquire);
+                if (state % 4 != LIVE)
+                    continue;
+                Sample sample{ slot.container.load(std::memory_order_relaxed),
+                    slot.name.load(std::memory_order_relaxed),
+                    Entry{ slot.thread.load(std::memory_order_relaxed),
+                        slot.role.load(std::memory_order_relaxed),
+                        slot.writer.load(std::memory_order_relaxed),
+                        slot.tag.load(std::memory_order_relaxed),
+                        std::chrono::nanoseconds(now - std::min(now,
+                                slot.since.load(std::memory_order_relaxed)))
+                    }, false };
+                // Gone, or reused, while we read it.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.state.load(std::memory_order_relaxed) != state)
+                    continue;
+                const auto threshold = sample.entry.role == ROLE::HOLDER
+                    ? _hold_threshold : _wait_threshold;
+                if (sample.entry.age > threshold && _reported[s] != state)
+                {
+                    _reported[s] = state;
+                    sample.fresh = true;
+                }
+                samples.push_back(sample);
+            }
+            for (const Sample& culprit : samples)
+            {
+                if (!culprit.fresh)
+                    continue;
+                Report report{ culprit.container, culprit.name, {}, {} };
+                for (Sample& sample : samples)
+                {
+                    if (sample.container != culprit.container)
+                        continue;
+                    sample.fresh = false;
+                    (sample.entry.role == ROLE::HOLDER ? report.holders
+                     : report.waiters).push_back(sample.entry);
+                }
+                auto oldest = [](const Entry& a, const Entry& b){
+                    return a.age > b.age;
+                };
+                std::sort(report.holders.begin(), report.holders.end(),
+                        oldest);
+                std::sort(report.waiters.begin(), report.waiters.end(),
+                        oldest);
+                _callback(report);
+            }
+        }
+
+        const std::chrono::nanoseconds _hold_threshold;
+        const std::chrono::nanoseconds _wait_threshold;
+        const Callback _callback;
+        const std::chrono::milliseconds _interval;
+        Slot _slots[CAPACITY];
+        std::atomic<std::uint64_t> _untracked{0};
+        std::vector<std::uint64_t> _reported;   // Sampler only
+        std::condition_variable_any _wake;
+        std::jthread _sampler;                  // Last: started last
+};
+
+} // sa
+
+#endif // WATCHDOG_H
@@ -8,10 +8,63 @@
 #include <thread>
 
 #include "log.h"
+#include "profile.h"
+#include "trace.h"
 
+#if defined(TRACE_SCOPES) || defined(PROFILE_SCOPES)
+
+// Binary backends, either or both: with TRACE_SCOPES, entering and leaving a
+// scope each record one fixed-size event in this thread's trace buffer (see
+// trace.h); with PROFILE_SCOPES, leaving it adds its duration to this
+// thread's histogram for the scope (see profile.h).  Milestones added with
+// add() are not recorded.
 class ScopeTracker
 {
     public:
+        ScopeTracker(const ScopeName& name)
+            : _id{ name.id() },
+#ifdef TRACE_SCOPES
+            _start_ns{ Trace::instance().record(TraceEvent::BEGIN, _id) }
+#else
+            _start_ns{ steady_now_ns() }
+#endif
+        {}
+
+        ~ScopeTracker()
+        {
+#ifdef TRACE_SCOPES
+            const std::uint64_t end_ns
+                = Trace::instance().record(TraceEvent::END, _id);
+#else
+            const std::uint64_t end_ns = steady_now_ns();
+#endif
+#ifdef PROFILE_SCOPES
+            Profile::instance().record(_id, end_ns - _start_ns);
+#endif
+            (void)end_ns;
+        }
+
+        void add(const std::string&) {}
+
+        int elapsed_ms() const { return elapsed_ns() / 1000000; }
+        std::uint64_t elapsed_ns() const
+        {
+            return steady_now_ns() - _start_ns;
+        }
+
+    private:
+        const std::uint32_t _id;
+        const std::uint64_t _start_ns;
+};
+
+#else
+
+class ScopeTracker
+{
+    public:
+        ScopeTracker(const ScopeName& name)
+            : ScopeTracker(std::string(name.str()))
+        {}
         ScopeTracker( const std::string& name,
                 std::thread::id tid=std::this_thread::get_id() )
             : _name(name),
@@ -52,6 +105,11 @@ class ScopeTracker
             return std::chrono::duration_cast<std::chrono::milliseconds>(
                         std::chrono::steady_clock::now() - _startTime).count();
         }
+        std::uint64_t elapsed_ns() const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - _startTime).count();
+        }
         
 
     private:
@@ -73,4 +131,6 @@ class ScopeTracker
 std::mutex ScopeTracker::_mutex;
 std::map<std::thread::id, int> ScopeTracker::_tabCts;
 
+#endif // TRACE_SCOPES || PROFILE_SCOPES
+
 #endif // SCOPETRACKER_H
@@ -0,0 +1,105 @@
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+using namespace std::chrono_literals;
+
+// g++ -std=c++20 -pthread test/access_stats.cpp -o ~/bin/safety/access_stats
+int main(int argc, char** argv)
+{
+    const int num_threads = (argc > 1) ? std::stoi( argv[1] ) : 4;
+    const int rounds = (argc > 2) ? std::stoi( argv[2] ) : 50;
+
+    std::cout << "Stats are off by default..." << std::endl;
+    sa::SafeArray<int> array{100, 0};
+    {
+        const auto it = array.cbegin();
+    }
+    AccessStats stats = array.get_stats();
+    assert( stats.read_acquisitions == 0 && stats.hold_ns == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Write sessions aren't counted as readers..." << std::endl;
+    {
+        sa::SafeArray<int> written{100, 0};
+        for (int r=0; r<3; ++r)
+        {
+            auto it = written.begin();
+            *it = r;
+        }
+        std::jthread other([&written]{ written.fill(4); });
+        other.join();
+        assert( written.get_stats().max_readers == 0 );
+        {
+            const auto it = written.cbegin();
+        }
+        assert( written.get_stats().max_readers == 1 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A writer blocked behind a reader waits, and starves..."
+        << std::endl;
+    array.set_stats_enabled(true);
+    array.set_starvation_threshold(1ms);
+    {
+        std::jthread writer;
+        const auto reader = array.cbegin();
+        writer = std::jthread([&array]{
+            auto it = array.begin();
+            *it = 1;
+        });
+        std::this_thread::sleep_for(20ms);
+    }
+    stats = array.get_stats();
+    assert( stats.read_acquisitions == 1 && stats.write_acquisitions == 1 );
+    assert( stats.wait_ns >= 10000000 && stats.starved_writers == 1 );
+    assert( stats.hold_ns >= 20000000 );    // The reader's alone
+    std::cout << "...ok" << std::endl;
+
+    std::cout << num_threads << " threads contending..." << std::endl;
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&array, t, rounds]{
+                for (int r=0; r<rounds; ++r)
+                {
+                    if (t % 2)
+                    {
+                        const auto end = array.end();
+                        for (auto it=array.begin(); it!=end; ++it)
+                            *it = r;
+                        continue;
+                    }
+                    const auto end = array.cend();
+                    for (auto it=array.cbegin(); it!=end; ++it)
+                        std::this_thread::yield();
+                }
+            });
+    }
+    stats = array.get_stats();
+    const std::uint64_t writes = 1 + num_threads / 2 * rounds * 2;
+    const std::uint64_t reads = 1 + (num_threads + 1) / 2 * rounds * 2;
+    assert( stats.write_acquisitions == writes );
+    assert( stats.read_acquisitions == reads );
+    std::uint64_t waits = 0, holds = 0;
+    for (int b=0; b<AccessStats::BUCKETS; ++b)
+    {
+        waits += stats.wait_hist[b];
+        holds += stats.hold_hist[b];
+    }
+    assert( waits == writes + reads && holds == writes + reads );
+    assert( stats.max_readers >= 1 );
+    std::ostringstream json;
+    stats.write_json(json);
+    assert( json.str().find("\"futile_wakeups\":") != std::string::npos );
+    std::cout << "...ok: " << json.str() << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+template <typename T>
+bool aligned_to(const T* p, std::size_t align)
+{
+    return reinterpret_cast<std::uintptr_t>(p) % align == 0;
+}
+
+// Builds a SafeArray on allocator, and checks its storage is usable and
+// aligned to at least align.
+template <typename Allocator>
+void check_safe_array(const Allocator& allocator, std::size_t align)
+{
+    const int n = 100000;
+    sa::SafeArray<long, Allocator> array(n, [](int i){ return (long)i; },
+            allocator);
+    assert( array.get_allocator() == allocator );
+    {
+        auto hold = array.cbegin();
+        assert( aligned_to(hold.operator->(), align) );
+    }
+    long sum = 0;
+    for (auto it=array.cbegin(); it!=array.cend(); ++it)
+        sum += *it;
+    assert( sum == (long)n * (n - 1) / 2 );
+}
+
+template <typename F>
+void expect_invalid(F f)
+{
+    bool thrown = false;
+    try
+    {
+        f();
+    }
+    catch (const std::invalid_argument&)
+    {
+        thrown = true;
+    }
+    assert( thrown );
+}
+
+// g++ -std=c++20 -pthread test/allocators.cpp -o ~/bin/safety/allocators
+int main(int, char**)
+{
+    std::cout << "CacheAlignedAllocator..." << std::endl;
+    {
+        sa::CacheAlignedAllocator<char> chars;
+        for (std::size_t n : { 1, 63, 64, 65, 1000 })
+        {
+            char* p = chars.allocate(n);
+            assert( aligned_to(p, sa::CACHE_LINE_SIZE) );
+            p[n - 1] = 'x';
+            chars.deallocate(p, n);
+        }
+        sa::CacheAlignedAllocator<double, 256> wide;
+        double* d = wide.allocate(3);
+        assert( aligned_to(d, 256) );
+        wide.deallocate(d, 3);
+
+        // Rebinds, and all instances are interchangeable.
+        sa::CacheAlignedAllocator<int> ints{chars};
+        assert( ints == chars );
+        std::vector<int, sa::CacheAlignedAllocator<int>> v(1000, 7);
+        assert( aligned_to(v.data(), sa::CACHE_LINE_SIZE) );
+        assert( std::accumulate(v.begin(), v.end(), 0) == 7000 );
+
+        check_safe_array(sa::CacheAlignedAllocator<long>{},
+                sa::CACHE_LINE_SIZE);
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "HugePageAllocator..." << std::endl;
+    {
+        using Alloc = sa::HugePageAllocator<long>;
+        Alloc huge;
+        for (std::size_t n : { 1ul, 1000ul, (3ul << 20) / sizeof(long) })
+        {
+            long* p = huge.allocate(n);
+            assert( aligned_to(p, Alloc::HUGE_PAGE_SIZE) );
+            p[0] = 1;
+            p[n - 1] = 2;
+            huge.deallocate(p, n);
+        }
+        check_safe_array(huge, Alloc::HUGE_PAGE_SIZE);
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "NumaAllocator..." << std::endl;
+    {
+        using Alloc = sa::NumaAllocator<long>;
+        const std::size_t page = sysconf(_SC_PAGESIZE);
+        check_safe_array(Alloc{}, page);
+        assert( Alloc{} == Alloc(Alloc::POLICY::FIRST_TOUCH, {0}) );
+        assert( Alloc{} != Alloc(Alloc::POLICY::BIND, {0}) );
+        const sa::NumaAllocator<char> rebound{ Alloc(Alloc::POLICY::BIND,
+                {0}) };
+        assert( rebound.policy() == sa::NumaAllocator<char>::POLICY::BIND );
+
+        // Node 0 always exists, but mbind may be refused (e.g. under a
+        // seccomp filter); that is reported, not ignored.
+        for (auto policy : { Alloc::POLICY::BIND,
+                Alloc::POLICY::INTERLEAVE })
+            try
+            {
+                check_safe_array(Alloc(policy, {0}), page);
+            }
+            catch (const std::system_error& e)
+            {
+                std::cout << "(mbind unavailable: " << e.what() << ")"
+                    << std::endl;
+            }
+
+        expect_invalid([]{ Alloc(Alloc::POLICY::BIND, {-1}); });
+        expect_invalid([]{ Alloc(Alloc::POLICY::INTERLEAVE, {0, 1024}); });
+        expect_invalid([]{ Alloc(Alloc::POLICY::FIRST_TOUCH, {4096}); });
+        expect_invalid([]{ Alloc(Alloc::POLICY::BIND, {}); });
+        Alloc(Alloc::POLICY::FIRST_TOUCH, {});
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
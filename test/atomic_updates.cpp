@@ -0,0 +1,88 @@
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+#include "../safe-containers/sharded_counter_array.h"
+
+// g++ -std=c++20 -pthread test/atomic_updates.cpp -o ~/bin/safety/atomic_updates
+int main(int argc, char** argv)
+{
+    const int num_threads = (argc > 1) ? std::stoi( argv[1] ) : 4;
+    const int INCREMENTS = 100000;
+    const int BINS = 64;
+
+    static_assert( sa::lock_free_atomic<long> );
+    static_assert( !sa::lock_free_atomic<std::string> );
+
+    std::cout << num_threads << " threads incrementing a histogram, with "
+        << "snapshots in between..." << std::endl;
+    sa::SafeArray<long> histogram{BINS, 0L};
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&histogram, t, BINS, INCREMENTS]{
+                for (int i=0; i<INCREMENTS; ++i)
+                    histogram.fetch_add((i*7 + t) % BINS, 1);
+            });
+        threads.emplace_back([&histogram]{
+            long last = 0;
+            for (int s=0; s<50; ++s)
+            {
+                const std::vector<long> snap = histogram.snapshot();
+                const long total = std::accumulate(snap.begin(), snap.end(),
+                        0L);
+                assert( total >= last );
+                last = total;
+            }
+        });
+    }
+    const std::vector<long> final_snap = histogram.snapshot();
+    assert( std::accumulate(final_snap.begin(), final_snap.end(), 0L)
+            == (long)num_threads * INCREMENTS );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Bit operations, compare-exchange and reset..." << std::endl;
+    sa::SafeArray<unsigned> flags{4, 0u};
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&flags, t]{ flags.fetch_or(0, 1u << t); });
+    }
+    assert( flags.atomic_load(0) == (1u << num_threads) - 1 );
+    unsigned expected = 5;
+    const bool stale = flags.compare_exchange(1, expected, 9);
+    assert( !stale && expected == 0 );
+    const bool fresh = flags.compare_exchange(1, expected, 9);
+    assert( fresh );
+    assert( flags.atomic_load(1) == 9 );
+    flags.fetch_and(0, 1u);
+    assert( flags.atomic_load(0) == 1 );
+    histogram.reset();
+    assert( histogram.atomic_load(BINS-1) == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Sharded counters..." << std::endl;
+    sa::ShardedCounterArray<long> counters{BINS};
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&counters, INCREMENTS]{
+                for (int i=0; i<INCREMENTS; ++i)
+                    counters.add(i % 3);
+            });
+    }
+    const std::vector<long> sums = counters.snapshot();
+    assert( sums[0] + sums[1] + sums[2] == (long)num_threads * INCREMENTS );
+    assert( counters.load(0) == sums[0] && sums[3] == 0 );
+    counters.reset();
+    assert( counters.load(0) == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+constexpr int N = 10000;
+
+template <typename T, typename A>
+std::vector<T> contents(const sa::SafeArray<T, A>& array)
+{
+    std::vector<T> v;
+    const auto end = array.cend();
+    for (auto it=array.cbegin(); it!=end; ++it)
+        v.push_back(*it);
+    return v;
+}
+
+template <typename F>
+void expect_throw(F f)
+{
+    bool thrown = false;
+    try
+    {
+        f();
+    }
+    catch (const std::logic_error&)
+    {
+        thrown = true;
+    }
+    assert( thrown );
+}
+
+// g++ -std=c++20 -pthread test/bulk.cpp -o ~/bin/safety/bulk
+int main(int, char**)
+{
+    static_assert( sa::byte_copyable<double> );
+    static_assert( !sa::byte_copyable<std::string> );
+
+    std::cout << "fill()..." << std::endl;
+    {
+        sa::SafeArray<int> ints(N);
+        ints.fill(0);
+        assert( contents(ints) == std::vector<int>(N, 0) );
+        ints.fill(-1);          // Uniform bytes: memset
+        assert( contents(ints) == std::vector<int>(N, -1) );
+        ints.fill(0x01020304);  // Not
+        assert( contents(ints) == std::vector<int>(N, 0x01020304) );
+        sa::SafeArray<std::string> strings(3);
+        strings.fill("abc");
+        assert( contents(strings) == std::vector<std::string>(3, "abc") );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "assign(), copy_to()..." << std::endl;
+    {
+        std::vector<long> source(N);
+        for (int i=0; i<N; ++i)
+            source[i] = i * 3;
+        sa::SafeArray<long> longs(N);
+        longs.assign(source);
+        assert( contents(longs) == source );
+
+        std::vector<long> copy(N);
+        const long* const copied = longs.copy_to(copy.data());
+        assert( copied == copy.data() + N );
+        assert( copy == source );
+        std::vector<long> appended;
+        longs.copy_to(std::back_inserter(appended));
+        assert( appended == source );
+
+        // A range of another type, element by element.
+        const std::list<int> small{1, 2, 3};
+        sa::SafeArray<long> three(3);
+        three.assign(small);
+        assert( contents(three) == (std::vector<long>{1, 2, 3}) );
+        expect_throw([&]{ longs.assign(small); });
+
+        // Rvalue ranges are moved from.
+        std::vector<std::string> words{"alpha", "beta"};
+        sa::SafeArray<std::string> strings(2);
+        strings.assign(std::move(words));
+        assert( contents(strings)
+                == (std::vector<std::string>{"alpha", "beta"}) );
+        assert( words[0].empty() && words[1].empty() );
+        std::vector<std::string> out(2);
+        strings.copy_to(out.begin());
+        assert( out == contents(strings) );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "copy_from()..." << std::endl;
+    {
+        sa::SafeArray<int> ints(10, 0);
+        ints.copy_from(std::vector<int>{7, 8, 9}, 4);
+        assert( contents(ints)
+                == (std::vector<int>{0, 0, 0, 0, 7, 8, 9, 0, 0, 0}) );
+        ints.copy_from(std::vector<int>{5, 5, 5}, 7);
+        assert( contents(ints).back() == 5 );
+        ints.copy_from(std::vector<int>{}, 10);
+        expect_throw([&]{ ints.copy_from(std::vector<int>{1, 2}, 9); });
+        expect_throw([&]{ ints.copy_from(std::vector<int>{1}, -1); });
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "swap_contents()..." << std::endl;
+    {
+        sa::SafeArray<int> a(N, 1), b(N, 2), c(N + 1, 3);
+        a.swap_contents(b);
+        assert( contents(a) == std::vector<int>(N, 2) );
+        assert( contents(b) == std::vector<int>(N, 1) );
+        a.swap_contents(a);
+        assert( contents(a) == std::vector<int>(N, 2) );
+        expect_throw([&]{ a.swap_contents(c); });
+
+        sa::SafeArray<std::string> s(2, "s"), t(2, "t");
+        s.swap_contents(t);
+        assert( contents(s) == std::vector<std::string>(2, "t") );
+
+        // Opposite orders from two threads: the holds are always taken in
+        // the same order, so this can't deadlock.
+        {
+            std::jthread one([&]{
+                    for (int i=0; i<200; ++i)
+                        a.swap_contents(b);
+                    });
+            std::jthread two([&]{
+                    for (int i=0; i<200; ++i)
+                        b.swap_contents(a);
+                    });
+        }
+        assert( contents(a) == std::vector<int>(N, 2) );
+        assert( a.get_reader_ct() == 0 && b.get_writer_ct() == 0 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Each is one session, seen whole by readers..." << std::endl;
+    {
+        sa::SafeArray<int> ints(N, 0);
+        ints.set_stats_enabled(true);
+        std::vector<int> source(N, 4);
+        ints.fill(1);
+        ints.assign(source);
+        ints.copy_from(source, 0);
+        ints.copy_to(source.data());
+        const AccessStats stats = ints.get_stats();
+        assert( stats.write_acquisitions == 3 );
+        assert( stats.read_acquisitions == 1 );
+
+        std::atomic<bool> done{false};
+        std::jthread reader([&]{
+                while (!done)
+                {
+                    const std::vector<int> seen = contents(ints);
+                    for (int x : seen)
+                        assert( x == seen[0] );
+                }
+                });
+        for (int i=0; i<500; ++i)
+            ints.fill(i);
+        done = true;
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Streaming copies at every alignment..." << std::endl;
+    {
+        std::vector<char> from(1000), to(1000);
+        for (int i=0; i<1000; ++i)
+            from[i] = (char)(i * 7);
+        for (int offset=0; offset<16; ++offset)
+            for (int bytes : { 0, 1, 15, 63, 64, 65, 200, 900 })
+            {
+                std::fill(to.begin(), to.end(), 0);
+                sa::detail::stream_copy(to.data() + offset,
+                        from.data() + 3, bytes);
+                assert( std::memcmp(to.data() + offset, from.data() + 3,
+                            bytes) == 0 );
+                assert( to[offset + bytes] == 0 );
+            }
+        std::vector<char> big(sa::detail::STREAM_THRESHOLD + 5, 'x');
+        std::vector<char> copy(big.size());
+        sa::detail::bulk_copy(copy.data(), big.data(), big.size());
+        assert( copy == big );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+struct Counted
+{
+    static inline std::atomic<int> live = 0;   // Built in parallel
+    Counted(int i) : value{i}
+    {
+        if (i == 777)
+            throw std::runtime_error("generator failed");
+        ++live;
+    }
+    Counted(const Counted& rhs) : value{rhs.value} { ++live; }
+    ~Counted() { --live; }
+    int value;
+};
+
+// Claims more elements than an int can count.
+struct TooLong
+{
+    const long* begin() const { return nullptr; }
+    const long* end() const { return nullptr; }
+    std::size_t size() const
+    {
+        return (std::size_t)std::numeric_limits<int>::max() + 1;
+    }
+};
+
+// g++ -std=c++20 -pthread test/construct.cpp -o ~/bin/safety/construct
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 100000;
+
+    sa::SafeArray<int> filled{N, 7};
+    for (auto it=filled.cbegin(); it!=filled.cend(); ++it)
+        assert( *it == 7 );
+
+    sa::SafeArray<long> generated{N, [](int i){ return 2L*i; }};
+    assert( generated[N-1] == 2L*(N-1) );
+
+    std::cout << "Parallel construction on 4 threads..." << std::endl;
+    sa::SafeArray<long> parallel{N, [](int i){ return 3L*i; },
+        sa::ParallelInit{4}};
+    for (int i=0; i<N; ++i)
+        assert( parallel[i] == 3L*i );
+    std::cout << "...ok" << std::endl;
+
+    const std::vector<std::string> words{"a", "b", "c"};
+    sa::SafeArray<std::string> copied{sa::from_range, words};
+    assert( copied.size() == 3 && copied[2] == "c" );
+
+    // Too long for the int size_type; refused before anything is read or
+    // allocated.
+    bool threw = false;
+    try
+    {
+        sa::SafeArray<long> huge{sa::from_range, TooLong{}};
+    }
+    catch (const std::length_error&)
+    {
+        threw = true;
+    }
+    assert( threw );
+
+    sa::SafeArray<double> raw{N, sa::uninitialized};
+    assert( raw.size() == N );
+
+    std::cout << "A throwing generator leaks nothing..." << std::endl;
+    try
+    {
+        sa::SafeArray<Counted> bad{1000, [](int i){ return Counted{i}; },
+            sa::ParallelInit{4}};
+        assert( false );
+    }
+    catch (const std::runtime_error&) {}
+    assert( Counted::live == 0 );
+    try
+    {
+        sa::SafeArray<Counted> bad{1000, [](int i){ return Counted{i}; }};
+        assert( false );
+    }
+    catch (const std::runtime_error&) {}
+    assert( Counted::live == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
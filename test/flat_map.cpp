@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_flat_map.h"
+
+// g++ -std=c++20 -pthread test/flat_map.cpp -o ~/bin/safety/flat_map
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 20000;
+
+    using SFM = sa::SafeFlatMap<int, std::string>;
+    SFM sfm{256};
+    std::map<int, std::string> reference;
+
+    std::cout << "Checking the flat map against std::map..." << std::endl;
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<int> key_dist{0, N/4};
+    for (int i=0; i<N; ++i)
+    {
+        const int key = key_dist(rng);
+        if (i % 7 == 0)
+        {
+            sfm.erase(key);
+            reference.erase(key);
+        }
+        else
+        {
+            sfm.insert(key, std::to_string(i));
+            reference[key] = std::to_string(i);
+        }
+    }
+    sfm.merge();
+    assert( sfm.pending() == 0 );
+    assert( sfm.size() == (int)reference.size() );
+
+    const auto snap = sfm.snapshot();
+    std::vector<int> keys(snap->keys(), snap->keys() + snap->size());
+    for (int key=-1; key<=N/4+1; ++key)
+    {
+        const auto lb = std::lower_bound(keys.begin(), keys.end(), key);
+        const auto ub = std::upper_bound(keys.begin(), keys.end(), key);
+        assert( snap->lower_bound(key) == lb - keys.begin() );
+        assert( snap->upper_bound(key) == ub - keys.begin() );
+        const auto found = sfm.find(key);
+        const auto it = reference.find(key);
+        assert( found.has_value() == (it != reference.end()) );
+        if (found)
+            assert( *found == it->second );
+    }
+
+    auto range = sfm.range(100, 200);
+    auto ref_it = reference.lower_bound(100);
+    for (const auto [key, value] : range)
+    {
+        assert( key == ref_it->first && value == ref_it->second );
+        ++ref_it;
+    }
+    assert( ref_it == reference.lower_bound(200) );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Concurrent lookups during batched merges..." << std::endl;
+    sa::SafeFlatMap<int, int> squares{64};
+    std::atomic<bool> done{false};
+    std::atomic<long> lookups{0};
+    auto reader = [&]
+    {
+        while ( !done )
+        {
+            const auto snap = squares.snapshot();
+            for (int i=0; i<snap->size(); ++i)
+                assert( snap->values()[i] == snap->keys()[i]*snap->keys()[i] );
+            const int probe = (int)(lookups++ % N);
+            if (auto v = squares.find(probe))
+                assert( *v == probe*probe );
+        }
+    };
+    {
+        std::vector<std::jthread> threads;
+        for (int i=0; i<3; ++i)
+            threads.emplace_back(reader);
+        for (int i=0; i<N; ++i)
+            squares.insert(i, i*i);
+        squares.merge();
+        done = true;
+    }
+    assert( squares.size() == N );
+    std::cout << "..." << lookups << " lookups never saw a partial merge"
+        << std::endl;
+
+    std::cout << "A held snapshot outlives later merges..." << std::endl;
+    {
+        sa::SafeFlatMap<int, int> gens{1};
+        gens.insert(0, 0);
+        const auto first = gens.snapshot();
+        for (int i=1; i<1000; ++i)
+            gens.insert(i, i);
+        const auto last = gens.snapshot();
+        assert( first->size() == 1 && *first->find(0) == 0 );
+        assert( last->size() == 1000 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
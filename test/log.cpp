@@ -0,0 +1,79 @@
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../log.h"
+
+// g++ -std=c++20 -pthread test/log.cpp -o ~/bin/safety/log
+int main(int argc, char** argv)
+{
+    const int num_lines = (argc > 1) ? std::stoi( argv[1] ) : 20000;
+    const int num_threads = (argc > 2) ? std::stoi( argv[2] ) : 4;
+
+    static std::ostringstream out;
+    Log& log = Log::instance(out);
+
+    std::cout << num_threads << " threads staging and writing lines..."
+        << std::endl;
+    auto run = [&log, num_lines, num_threads]{
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&log, t, num_lines]{
+                for (int i=0; i<num_lines; ++i)
+                {
+                    log.add(std::to_string(t));
+                    log.add(":");
+                    log.write(std::to_string(i));
+                }
+            });
+    };
+    run();
+    log.flush();
+    {
+        std::istringstream in{out.str()};
+        std::vector<int> next(num_threads, 0);
+        int ct = 0;
+        for (std::string line; std::getline(in, line); ++ct)
+        {
+            const auto colon = line.find(':');
+            assert( colon != std::string::npos );
+            const int t = std::stoi(line.substr(0, colon));
+            // Each thread's lines arrive whole and in order.
+            assert( std::stoi(line.substr(colon + 1)) == next[t]++ );
+        }
+        assert( ct == num_lines * num_threads );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Long lines span slots intact..." << std::endl;
+    out.str("");
+    const std::string long_line(Log::SLOT_PAYLOAD * 5 + 7, 'x');
+    log.write(long_line);
+    log.write("short");
+    log.flush();
+    assert( out.str() == long_line + "\nshort\n" );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "DROP policy accounts for every line..." << std::endl;
+    out.str("");
+    log.set_policy(Log::POLICY::DROP);
+    run();
+    log.flush();
+    {
+        std::istringstream in{out.str()};
+        long ct = 0;
+        for (std::string line; std::getline(in, line); ++ct)
+            ;
+        assert( ct + (long)log.get_dropped_ct()
+                == (long)num_lines * num_threads );
+        std::cout << "...ok, " << log.get_dropped_ct() << " dropped"
+            << std::endl;
+    }
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
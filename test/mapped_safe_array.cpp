@@ -0,0 +1,117 @@
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "../safe-containers/mapped_safe_array.h"
+
+// g++ -std=c++20 -pthread test/mapped_safe_array.cpp -o ~/bin/safety/mapped_safe_array
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 100000;
+    const std::string path = "/tmp/mapped_safe_array_test."
+        + std::to_string(getpid());
+
+    using MSA = sa::MappedSafeArray<long>;
+
+    std::cout << "Creating and filling " << path << "..." << std::endl;
+    {
+        MSA msa{path, N};
+        assert( msa.size() == N && msa.mode() == MSA::MODE::READ_WRITE );
+        msa.advise(MSA::ADVICE::SEQUENTIAL);
+        for (auto it=msa.begin(); it!=msa.end(); ++it)
+            *it = 10L * (it - msa.begin());
+        msa.flush();
+    }
+
+    std::cout << "Re-opening read-only..." << std::endl;
+    {
+        const MSA msa{path};
+        assert( msa.size() == N );
+        msa.advise(MSA::ADVICE::RANDOM);
+        long i = 0;
+        for (auto it=msa.cbegin(); it!=msa.cend(); ++it)
+            assert( *it == 10L * i++ );
+
+        // A second mapping of the same file sees the same pages.
+        MSA writer{path, MSA::MODE::READ_WRITE};
+        {
+            auto it = writer.begin();
+            *it = -1;
+        }
+        assert( msa[0] == -1 );
+
+        MSA read_only{path};
+        bool threw = false;
+        try
+        {
+            read_only.begin();
+        }
+        catch (const std::logic_error&)
+        {
+            threw = true;
+        }
+        assert( threw );
+
+        // Refused, rather than taken as "open the existing file".
+        threw = false;
+        try
+        {
+            MSA negative{path, -1};
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        assert( threw );
+    }
+
+    std::cout << "Concurrent readers while a writer holds the mapping..."
+        << std::endl;
+    {
+        MSA msa{path, MSA::MODE::READ_WRITE};
+        std::jthread writer{[&msa]{
+                for (int round=0; round<5; ++round)
+                    for (auto it=msa.begin(); it!=msa.end(); ++it)
+                        *it = round;
+                }};
+        std::jthread reader{[&msa]{
+                for (int round=0; round<5; ++round)
+                {
+                    const auto begin = msa.cbegin();
+                    const long first = *msa.cbegin();
+                    for (auto it=begin; it!=msa.cend(); ++it)
+                        assert( *it == first );
+                }
+                }};
+    }
+
+    std::cout << "A file with more elements than size_type holds is "
+        << "refused..." << std::endl;
+    {
+        // Sparse, so it takes no space.
+        const long bytes = (long)std::numeric_limits<int>::max() + 1;
+        const int truncated = truncate(path.c_str(), bytes);
+        assert( truncated == 0 );
+        bool threw = false;
+        try
+        {
+            sa::MappedSafeArray<char> too_big{path};
+        }
+        catch (const std::runtime_error&)
+        {
+            threw = true;
+        }
+        assert( threw );
+        assert( MSA{path}.size() == bytes / (long)sizeof(long) );
+    }
+
+    std::remove(path.c_str());
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
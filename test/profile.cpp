@@ -0,0 +1,106 @@
+#define DEBUG_ACCESS
+#define PROFILE_SCOPES
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+// g++ -std=c++20 -pthread test/profile.cpp -o ~/bin/safety/profile
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 100;
+    const int num_threads = (argc > 2) ? std::stoi( argv[2] ) : 4;
+
+    std::cout << "Histogram buckets are within 1/16th..." << std::endl;
+    for (std::uint64_t ns : {0ul, 1ul, 15ul, 16ul, 17ul, 1000ul, 123456789ul,
+            ~0ul})
+    {
+        const int b = ScopeHistogram::bucket(ns);
+        assert( b < ScopeHistogram::NUM_BUCKETS );
+        assert( ns <= ScopeHistogram::bucket_max(b) );
+        assert( ScopeHistogram::bucket_max(b) - ns <= ns / 16 );
+        assert( b == 0 || ScopeHistogram::bucket_max(b - 1) < ns );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Percentiles of known durations..." << std::endl;
+    {
+        static const ScopeName name{"known"};
+        std::jthread worker([]{
+            for (std::uint64_t ns=1; ns<=1000; ++ns)
+                Profile::instance().record(name.id(), ns * 1000);
+        });
+    }
+    for (const ScopeStats& s : Profile::instance().stats())
+        if (s.name == "known")
+        {
+            assert( s.count == 1000 && s.max_ns == 1000000 );
+            assert( s.mean_ns == 500500 );
+            assert( s.p50_ns >= 500000 && s.p50_ns <= 500000 * 17 / 16 );
+            assert( s.p99_ns >= 990000 && s.p99_ns <= 1000000 );
+        }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << num_threads << " threads iterating with profiling on..."
+        << std::endl;
+    const int rounds = 10;
+    {
+        sa::SafeArray<int> array{N, 0};
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&array, t]{
+                for (int r=0; r<rounds; ++r)
+                {
+                    if (t % 2)
+                        for (auto it=array.begin(); it!=array.end(); ++it)
+                            *it = t;
+                    else
+                        for (auto it=array.cbegin(); it!=array.cend(); ++it)
+                            assert( *it == array[0] );
+                }
+            });
+    }
+    bool found = false;
+    for (const ScopeStats& s : Profile::instance().stats())
+    {
+        assert( s.p50_ns <= s.p90_ns && s.p90_ns <= s.p99_ns );
+        assert( s.p99_ns <= s.max_ns );
+        if (s.name == "cbegin")
+        {
+            found = true;
+            assert( s.count
+                    == (std::uint64_t)((num_threads + 1) / 2 * rounds) );
+        }
+    }
+    assert( found );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Exited threads' histograms are reused..." << std::endl;
+    {
+        static const ScopeName name{"churn"};
+        const std::size_t histograms = Profile::instance().get_thread_ct();
+        for (int t=0; t<50; ++t)
+            std::jthread{[]{ Profile::instance().record(name.id(), 100); }};
+        assert( Profile::instance().get_thread_ct() == histograms );
+        bool counted = false;
+        for (const ScopeStats& s : Profile::instance().stats())
+            if (s.name == "churn")
+                counted = (s.count == 50);
+        assert( counted );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::ostringstream json;
+    Profile::instance().write_json(json);
+    assert( json.str().find("\"name\":\"cbegin\"") != std::string::npos );
+    Profile::instance().write_table(std::cout);
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array_fixed.h"
+
+constexpr int N = 20;
+constexpr int NUM_TEST_ITERS = 200;
+using SafeChars = sa::fixed::SafeArray<char, N>;
+
+static_assert( SafeChars::size() == N );
+static_assert( sizeof(SafeChars) <= 64,
+        "A small fixed SafeArray should fit in one cache line" );
+
+void broadcast(SafeChars& safe_chars, char c)
+{
+    for (int i=0; i<NUM_TEST_ITERS; ++i)
+    {
+        const auto begin = safe_chars.begin();
+        for (auto it=begin; it!=safe_chars.end(); ++it)
+        {
+            *it = c;
+            std::this_thread::yield();
+        }
+        // The writer may read back its own data while it holds the array.
+        for (auto it=safe_chars.cbegin(); it!=safe_chars.cend(); ++it)
+            assert( *it == c );
+    }
+}
+
+bool is_uniform(const SafeChars& safe_chars)
+{
+    const auto begin = safe_chars.cbegin();
+    const auto end = safe_chars.cend();
+    for (auto it=begin; it!=end; ++it)
+        if (*it != *begin)
+            return false;
+    return true;
+}
+
+// g++ -std=c++20 -pthread test/safe_array_fixed.cpp -o ~/bin/safety/safe_array_fixed
+int main(int, char**)
+{
+    SafeChars safe_chars{'0'};
+
+    std::cout << "Starting fixed SafeArray test: two writers, two readers..."
+        << std::endl;
+    std::atomic<bool> done{false};
+    std::atomic<long> reads{0};
+    {
+        std::vector<std::jthread> readers;
+        for (int i=0; i<2; ++i)
+            readers.emplace_back([&]{
+                    while ( !done )
+                    {
+                        assert( is_uniform(safe_chars) );
+                        ++reads;
+                    }
+                    });
+        std::jthread t1{broadcast, std::ref(safe_chars), '1'};
+        std::jthread t2{broadcast, std::ref(safe_chars), '9'};
+        t1.join();
+        t2.join();
+        done = true;
+    }
+    std::cout << "..." << reads << " reads, all rows uniform" << std::endl;
+
+    {
+        const auto begin = safe_chars.cbegin();
+        const auto copy = begin;
+        assert( safe_chars.get_reader_ct() == 2 );
+        assert( safe_chars.get_writer_ct() == 0 );
+    }
+    assert( safe_chars.get_reader_ct() == 0 );
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
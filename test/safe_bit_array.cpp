@@ -0,0 +1,90 @@
+#include <cassert>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_bit_array.h"
+
+// g++ -std=c++20 -pthread test/safe_bit_array.cpp -o ~/bin/safety/safe_bit_array
+int main(int argc, char** argv)
+{
+    const std::size_t N = (argc > 1) ? std::stoul( argv[1] ) : 1000003;
+    const int num_threads = (argc > 2) ? std::stoi( argv[2] ) : 4;
+
+    sa::SafeBitArray bits{N};
+    assert( bits.size() == N && bits.count() == 0 && bits.none() );
+
+    bits.set(0);
+    bits.set(N-1);
+    assert( bits.test(0) && bits.test(N-1) && !bits.test(1) );
+    assert( bits.count() == 2 );
+    assert( bits.find_first() == 0 && bits.find_first(1) == N-1 );
+    assert( bits.find_first(N) == bits.npos );
+    bits.clear(0);
+    bits.flip(N-1);
+    assert( bits.none() );
+
+    std::cout << num_threads << " threads racing to claim every bit..."
+        << std::endl;
+    std::atomic<std::size_t> claimed{0};
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&bits, &claimed, N]{
+                std::size_t mine = 0;
+                for (std::size_t i=0; i<N; ++i)
+                    if (!bits.test_and_set(i))
+                        ++mine;
+                claimed += mine;
+            });
+    }
+    assert( claimed == N && bits.count() == N );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Bulk operations..." << std::endl;
+    sa::SafeBitArray evens{N};
+    for (std::size_t i=0; i<N; i+=2)
+        evens.set(i);
+    bits &= evens;
+    assert( bits.count() == (N+1)/2 );
+    bits ^= bits;
+    assert( bits.none() );
+    bits.set_all();
+    assert( bits.count() == N );
+    bits ^= evens;
+    assert( bits.count() == N/2 && bits.find_first() == 1 );
+    bits |= evens;
+    assert( bits.count() == N );
+    bits.clear_all();
+    std::size_t visited = 0;
+    evens.for_each_set([&visited](std::size_t i){
+            assert( i % 2 == 0 );
+            ++visited;
+            });
+    assert( visited == (N+1)/2 );
+    try
+    {
+        sa::SafeBitArray other{N+1};
+        bits |= other;
+        assert( false );
+    }
+    catch (const std::invalid_argument&) {}
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Crossed bulk operations don't deadlock..." << std::endl;
+    {
+        std::jthread a{[&]{ for (int r=0; r<200; ++r) bits |= evens; }};
+        std::jthread b{[&]{ for (int r=0; r<200; ++r) evens &= bits; }};
+        std::jthread c{[&]{
+            for (std::size_t i=1; i<N; i+=1000)
+                bits.set(i);
+        }};
+    }
+    assert( bits.count() >= (N+1)/2 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
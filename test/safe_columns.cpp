@@ -0,0 +1,99 @@
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../safe-containers/safe_columns.h"
+
+// g++ -std=c++20 -pthread test/safe_columns.cpp -o ~/bin/safety/safe_columns
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 100000;
+    const int num_threads = (argc > 2) ? std::stoi( argv[2] ) : 4;
+
+    sa::SafeColumns<int, double, char> cols{N};
+    assert( cols.size() == N );
+
+    std::cout << "Filling by rows..." << std::endl;
+    for (auto it=cols.begin(); it!=cols.end(); ++it)
+    {
+        auto [i, d, c] = *it;
+        i = it.index();
+        d = 0.5 * it.index();
+        c = 'a' + it.index() % 26;
+    }
+    assert( cols.get<0>(N-1) == N-1 && cols.get<2>(27) == 'b' );
+    for (auto it=cols.cbegin(); it!=cols.cend(); ++it)
+        assert( it.get<1>() == 0.5 * it.get<0>() );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Column spans..." << std::endl;
+    {
+        const auto ints = cols.ccolumn<0>();
+        assert( (int)ints.size() == N );
+        assert( std::accumulate(ints.begin(), ints.end(), 0L)
+                == (long)N * (N-1) / 2 );
+        assert( cols.get_reader_ct<0>() == 1 && cols.get_reader_ct<1>() == 0 );
+        assert( ints.unsafe_span().data() == &ints[0] && !ints.empty() );
+        // Only unsafe_span() gets a span out of the session.
+        static_assert( std::ranges::random_access_range<decltype(ints)> );
+        static_assert( !std::is_convertible_v<decltype(ints),
+                std::span<const int>> );
+    }
+    for (double& d : cols.column<1>())
+        d *= 2;
+    assert( cols.get<1>(10) == 10.0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A writer of one column doesn't block readers of another..."
+        << std::endl;
+    {
+        auto doubles = cols.column<1>();
+        std::jthread reader{[&cols]{
+            const auto ints = cols.ccolumn<0>();
+            assert( ints[5] == 5 );
+        }};
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << num_threads << " threads mixing row and column sessions..."
+        << std::endl;
+    for (auto it=cols.begin(); it!=cols.end(); ++it)
+        *it = std::tuple{0, 0.0, 'x'};
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&cols, t]{
+                for (int r=0; r<20; ++r)
+                {
+                    if (t % 2 == 0)
+                    {
+                        // Rows: both numeric columns written together.
+                        for (auto it=cols.begin(); it!=cols.end(); ++it)
+                        {
+                            std::get<0>(*it) = t;
+                            std::get<1>(*it) = t;
+                        }
+                        continue;
+                    }
+                    auto it = cols.cbegin();
+                    const int first = it.get<0>();
+                    for (; it!=cols.cend(); ++it)
+                        assert( it.get<0>() == first && it.get<1>() == first );
+                    const auto ints = cols.ccolumn<0>();
+                    for (int i : ints)
+                        assert( i == ints[0] );
+                }
+            });
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
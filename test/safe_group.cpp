@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_group.h"
+
+struct Throws
+{
+    static inline int live = 0;
+    static inline int until_throw = -1;
+    Throws()
+    {
+        if (until_throw-- == 0)
+            throw std::runtime_error("construction failed");
+        ++live;
+    }
+    ~Throws() { --live; }
+};
+
+// g++ -std=c++20 -pthread test/safe_group.cpp -o ~/bin/safety/safe_group
+int main(int argc, char** argv)
+{
+    const int num_threads = (argc > 1) ? std::stoi( argv[1] ) : 4;
+
+    sa::SafeGroup<int, double, std::string> group{100, 20, 3};
+    assert( group.size<0>() == 100 && group.size<2>() == 3 );
+    {
+        auto session = group.write();
+        assert( group.get_writer_ct() == 1 );
+        auto [ids, weights, names] = session.all();
+        assert( ids.size() == 100 && weights.size() == 20 );
+        assert( reinterpret_cast<std::uintptr_t>(
+                    weights.unsafe_span().data())
+                % sa::CACHE_LINE_SIZE == 0 );
+        std::iota(ids.begin(), ids.end(), 0);
+        for (double& w : weights)
+            w = 0.5;
+        names[2] = "two";
+    }
+    assert( group.get_writer_ct() == 0 );
+    {
+        const auto session = group.read();
+        assert( session.get<0>()[99] == 99 && session.get<2>()[2] == "two" );
+    }
+
+    std::cout << "A session's spans share its one hold..." << std::endl;
+    {
+        const auto session = group.read();
+        const auto [ids, weights, names] = session.all();
+        const auto more_ids = session.get<0>();
+        assert( group.get_reader_ct() == 1 );
+    }
+    assert( group.get_reader_ct() == 0 );
+    {
+        auto [ids, weights, names] = group.write().all();
+        assert( group.get_writer_ct() == 1 && group.get_reader_ct() == 0 );
+        weights[0] = 0.5;
+    }
+    assert( group.get_writer_ct() == 0 && group.get_reader_ct() == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A span outlives its session still guarded..." << std::endl;
+    {
+        auto ids = group.read().get<0>();
+        assert( group.get_reader_ct() == 1 );
+        assert( ids[99] == 99 );
+        const std::span<const int> raw = ids.unsafe_span();
+        assert( raw.size() == 100 && raw[0] == 0 );
+    }
+    assert( group.get_reader_ct() == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << num_threads << " threads writing both arrays under one "
+        << "session, readers checking they agree..." << std::endl;
+    sa::SafeGroup<long, long> pair{1000, 10};
+    {
+        const auto session = pair.write();
+        auto [big, small] = session.all();
+        std::fill(big.begin(), big.end(), -1);
+        std::fill(small.begin(), small.end(), -1);
+    }
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&pair, t]{
+                for (int r=0; r<200; ++r)
+                {
+                    if (t % 2)
+                    {
+                        const auto session = pair.write();
+                        for (long& x : session.get<0>())
+                            x = r;
+                        for (long& x : session.get<1>())
+                            x = r;
+                        continue;
+                    }
+                    const auto session = pair.read();
+                    const long first = session.get<0>()[0];
+                    for (long x : session.get<0>())
+                        assert( x == first );
+                    for (long x : session.get<1>())
+                        assert( x == first );
+                }
+            });
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A throwing constructor leaks nothing..." << std::endl;
+    Throws::until_throw = 15;
+    try
+    {
+        sa::SafeGroup<Throws, Throws> bad{10, 10};
+        assert( false );
+    }
+    catch (const std::runtime_error&) {}
+    assert( Throws::live == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../safe-containers/shared_memory_safe_array.h"
+
+using SMSA = sa::SharedMemorySafeArray<long>;
+
+// Each writer process fills the whole array with its own id, over and over;
+// every read session must then see one id throughout.
+void writer(const std::string& name, long id, int passes)
+{
+    SMSA smsa{name};
+    for (int p=0; p<passes; ++p)
+        for (auto it=smsa.begin(); it!=smsa.end(); ++it)
+            *it = id;
+}
+
+void wait_for(pid_t pid)
+{
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert( WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+}
+
+// g++ -std=c++20 -pthread test/shared_memory_safe_array.cpp -o ~/bin/safety/shared_memory_safe_array
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 10000;
+    const std::string name = "/sa_test." + std::to_string(getpid());
+
+    SMSA::unlink(name);
+    SMSA smsa{name, N};
+    assert( smsa.size() == N );
+    for (auto it=smsa.cbegin(); it!=smsa.cend(); ++it)
+        assert( *it == 0 );
+
+    std::cout << "Two writer processes, one reader..." << std::endl;
+    pid_t writers[2];
+    for (long id=1; id<=2; ++id)
+        if ((writers[id-1] = fork()) == 0)
+        {
+            writer(name, id, 200);
+            _exit(0);
+        }
+    for (int r=0; r<200; ++r)
+    {
+        auto it = smsa.cbegin();
+        const long first = *it;
+        for (; it!=smsa.cend(); ++it)
+            assert( *it == first );
+    }
+    for (pid_t pid : writers)
+        wait_for(pid);
+    assert( smsa[0] == 1 || smsa[0] == 2 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A process that dies mid-session is reaped..." << std::endl;
+    const pid_t dying = fork();
+    if (dying == 0)
+    {
+        SMSA child{name};
+        auto it = child.begin();
+        *it = 99;
+        _exit(0);
+    }
+    wait_for(dying);
+    assert( smsa.get_writer_ct() == 1 );
+    const auto start = std::chrono::steady_clock::now();
+    {
+        auto it = smsa.begin();
+        assert( smsa.get_writer_ct() == 1 && smsa.get_reader_ct() == 1 );
+        assert( *it == 99 );
+        *it = 0;
+    }
+    std::cout << "...ok, after "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count()
+        << "ms" << std::endl;
+    assert( smsa.get_writer_ct() == 0 && smsa.get_reader_ct() == 0 );
+
+    std::cout << "Mismatched size is rejected..." << std::endl;
+    try
+    {
+        SMSA wrong{name, N + 1};
+        assert( false );
+    }
+    catch (const std::runtime_error&) {}
+    try
+    {
+        SMSA negative{name, -1};
+        assert( false );
+    }
+    catch (const std::invalid_argument&) {}
+    std::cout << "...ok" << std::endl;
+
+    SMSA::unlink(name);
+
+    std::cout << "A segment whose creator died part way is refused..."
+        << std::endl;
+    {
+        // Created but never sized, then sized but never marked ready.
+        const std::string orphan = name + ".orphan";
+        SMSA::unlink(orphan);
+        const int fd = shm_open(orphan.c_str(), O_RDWR | O_CREAT | O_EXCL,
+                0600);
+        assert( fd >= 0 );
+        for (int sized=0; sized<2; ++sized)
+        {
+            try
+            {
+                SMSA opener{orphan};
+                assert( false );
+            }
+            catch (const std::runtime_error&) {}
+            const int r = ftruncate(fd, 4096 + N*sizeof(long));
+            assert( r == 0 );
+        }
+        close(fd);
+        SMSA::unlink(orphan);
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
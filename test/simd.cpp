@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/simd.h"
+
+using sa::simd::LEVEL;
+
+const char* level_name(LEVEL level)
+{
+    switch (level)
+    {
+        case LEVEL::AVX512: return "AVX512";
+        case LEVEL::AVX2: return "AVX2";
+        default: return "SCALAR";
+    }
+}
+
+// Every kernel at the current level, against plain loops, for sizes around
+// the vector widths, so that each of the vector loop, the tail and the
+// both-together cases is covered.
+template <typename T>
+void check_kernels(std::mt19937& rng)
+{
+    for (int n : { 0, 1, 3, 7, 15, 16, 17, 31, 63, 64, 65, 127, 1000, 4099 })
+    {
+        std::uniform_int_distribution<int> big(-1000, 1000), small(-50, 50);
+        sa::SafeArray<T> a(n, [&](int){ return (T)big(rng); });
+        sa::SafeArray<T> b(n, [&](int){ return (T)small(rng); });
+        std::vector<T> va, vb;
+        for (auto it=a.cbegin(); it!=a.cend(); ++it)
+            va.push_back(*it);
+        for (auto it=b.cbegin(); it!=b.cend(); ++it)
+            vb.push_back(*it);
+
+        sa::simd::sum_type<T> sum = 0, dot = 0;
+        for (int i=0; i<n; ++i)
+        {
+            sum += va[i];
+            dot += (sa::simd::sum_type<T>)va[i] * vb[i];
+        }
+        // Small integers: exact even in float.
+        assert( sa::simd::sum(a) == sum );
+        assert( sa::simd::dot(a, b) == dot );
+
+        if (n == 0)
+        {
+            assert( !sa::simd::min(a) && !sa::simd::max(a) );
+            assert( !sa::simd::find_first_above(a, 0) );
+            assert( sa::simd::count_above(a, 0) == 0 );
+            continue;
+        }
+        assert( sa::simd::min(a) == *std::min_element(va.begin(), va.end()) );
+        assert( sa::simd::max(a) == *std::max_element(va.begin(), va.end()) );
+        for (T threshold : { (T)-2000, (T)0, (T)900, (T)1000 })
+        {
+            const auto count = std::count_if(va.begin(), va.end(),
+                    [threshold](T x){ return x > threshold; });
+            assert( sa::simd::count_above(a, threshold)
+                    == (std::size_t)count );
+            const auto first = std::find_if(va.begin(), va.end(),
+                    [threshold](T x){ return x > threshold; });
+            const auto found = sa::simd::find_first_above(a, threshold);
+            assert( found.has_value() == (first != va.end()) );
+            assert( !found || *found == (std::size_t)(first - va.begin()) );
+        }
+        // Only the last element qualifies.
+        const std::span<const T> span{va};
+        va.back() = 5000;
+        assert( sa::simd::find_first_above(span, 4000) == va.size() - 1 );
+        assert( sa::simd::max(span) == (T)5000 );
+    }
+}
+
+// NaNs are skipped the same way at every level, wherever they fall: in
+// the first vector, which seeds each lane, later in a lane, or in the tail.
+template <typename T>
+void check_nans()
+{
+    const T nan = std::numeric_limits<T>::quiet_NaN();
+    for (int n : { 2, 17, 256, 1001 })
+        for (int at : { 0, 1, n / 2, n - 1 })
+        {
+            std::vector<T> v(n, (T)1);
+            v[at] = nan;
+            const int spike = (at + 64) % n;
+            if (spike != at)
+                v[spike] = (T)1000;
+            const std::span<const T> span{v};
+            const bool spiked = spike != at;
+            assert( sa::simd::max(span) == (spiked ? (T)1000 : (T)1) );
+            assert( sa::simd::min(span) == (T)1 );
+            assert( sa::simd::count_above(span, 500) == (std::size_t)spiked );
+            const auto found = sa::simd::find_first_above(span, 500);
+            assert( found.has_value() == spiked );
+            assert( !found || *found == (std::size_t)spike );
+        }
+    const std::vector<T> all(100, nan);
+    assert( std::isnan(*sa::simd::max(std::span<const T>{all})) );
+    assert( std::isnan(*sa::simd::min(std::span<const T>{all})) );
+}
+
+template <typename T>
+void check_all_levels(const char* type)
+{
+    for (LEVEL level : { LEVEL::SCALAR, LEVEL::AVX2, LEVEL::AVX512 })
+    {
+        sa::simd::set_max_level(level);
+        std::cout << "Checking " << type << " kernels at "
+            << level_name(sa::simd::get_level()) << "..." << std::endl;
+        std::mt19937 rng{42};
+        check_kernels<T>(rng);
+        if constexpr (std::is_floating_point_v<T>)
+            check_nans<T>();
+        std::cout << "...ok" << std::endl;
+    }
+}
+
+// g++ -std=c++20 -pthread test/simd.cpp -o ~/bin/safety/simd
+int main(int, char**)
+{
+    std::cout << "Detected " << level_name(sa::simd::detected_level())
+        << std::endl;
+    check_all_levels<float>("float");
+    check_all_levels<double>("double");
+    check_all_levels<std::int32_t>("int32_t");
+    check_all_levels<std::int64_t>("int64_t");
+
+    std::cout << "int32_t sums don't overflow..." << std::endl;
+    {
+        sa::SafeArray<std::int32_t> big(1 << 12, INT32_MAX);
+        assert( sa::simd::sum(big) == (std::int64_t)INT32_MAX << 12 );
+        sa::SafeArray<std::int32_t> wide(1 << 12, 1 << 20);
+        assert( sa::simd::dot(wide, wide) == (std::int64_t)1 << 52 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "dot() of different sizes throws..." << std::endl;
+    {
+        sa::SafeArray<float> a(100, 1.f), b(99, 1.f);
+        int thrown = 0;
+        try
+        {
+            sa::simd::dot(a, b);
+        }
+        catch (const std::invalid_argument&)
+        {
+            ++thrown;
+        }
+        const std::vector<float> va(8, 1.f), vb(9, 1.f);
+        try
+        {
+            sa::simd::dot(std::span<const float>{va},
+                    std::span<const float>{vb});
+        }
+        catch (const std::invalid_argument&)
+        {
+            ++thrown;
+        }
+        assert( thrown == 2 );
+        assert( a.get_reader_ct() == 0 && b.get_reader_ct() == 0 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A kernel holds the array for reading throughout..."
+        << std::endl;
+    {
+        sa::SafeArray<double> array(1 << 20, 1.0);
+        std::jthread writer;
+        {
+            auto hold = array.cbegin();
+            writer = std::jthread([&array]{
+                    auto it = array.begin();
+                    for (int i=0; i<array.size(); ++i, ++it)
+                        *it = 2.0;
+                    });
+            // The writer can't start while we read, so every sum is of ones.
+            for (int i=0; i<10; ++i)
+                assert( sa::simd::sum(array) == 1 << 20 );
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            assert( sa::simd::sum(array) == 1 << 20 );
+        }
+        writer.join();
+        assert( sa::simd::sum(array) == 2 << 20 );
+        assert( array.get_reader_ct() == 0 && array.get_writer_ct() == 0 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "dot() in both orders alongside a swap doesn't deadlock..."
+        << std::endl;
+    {
+        sa::SafeArray<double> x(1 << 12, 1.0), y(1 << 12, 2.0);
+        const auto dots = [](const sa::SafeArray<double>& a,
+                const sa::SafeArray<double>& b){
+            for (int i=0; i<2000; ++i)
+            {
+                const double d = sa::simd::dot(a, b);
+                assert( d == 2.0 * (1 << 12) );
+            }
+        };
+        {
+            std::jthread xy(dots, std::cref(x), std::cref(y));
+            std::jthread yx(dots, std::cref(y), std::cref(x));
+            std::jthread swapper([&x, &y]{
+                    for (int i=0; i<2000; ++i)
+                    {
+                        if (i % 2)
+                            x.swap_contents(y);
+                        else
+                            y.swap_contents(x);
+                    }
+                    });
+        }
+        const double self = sa::simd::dot(x, x);
+        assert( self == 1 << 12 || self == 4 << 12 );
+        assert( x.get_reader_ct() == 0 && x.get_writer_ct() == 0 );
+        assert( y.get_reader_ct() == 0 && y.get_writer_ct() == 0 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
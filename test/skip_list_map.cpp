@@ -0,0 +1,114 @@
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_skip_list_map.h"
+
+// g++ -std=c++20 -pthread test/skip_list_map.cpp -o ~/bin/safety/skip_list_map
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 20000;
+    constexpr int NUM_THREADS = 4;
+
+    using SSLM = sa::SafeSkipListMap<int, long>;
+
+    std::cout << "Concurrent inserts and erases..." << std::endl;
+    SSLM map;
+    {
+        // Thread t inserts every key k with k % NUM_THREADS == t, then
+        // erases the multiples of 3 among them.  Scanners check ordering.
+        std::atomic<bool> done{false};
+        std::vector<std::jthread> threads;
+        for (int t=0; t<NUM_THREADS; ++t)
+            threads.emplace_back([&map, t, N]{
+                    for (int k=t; k<N; k+=NUM_THREADS)
+                    {
+                        const bool inserted = map.insert(k, 10L*k);
+                        assert( inserted );
+                    }
+                    for (int k=t; k<N; k+=NUM_THREADS)
+                    {
+                        const bool inserted = map.insert(k, -1);
+                        assert( !inserted );
+                    }
+                    for (int k=t; k<N; k+=NUM_THREADS)
+                        if (k % 3 == 0)
+                        {
+                            const bool erased = map.erase(k);
+                            assert( erased );
+                        }
+                    });
+        threads.emplace_back([&map, &done]{
+                while ( !done )
+                {
+                    int last = -1;
+                    for (const auto& [key, value] : map.all())
+                    {
+                        assert( key > last && value == 10L*key );
+                        last = key;
+                    }
+                }
+                });
+        for (int t=0; t<NUM_THREADS; ++t)
+            threads[t].join();
+        done = true;
+    }
+
+    long expected = 0;
+    for (int k=0; k<N; ++k)
+    {
+        const bool present = k % 3 != 0;
+        expected += present;
+        assert( map.contains(k) == present );
+        if (present)
+            assert( *map.find(k) == 10L*k );
+    }
+    assert( map.size() == expected );
+    const bool erased = map.erase(0);
+    assert( !erased && !map.find(-1) );
+
+    int ct = 0;
+    int prev = 99;
+    for (const auto& entry : map.range(100, 200))
+    {
+        assert( entry.first >= 100 && entry.first < 200 );
+        assert( entry.first > prev );
+        prev = entry.first;
+        ++ct;
+    }
+    assert( ct == 67 );
+    std::cout << "...ok, " << map.size() << " keys" << std::endl;
+
+    std::cout << "Snapshot-mode scans exclude writers..." << std::endl;
+    SSLM snap_map{SSLM::RANGE_MODE::SNAPSHOT};
+    {
+        std::atomic<bool> done{false};
+        std::jthread writer{[&]{
+                for (int k=0; k<N; ++k)
+                    snap_map.insert(k, k);
+                done = true;
+                }};
+        std::jthread scanner{[&]{
+                while ( !done )
+                {
+                    const auto range = snap_map.all();
+                    long first_pass = 0;
+                    for (auto it=range.begin(); it!=range.end(); ++it)
+                        ++first_pass;
+                    std::this_thread::yield();
+                    long second_pass = 0;
+                    for (auto it=range.begin(); it!=range.end(); ++it)
+                        ++second_pass;
+                    assert( first_pass == second_pass );
+                }
+                }};
+    }
+    assert( snap_map.size() == N );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../safe-containers/safe_array.h"
+
+struct Point
+{
+    double x, y;
+    int id;
+};
+
+// g++ -std=c++20 -pthread test/snapshot.cpp -o ~/bin/safety/snapshot
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 3000000;
+    const std::string path = "/tmp/snapshot_test." + std::to_string(getpid());
+
+    sa::SafeArray<Point> points{N, [](int i){
+        return Point{i*0.5, -i*0.5, i};
+    }};
+    sa::SafeArray<long> longs{N, [](int i){ return 7L*i; }};
+
+    std::cout << "Saving two snapshots back to back..." << std::endl;
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    assert( fd >= 0 );
+    points.save(fd);
+    longs.save(fd, sa::SAVE_MODE::SNAPSHOT);
+    assert( points.get_reader_ct() == 0 && longs.get_reader_ct() == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Loading them back..." << std::endl;
+    lseek(fd, 0, SEEK_SET);
+    const auto points2 = sa::SafeArray<Point>::load(fd);
+    const auto longs2 = sa::SafeArray<long>::load(fd);
+    assert( points2.size() == N && longs2.size() == N );
+    for (int i=0; i<N; ++i)
+    {
+        assert( points2[i].id == i && points2[i].x == i*0.5 );
+        assert( longs2[i] == 7L*i );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Mismatched and truncated snapshots are rejected..."
+        << std::endl;
+    lseek(fd, 0, SEEK_SET);
+    try
+    {
+        sa::SafeArray<long>::load(fd);
+        assert( false );
+    }
+    catch (const std::runtime_error&) {}
+    const int truncated = ftruncate(fd, sizeof(sa::SnapshotHeader) + 100);
+    assert( truncated == 0 );
+    lseek(fd, 0, SEEK_SET);
+    try
+    {
+        sa::SafeArray<Point>::load(fd);
+        assert( false );
+    }
+    catch (const std::runtime_error&) {}
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Round trip through a pipe..." << std::endl;
+    sa::SafeArray<int> small{1000, [](int i){ return -i; }};
+    int pipe_fds[2];
+    const int piped = pipe(pipe_fds);
+    assert( piped == 0 );
+    small.save(pipe_fds[1]);
+    close(pipe_fds[1]);
+    const auto small2 = sa::SafeArray<int>::load(pipe_fds[0]);
+    close(pipe_fds[0]);
+    assert( small2.size() == 1000 && small2[999] == -999 );
+    std::cout << "...ok" << std::endl;
+
+    close(fd);
+    unlink(path.c_str());
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+constexpr int N = 100000;
+
+template <typename T, typename A>
+std::vector<T> contents(const sa::SafeArray<T, A>& array)
+{
+    std::vector<T> v;
+    const auto end = array.cend();
+    for (auto it=array.cbegin(); it!=end; ++it)
+        v.push_back(*it);
+    return v;
+}
+
+template <typename T>
+std::vector<T> random_values(int n, std::mt19937& gen)
+{
+    std::vector<T> v(n);
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        std::uniform_real_distribution<T> dist(-1e6, 1e6);
+        for (T& x : v)
+            x = dist(gen);
+    }
+    else
+    {
+        std::uniform_int_distribution<T> dist(std::numeric_limits<T>::min(),
+                std::numeric_limits<T>::max());
+        for (T& x : v)
+            x = dist(gen);
+    }
+    return v;
+}
+
+// Sorts values in a SafeArray, on each number of threads, and checks the
+// result against std::sort.
+template <typename T, typename Compare=std::less<>>
+void check_sort(const std::vector<T>& values, Compare comp=Compare())
+{
+    std::vector<T> expected = values;
+    std::sort(expected.begin(), expected.end(), comp);
+    for (int threads : { 1, 2, 3, 8 })
+    {
+        sa::SafeArray<T> array(values.size());
+        array.assign(values);
+        array.sort(comp, sa::ParallelInit{threads});
+        assert( contents(array) == expected );
+    }
+}
+
+// g++ -std=c++20 -pthread test/sort.cpp -o ~/bin/safety/sort
+int main(int, char**)
+{
+    std::mt19937 gen(42);
+
+    std::cout << "Radix keys order as the values do..." << std::endl;
+    {
+        using sa::detail::radix_key;
+        const std::vector<double> doubles{ -1e300, -2.5, -1.0, -1e-300, 0.0,
+            1e-300, 1.0, 2.5, 1e300 };
+        for (std::size_t i=1; i<doubles.size(); ++i)
+            assert( radix_key(doubles[i-1]) < radix_key(doubles[i]) );
+        assert( radix_key(-0.0f) < radix_key(0.0f) );
+        assert( radix_key(std::numeric_limits<int>::min()) < radix_key(-1) );
+        assert( radix_key(-1) < radix_key(0) );
+        assert( radix_key((short)5) < radix_key((short)6) );
+        static_assert( sa::detail::radix_sortable<int, std::less<>> );
+        static_assert( sa::detail::radix_sortable<float, std::less<float>> );
+        static_assert( !sa::detail::radix_sortable<int, std::greater<>> );
+        static_assert( !sa::detail::radix_sortable<long double,
+                std::less<>> );
+        static_assert( !sa::detail::radix_sortable<std::string,
+                std::less<>> );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "sort(), radix..." << std::endl;
+    {
+        check_sort(random_values<int>(N, gen));
+        check_sort(random_values<std::uint64_t>(N, gen));
+        check_sort(random_values<std::int16_t>(N, gen));
+        check_sort(random_values<float>(N, gen));
+        check_sort(random_values<double>(N, gen), std::less<double>());
+
+        // Only the low byte differs: the other passes are skipped.
+        std::vector<long> low(N);
+        for (int i=0; i<N; ++i)
+            low[i] = (N - i) % 200;
+        check_sort(low);
+        check_sort(std::vector<int>(N, 7));
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "sort(), merge..." << std::endl;
+    {
+        check_sort(random_values<int>(N, gen), std::greater<>());
+        std::vector<std::string> words(N);
+        for (int i=0; i<N; ++i)
+            words[i] = std::to_string(gen() % 50000);
+        check_sort(words);
+        // Too wide for a radix key.
+        check_sort(random_values<long double>(N, gen));
+
+        // Already sorted, and reversed.
+        std::vector<int> ordered(N);
+        std::iota(ordered.begin(), ordered.end(), 0);
+        check_sort(ordered, std::greater<>());
+        check_sort(ordered, [](int a, int b){ return a < b; });
+
+        // Small arrays are sorted on the calling thread.
+        check_sort(std::vector<int>{});
+        check_sort(std::vector<int>{3, 1, 2});
+        check_sort(std::vector<std::string>{"b", "a"});
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "stable_sort()..." << std::endl;
+    {
+        // Few keys, so lots of ties; the second member records the order.
+        typedef std::pair<int, int> Elem;
+        auto by_key = [](const Elem& a, const Elem& b){
+            return a.first < b.first;
+        };
+        std::vector<Elem> values(N);
+        for (int i=0; i<N; ++i)
+            values[i] = { (int)(gen() % 10), i };
+        std::vector<Elem> expected = values;
+        std::stable_sort(expected.begin(), expected.end(), by_key);
+        for (int threads : { 1, 2, 3, 5, 8 })
+        {
+            sa::SafeArray<Elem> array(N);
+            array.assign(values);
+            array.stable_sort(by_key, sa::ParallelInit{threads});
+            assert( contents(array) == expected );
+        }
+
+        // Integers are radix sorted, which is stable too; floating-point
+        // values are not, so -0.0 and 0.0 keep their order.
+        sa::SafeArray<long> longs(N);
+        longs.assign(random_values<long>(N, gen));
+        longs.stable_sort();
+        const std::vector<long> sorted = contents(longs);
+        assert( std::is_sorted(sorted.begin(), sorted.end()) );
+
+        std::vector<double> zeros(N);
+        for (int i=0; i<N; ++i)
+            zeros[i] = (i % 2) ? 0.0 : -0.0;
+        sa::SafeArray<double> doubles(N);
+        doubles.assign(zeros);
+        doubles.stable_sort();
+        const std::vector<double> after = contents(doubles);
+        for (int i=0; i<N; ++i)
+            assert( std::signbit(after[i]) == std::signbit(zeros[i]) );
+
+        sa::SafeArray<long double> wide(N);
+        wide.assign(random_values<long double>(N, gen));
+        wide.stable_sort();
+        const std::vector<long double> wide_sorted = contents(wide);
+        assert( std::is_sorted(wide_sorted.begin(), wide_sorted.end()) );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "nth_element(), partition()..." << std::endl;
+    {
+        const std::vector<int> values = random_values<int>(N, gen);
+        std::vector<int> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        sa::SafeArray<int> array(N);
+        array.assign(values);
+        array.nth_element(N / 2);
+        std::vector<int> v = contents(array);
+        assert( v[N / 2] == sorted[N / 2] );
+        assert( std::all_of(v.begin(), v.begin() + N / 2,
+                    [&](int x){ return x <= v[N / 2]; }) );
+        array.nth_element(N);
+        array.nth_element(0, std::greater<>());
+        assert( contents(array)[0] == sorted.back() );
+
+        bool thrown = false;
+        try
+        {
+            array.nth_element(N + 1);
+        }
+        catch (const std::out_of_range&)
+        {
+            thrown = true;
+        }
+        assert( thrown );
+
+        auto even = [](int x){ return x % 2 == 0; };
+        const int split = array.partition(even);
+        v = contents(array);
+        assert( split == std::count_if(values.begin(), values.end(), even) );
+        assert( std::all_of(v.begin(), v.begin() + split, even) );
+        assert( std::none_of(v.begin() + split, v.end(), even) );
+        const int all = array.partition([](int){ return true; });
+        assert( all == N );
+        const int none = array.partition([](int){ return false; });
+        assert( none == 0 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A failing on_thread_start is rethrown..." << std::endl;
+    {
+        // The radix sort's chunks wait on each other; the one that fails
+        // mustn't leave the others waiting for it, with the array held.
+        const std::vector<int> values = random_values<int>(N, gen);
+        sa::SafeArray<int> array(N);
+        array.assign(values);
+        sa::ParallelInit init{4, [](int chunk){
+                if (chunk == 2)
+                    throw std::runtime_error("can't pin");
+            }};
+        for (bool stable : { false, true })
+        {
+            bool thrown = false;
+            try
+            {
+                if (stable)
+                    array.stable_sort(std::less<>(), init);
+                else
+                    array.sort(std::less<>(), init);
+            }
+            catch (const std::runtime_error&)
+            {
+                thrown = true;
+            }
+            assert( thrown );
+            assert( contents(array) == values );
+            assert( array.get_writer_ct() == 0 );
+        }
+        array.sort();
+        const std::vector<int> sorted = contents(array);
+        assert( std::is_sorted(sorted.begin(), sorted.end()) );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Each is one session, seen whole by readers..." << std::endl;
+    {
+        sa::SafeArray<long> array(N);
+        array.assign(random_values<long>(N, gen));
+        array.set_stats_enabled(true);
+        array.sort();
+        array.stable_sort(std::greater<>());
+        array.nth_element(10);
+        array.partition([](long x){ return x > 0; });
+        assert( array.get_stats().write_acquisitions == 4 );
+
+        // Sorting only moves elements around, so the sum doesn't change.
+        std::vector<long> start = contents(array);
+        const unsigned long sum = std::accumulate(start.begin(), start.end(), 0UL);
+        std::atomic<bool> done{false};
+        {
+            std::jthread reader([&]{
+                    while (!done)
+                    {
+                        const std::vector<long> seen = contents(array);
+                        assert( std::accumulate(seen.begin(), seen.end(), 0UL)
+                                == sum );
+                    }
+                    });
+            for (int i=0; i<20; ++i)
+            {
+                if (i % 2)
+                    array.sort(std::greater<>(), sa::ParallelInit{4});
+                else
+                    array.sort(std::less<>(), sa::ParallelInit{3});
+            }
+            done = true;
+        }
+        assert( array.get_reader_ct() == 0 && array.get_writer_ct() == 0 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
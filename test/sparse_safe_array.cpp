@@ -0,0 +1,160 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/sparse_safe_array.h"
+
+// Counts the live copies, so we can tell when pages are really freed.
+struct Tracked
+{
+    static inline std::atomic<long> live = 0;
+    Tracked(long v) : value{v} { ++live; }
+    Tracked(const Tracked& rhs) : value{rhs.value} { ++live; }
+    Tracked& operator=(const Tracked&) = default;
+    ~Tracked() { --live; }
+    bool operator==(const Tracked& rhs) const { return value == rhs.value; }
+    long value;
+};
+
+// g++ -std=c++20 -pthread test/sparse_safe_array.cpp -o ~/bin/safety/sparse_safe_array
+int main(int argc, char** argv)
+{
+    const int num_threads = (argc > 1) ? std::stoi( argv[1] ) : 4;
+    const std::size_t N = 1ul << 36;    // 64G slots
+    const std::size_t STRIDE = 1ul << 28;
+
+    sa::SparseSafeArray<long> sparse{N, -1};
+    assert( sparse.size() == N && sparse.get_page_ct() == 0 );
+    assert( sparse[N-1] == -1 );
+    {
+        auto it = sparse.cbegin();
+        assert( it == sparse.cend() );
+    }
+
+    std::cout << "Populating every " << STRIDE << "th slot..." << std::endl;
+    for (std::size_t i=0; i<N; i+=STRIDE)
+        *sparse.at(i) = (long)(i / STRIDE);
+    assert( sparse.get_page_ct() == N / STRIDE );
+    assert( sparse.get_memory_usage() < (64ul << 20) );
+    assert( sparse[STRIDE] == 1 && sparse[STRIDE+1] == -1 );
+    std::cout << "...ok, " << sparse.get_memory_usage() / 1024 << "KB"
+        << std::endl;
+
+    std::cout << "Iterators visit only populated pages..." << std::endl;
+    std::size_t visited = 0;
+    long sum = 0;
+    for (auto it=sparse.cbegin(); it!=sparse.cend(); ++it, ++visited)
+        if (*it != -1)
+        {
+            assert( it.index() % STRIDE == 0 );
+            sum += *it;
+        }
+    assert( visited == sparse.get_page_ct() * sparse.PAGE_SIZE );
+    assert( sum == (long)(N/STRIDE * (N/STRIDE - 1) / 2) );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << num_threads << " threads write whole pages, readers see "
+        << "one value per session..." << std::endl;
+    for (auto it=sparse.begin(); it!=sparse.end(); ++it)
+        *it = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&sparse, t]{
+                for (int r=0; r<50; ++r)
+                {
+                    if (t % 2)
+                    {
+                        for (auto it=sparse.begin(); it!=sparse.end(); ++it)
+                            *it = t;
+                        continue;
+                    }
+                    auto it = sparse.cbegin();
+                    const long first = *it;
+                    for (; it!=sparse.cend(); ++it)
+                        assert( *it == first );
+                }
+            });
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Releasing all-default pages..." << std::endl;
+    for (auto it=sparse.begin(); it!=sparse.end(); ++it)
+        *it = (it.index() < N/2) ? -1 : 5;
+    const std::size_t pages = sparse.get_page_ct();
+    const std::size_t released = sparse.release_default_pages();
+    assert( released == pages/2 );
+    assert( sparse.get_page_ct() == pages/2 );
+    assert( sparse[0] == -1 && sparse[N/2] == 5 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << num_threads << " threads look up while pages are "
+        << "released..." << std::endl;
+    {
+        constexpr std::size_t SMALL = 64 * 1024;
+        sa::SparseSafeArray<long, 64> small{SMALL, 0};
+        std::atomic<bool> done{false};
+        std::vector<std::jthread> readers;
+        for (int t=0; t<num_threads; ++t)
+            readers.emplace_back([&small, &done, t]{
+                for (std::size_t i=t; !done; i=(i+4099)%SMALL)
+                    assert( small[i] == 0 );
+            });
+        for (int r=0; r<200; ++r)
+        {
+            // Pages come in filled with the default, so every one goes.
+            for (std::size_t i=0; i<SMALL; i+=64)
+                small.at(i);
+            const std::size_t released = small.release_default_pages();
+            assert( released == SMALL / 64 );
+        }
+        done = true;
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Released pages are freed before it returns..." << std::endl;
+    {
+        sa::SparseSafeArray<Tracked, 16> tracked{16 * 100, Tracked{0}};
+        for (std::size_t i=0; i<tracked.size(); i+=16)
+            tracked.at(i);
+        *tracked.at(0) = Tracked{1};
+        // The default value itself, and the one page that isn't default.
+        assert( Tracked::live == 1 + 100 * 16 );
+        const std::size_t released = tracked.release_default_pages();
+        assert( released == 99 );
+        assert( Tracked::live == 1 + 16 );
+    }
+    assert( Tracked::live == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A pinned thread waiting on the array doesn't stall the "
+        << "release..." << std::endl;
+    {
+        sa::SparseSafeArray<long, 64> pinned{64 * 16, 0};
+        for (std::size_t i=0; i<pinned.size(); i+=64)
+            pinned.at(i);
+        *pinned.at(0) = 1;
+        std::atomic<bool> is_pinned{false};
+        std::jthread reader([&pinned, &is_pinned]{
+                const auto guard = sa::EpochDomain::instance().pin();
+                is_pinned = true;
+                // Long enough for the release to be waiting on this pin.
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                const auto it = pinned.cbegin();
+                assert( *it == 1 );
+                });
+        while (!is_pinned)
+            std::this_thread::yield();
+        const std::size_t released = pinned.release_default_pages();
+        assert( released == 15 );
+        assert( pinned.get_writer_ct() == 0 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
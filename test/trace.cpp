@@ -0,0 +1,104 @@
+#define DEBUG_ACCESS
+#define TRACE_SCOPES
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../safe-containers/safe_array.h"
+
+size_t count(const std::string& s, const std::string& what)
+{
+    size_t n = 0;
+    for (size_t pos=s.find(what); pos!=std::string::npos;
+            pos=s.find(what, pos+1))
+        ++n;
+    return n;
+}
+
+// g++ -std=c++20 -pthread test/trace.cpp -o ~/bin/safety/trace
+int main(int argc, char** argv)
+{
+    const int N = (argc > 1) ? std::stoi( argv[1] ) : 100;
+    const int num_threads = (argc > 2) ? std::stoi( argv[2] ) : 4;
+    const std::string path = "/tmp/trace_test." + std::to_string(getpid());
+
+    std::cout << num_threads << " threads iterating with binary tracing on..."
+        << std::endl;
+    {
+        sa::SafeArray<int> array{N, 0};
+        std::vector<std::jthread> threads;
+        for (int t=0; t<num_threads; ++t)
+            threads.emplace_back([&array, t]{
+                for (int r=0; r<10; ++r)
+                {
+                    if (t % 2)
+                        for (auto it=array.begin(); it!=array.end(); ++it)
+                            *it = t;
+                    else
+                        for (auto it=array.cbegin(); it!=array.cend(); ++it)
+                            assert( *it == array[0] );
+                }
+            });
+    }
+    Trace::instance().save(path);
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Exporting Chrome trace JSON..." << std::endl;
+    std::ostringstream json;
+    trace_to_chrome_json(path, json);
+    const std::string s = json.str();
+    assert( s.starts_with("{\"traceEvents\":[") );
+    assert( s.find("\"name\":\"cbegin\"") != std::string::npos );
+    assert( s.find("\"name\":\"reader_update\"") != std::string::npos );
+    const size_t begins = count(s, "\"ph\":\"B\"");
+    assert( begins > 0 && begins == count(s, "\"ph\":\"E\"") );
+    std::cout << "...ok, " << begins << " scopes" << std::endl;
+
+    std::cout << "A wrapped buffer drops ENDs that lost their BEGINs..."
+        << std::endl;
+    {
+        TraceBuffer buffer{0};
+        // Two nested scopes open as the ring wraps past both BEGINs.
+        buffer.record(TraceEvent::BEGIN, 0);
+        buffer.record(TraceEvent::BEGIN, 0);
+        for (std::uint32_t i=0; i<TraceBuffer::CAPACITY-1; ++i)
+            buffer.record(TraceEvent::INSTANT, 0);
+        buffer.record(TraceEvent::END, 0);
+        buffer.record(TraceEvent::END, 0);
+        buffer.record(TraceEvent::BEGIN, 0);
+        buffer.record(TraceEvent::END, 0);
+        const std::vector<TraceEvent> events = buffer.events();
+        assert( events.size() == TraceBuffer::CAPACITY - 2 );
+        assert( events[events.size()-2].kind == TraceEvent::BEGIN );
+        assert( events.back().kind == TraceEvent::END );
+        for (size_t i=0; i<events.size()-2; ++i)
+            assert( events[i].kind == TraceEvent::INSTANT );
+    }
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "Exited threads' buffers are reused..." << std::endl;
+    {
+        static const ScopeName name{"churn"};
+        const size_t buffers = Trace::instance().get_buffer_ct();
+        for (int t=0; t<50; ++t)
+            std::jthread{[]{
+                Trace::instance().record(TraceEvent::INSTANT, name.id());
+            }};
+        assert( Trace::instance().get_buffer_ct() == buffers );
+        Trace::instance().save(path);
+        std::ostringstream churn;
+        trace_to_chrome_json(path, churn);
+        assert( count(churn.str(), "\"name\":\"churn\"") == 50 );
+    }
+    std::cout << "...ok" << std::endl;
+
+    unlink(path.c_str());
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
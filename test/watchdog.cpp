@@ -0,0 +1,90 @@
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../safe-containers/safe_array.h"
+
+using namespace std::chrono_literals;
+
+// g++ -std=c++20 -pthread test/watchdog.cpp -o ~/bin/safety/watchdog
+int main(int argc, char** argv)
+{
+    const int num_readers = (argc > 1) ? std::stoi( argv[1] ) : 3;
+
+    std::mutex mutex;
+    std::vector<sa::Watchdog::Report> reports;
+    sa::Watchdog watchdog{20ms, 20ms, [&](const sa::Watchdog::Report& r){
+            std::lock_guard<std::mutex> lock{mutex};
+            reports.push_back(r);
+        }, 5ms};
+    auto report_ct = [&]{
+        std::lock_guard<std::mutex> lock{mutex};
+        return reports.size();
+    };
+
+    sa::SafeArray<int> array{1000, 0};
+    array.set_watchdog(&watchdog, "orders");
+
+    std::cout << "Short holds go unreported..." << std::endl;
+    for (int r=0; r<100; ++r)
+    {
+        const auto end = array.end();
+        for (auto it=array.begin(); it!=end; ++it)
+            *it = r;
+    }
+    std::this_thread::sleep_for(30ms);
+    assert( report_ct() == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "A long write hold is reported with the readers it blocks..."
+        << std::endl;
+    {
+        std::vector<std::jthread> threads;
+        threads.emplace_back([&array]{
+            const sa::Watchdog::Tag tag{"rebuild"};
+            auto it = array.begin();
+            std::this_thread::sleep_for(150ms);
+            *it = 1;
+        });
+        std::this_thread::sleep_for(5ms);
+        for (int t=0; t<num_readers; ++t)
+            threads.emplace_back([&array]{
+                const auto it = array.cbegin();
+            });
+    }
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        assert( !reports.empty() );
+        const sa::Watchdog::Report& report = reports.front();
+        assert( report.container != nullptr );
+        assert( std::strcmp(report.name, "orders") == 0 );
+        assert( report.holders.size() == 1 );
+        assert( report.holders[0].writer );
+        assert( std::strcmp(report.holders[0].tag, "rebuild") == 0 );
+        assert( report.holders[0].age >= 20ms );
+        assert( (int)report.waiters.size() == num_readers );
+        for (const sa::Watchdog::Entry& waiter : report.waiters)
+            assert( !waiter.writer && waiter.role
+                    == sa::Watchdog::ROLE::WAITER );
+        std::cout << "...ok, " << reports.size() << " reports" << std::endl;
+    }
+
+    std::cout << "Detached arrays are no longer watched..." << std::endl;
+    array.set_watchdog(nullptr);
+    const std::size_t before = report_ct();
+    {
+        auto it = array.begin();
+        std::this_thread::sleep_for(50ms);
+    }
+    assert( report_ct() == before );
+    assert( watchdog.get_untracked_ct() == 0 );
+    std::cout << "...ok" << std::endl;
+
+    std::cout << "...and we're done." << std::endl;
+    return 0;
+}
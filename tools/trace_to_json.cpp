@@ -0,0 +1,29 @@
+// Converts a binary trace written by Trace::save() (see trace.h) into Chrome
+// trace event JSON, for chrome://tracing or ui.perfetto.dev.
+//
+//     trace_to_json run.trace > run.json
+
+#include <exception>
+#include <iostream>
+
+#include "../trace.h"
+
+// g++ -std=c++20 tools/trace_to_json.cpp -o ~/bin/safety/trace_to_json
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace file>" << std::endl;
+        return 2;
+    }
+    try
+    {
+        trace_to_chrome_json(argv[1], std::cout);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,321 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Binary scope tracing: the backend ScopeTracker uses when built with
+// TRACE_SCOPES.
+//
+// Each thread records fixed-size events into a ring buffer of its own, with
+// no lock and no allocation: one clock read and a 24-byte store per event.
+// When a buffer wraps, the oldest events are overwritten, so it always holds
+// the most recent TraceBuffer::CAPACITY, less any ENDs whose BEGINs went.
+// Scope names are interned once per call site (see ScopeName), so events
+// carry a 32-bit id instead of a string.  When a thread exits its buffer goes
+// to the next thread that starts recording, whose events then overwrite the
+// oldest of the old thread's; so with thread churn the buffers, about 1.5MB
+// each, number only as many as there have ever been threads recording at
+// once.
+//
+// Trace::save() writes every thread's events to a binary file and
+// trace_to_chrome_json() turns such a file into the Chrome trace event JSON
+// that chrome://tracing and ui.perfetto.dev load; tools/trace_to_json.cpp
+// does the same from the command line.  Save after the traced threads have
+// finished, or at least gone quiet: a buffer being written while it is saved
+// may yield a torn event or two at its tail.
+
+// steady_clock, in nanoseconds since its epoch.
+inline std::uint64_t steady_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// s as a JSON string literal.
+inline std::string json_quoted(const std::string& s)
+{
+    std::string q = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            q += '\\';
+        q += c;
+    }
+    return q + "\"";
+}
+
+struct TraceEvent
+{
+    enum KIND : std::uint8_t
+    {
+        BEGIN,
+        END,
+        INSTANT
+    };
+
+    std::uint64_t ts_ns;        // steady_clock
+    std::uint32_t scope_id;
+    std::uint32_t thread;       // Trace's own small thread number
+    KIND kind;
+};
+
+// One thread's ring of events.  Only its owner writes; head is published
+// with release so a reader sees whole events up to it.  Owners change only
+// under Trace's mutex.
+class TraceBuffer
+{
+    public:
+        static constexpr std::uint32_t CAPACITY = 1u << 16;
+
+        explicit TraceBuffer(std::uint32_t thread)
+            : _events{ new TraceEvent[CAPACITY] },
+            _thread{thread}
+        {}
+
+        // Returns the event's timestamp.
+        std::uint64_t record(TraceEvent::KIND kind, std::uint32_t scope_id)
+        {
+            const std::uint64_t head = _head.load(std::memory_order_relaxed);
+            const std::uint64_t now = steady_now_ns();
+            _events[head & (CAPACITY - 1)] = TraceEvent{ now, scope_id,
+                _thread, kind };
+            _head.store(head + 1, std::memory_order_release);
+            return now;
+        }
+
+        // The events still in the buffer, oldest first.  Once the buffer has
+        // wrapped, some ENDs may have lost their BEGINs; those are dropped,
+        // so that every END returned closes a BEGIN before it.
+        std::vector<TraceEvent> events() const
+        {
+            const std::uint64_t head = _head.load(std::memory_order_acquire);
+            const std::uint64_t first = head > CAPACITY ? head - CAPACITY : 0;
+            std::vector<TraceEvent> out;
+            out.reserve(head - first);
+            std::uint64_t depth = 0;
+            for (std::uint64_t i=first; i<head; ++i)
+            {
+                const TraceEvent& event = _events[i & (CAPACITY - 1)];
+                if (event.kind == TraceEvent::BEGIN)
+                    ++depth;
+                else if (event.kind == TraceEvent::END)
+                {
+                    if (depth == 0)
+                        continue;
+                    --depth;
+                }
+                out.push_back(event);
+            }
+            return out;
+        }
+        std::uint32_t thread() const { return _thread; }
+        // For a new owner; events already recorded keep the old number.
+        void set_thread(std::uint32_t thread) { _thread = thread; }
+
+    private:
+        std::unique_ptr<TraceEvent[]> _events;
+        std::atomic<std::uint64_t> _head{0};
+        std::uint32_t _thread;
+};
+
+class Trace
+{
+    public:
+        static constexpr std::uint32_t MAGIC = 0x43525453; // "STRC"
+        static constexpr std::uint32_t VERSION = 1;
+
+        static Trace& instance()
+        {
+            static Trace trace;
+            return trace;
+        }
+
+        // The id for 'name', the same for every call with the same name.
+        std::uint32_t intern(const std::string& name)
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            const auto it = _ids.find(name);
+            if (it != _ids.end())
+                return it->second;
+            _names.push_back(name);
+            return _ids[name] = _names.size() - 1;
+        }
+        std::string name(std::uint32_t id) const
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            return _names.at(id);
+        }
+
+        // Lock-free after the calling thread's first event.  Returns the
+        // event's timestamp, in steady_clock nanoseconds.
+        std::uint64_t record(TraceEvent::KIND kind, std::uint32_t scope_id)
+        {
+            thread_local BufferHolder holder{ this, _register_thread() };
+            return holder.buffer->record(kind, scope_id);
+        }
+
+        // Buffers allocated so far, in use or kept for the next thread.
+        std::size_t get_buffer_ct() const
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            return _buffers.size();
+        }
+
+        // Binary dump: header, scope names, then each thread's events.
+        void save(const std::string& path) const
+        {
+            std::ofstream out{path, std::ios::binary};
+            if (!out)
+                throw std::runtime_error("Can't open " + path);
+            std::lock_guard<std::mutex> lock{_mutex};
+            _put(out, MAGIC);
+            _put(out, VERSION);
+            _put(out, (std::uint32_t)_names.size());
+            for (const std::string& name : _names)
+            {
+                _put(out, (std::uint32_t)name.size());
+                out.write(name.data(), name.size());
+            }
+            _put(out, (std::uint32_t)_buffers.size());
+            for (const auto& buffer : _buffers)
+            {
+                const std::vector<TraceEvent> events = buffer->events();
+                _put(out, (std::uint64_t)events.size());
+                out.write(reinterpret_cast<const char*>(events.data()),
+                        events.size() * sizeof(TraceEvent));
+            }
+            if (!out)
+                throw std::runtime_error("Error writing " + path);
+        }
+
+    private:
+        // Hands the thread's buffer back when the thread exits.
+        struct BufferHolder
+        {
+            Trace* trace;
+            TraceBuffer* buffer;
+            ~BufferHolder()
+            {
+                std::lock_guard<std::mutex> lock{trace->_mutex};
+                trace->_free.push_back(buffer);
+            }
+        };
+
+        Trace() = default;
+
+        TraceBuffer* _register_thread()
+        {
+            std::lock_guard<std::mutex> lock{_mutex};
+            // Buffers outlive their threads so that save() still sees them,
+            // until another thread takes one over.
+            if (!_free.empty())
+            {
+                TraceBuffer* buffer = _free.back();
+                _free.pop_back();
+                buffer->set_thread(_next_thread++);
+                return buffer;
+            }
+            _buffers.emplace_back(new TraceBuffer(_next_thread++));
+            return _buffers.back().get();
+        }
+
+        template <typename U>
+        static void _put(std::ostream& out, U u)
+        {
+            out.write(reinterpret_cast<const char*>(&u), sizeof(u));
+        }
+
+        mutable std::mutex _mutex;
+        std::unordered_map<std::string, std::uint32_t> _ids;
+        std::vector<std::string> _names;
+        std::vector<std::unique_ptr<TraceBuffer>> _buffers;
+        std::vector<TraceBuffer*> _free;    // Of exited threads
+        std::uint32_t _next_thread = 0;
+};
+
+// A scope name interned when its call site is first reached.  Declared as a
+// function-local static, e.g. by FUNC_LOGGING(), the lookup happens once per
+// call site and every later pass costs nothing.
+class ScopeName
+{
+    public:
+        ScopeName(const char* name)
+            : _name{name},
+            _id{ Trace::instance().intern(name) }
+        {}
+
+        const char* str() const { return _name; }
+        std::uint32_t id() const { return _id; }
+
+    private:
+        const char* _name;
+        const std::uint32_t _id;
+};
+
+// Converts a file written by Trace::save() to Chrome trace event JSON.
+inline void trace_to_chrome_json(const std::string& path, std::ostream& out)
+{
+    std::ifstream in{path, std::ios::binary};
+    if (!in)
+        throw std::runtime_error("Can't open " + path);
+    auto get = [&in, &path](auto& u)
+    {
+        if (!in.read(reinterpret_cast<char*>(&u), sizeof(u)))
+            throw std::runtime_error(path + " is truncated");
+    };
+
+    std::uint32_t magic, version, num_names;
+    get(magic);
+    get(version);
+    if (magic != Trace::MAGIC || version != Trace::VERSION)
+        throw std::runtime_error(path + " is not a trace file");
+    get(num_names);
+    std::vector<std::string> names(num_names);
+    for (std::string& name : names)
+    {
+        std::uint32_t size;
+        get(size);
+        name.resize(size);
+        if (!in.read(name.data(), size))
+            throw std::runtime_error(path + " is truncated");
+    }
+
+    static const char PHASE[] = { 'B', 'E', 'i' };
+    std::uint32_t num_threads;
+    get(num_threads);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (std::uint32_t t=0; t<num_threads; ++t)
+    {
+        std::uint64_t num_events;
+        get(num_events);
+        for (std::uint64_t e=0; e<num_events; ++e)
+        {
+            TraceEvent event;
+            get(event);
+            if (event.scope_id >= names.size() || event.kind > 2)
+                throw std::runtime_error(path + " is corrupt");
+            char ts[32];
+            std::snprintf(ts, sizeof(ts), "%.3f", event.ts_ns / 1000.0);
+            out << (first ? "" : ",\n") << "{\"name\":"
+                << json_quoted(names[event.scope_id]) << ",\"ph\":\""
+                << PHASE[event.kind] << "\",\"ts\":" << ts
+                << ",\"pid\":1,\"tid\":" << event.thread << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+#endif // TRACE_H